@@ -1,31 +1,60 @@
 #define NOMINMAX
 #define _CRT_SECURE_NO_WARNINGS
 
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <Windows.h>
 #include <winhttp.h>
+#pragma comment(lib, "ws2_32.lib")
 #pragma comment(lib, "winhttp.lib")
 #pragma comment(lib, "ole32.lib")
 
-
 extern "C" IMAGE_DOS_HEADER __ImageBase;
+#else
+// Off Windows there is no arcdps to load us: only the plain-http
+// SocketTransport exists, so the network path can be run against a local
+// relay.js. Files go next to the working directory.
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#define __cdecl
+#endif
 
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cctype>
 #include <algorithm>
+#include <array>
 #include <map>
+#include <functional>
+#include <memory>
+#include <random>
+#include <limits>
 #include <exception> // for std::exception
 #include <cmath>     // for fabsf
 
 #include "imgui.h"
 #include "arcdps_structs.h"
 #include "json.hpp"
+#include "sqcd_gzip.h"
 using json = nlohmann::json;
 
 static constexpr uint32_t PLUGIN_SIG = 0xC0CD0F15;
@@ -43,6 +72,10 @@ static constexpr uint32_t BUFF_CHILL = 722;
 #define CBTS_CHANGEDOWN 5
 #endif
 
+#ifndef CBTS_ENTERCOMBAT
+#define CBTS_ENTERCOMBAT 1
+#endif
+
 #ifndef CBTS_EXITCOMBAT
 #define CBTS_EXITCOMBAT 2
 #endif
@@ -86,11 +119,24 @@ static std::string g_room = "bags";
 static std::string g_server_host = "relay.ethevia.com";
 static int g_server_port = 443;
 static bool g_use_https = true;
+static std::atomic<bool> g_use_socket_transport{ false };  // plain-http relays only
+static std::atomic<bool> g_binary_wire{ false };           // compact /update + /aggregate
+static std::atomic<bool> g_http_compress{ true };          // gzip large bodies both ways
+static std::atomic<bool> g_udp_enabled{ false };           // state datagrams, see "room datagrams"
+static std::string g_skill_api_host = "api.guildwars2.com";  // or a local stand-in
+static int g_skill_api_port = 443;
+static bool g_skill_api_https = true;
 
-static constexpr float NET_OFFSET = 1.75f;
 static constexpr float CANCEL_COOLDOWN = 1.5f;
-static constexpr int PUSH_INTERVAL_MS = 150;  // how often we POST /update
-static constexpr int PULL_INTERVAL_MS = 300;  // how often we GET /aggregate
+// how often we POST /update and GET /aggregate (see "net cadence")
+static constexpr int PUSH_INTERVAL_MS = 150;         // in combat
+static constexpr int PULL_INTERVAL_MS = 300;
+static constexpr int PUSH_IDLE_INTERVAL_MS = 2000;   // out of combat heartbeat
+static constexpr int PULL_IDLE_INTERVAL_MS = 1000;
+static constexpr int PUSH_PAUSED_INTERVAL_MS = 10000; // loading: just stay in the room
+static constexpr double COMBAT_LINGER_S = 10.0;      // a tracked cast keeps the fast rate this long
+static constexpr double MAP_CHANGE_MAX_S = 10.0;     // a map change with no loading screen or events
+static constexpr int NET_TICK_MS = 30;               // longest net_loop sleep
 
 static inline double now_s() {
     using clock = std::chrono::steady_clock;
@@ -98,94 +144,338 @@ static inline double now_s() {
     return std::chrono::duration<double>(clock::now() - t0).count();
 }
 
-// Pending CD fetch requests (non-blocking for main thread)
+// -------------------- skill resolution table --------------------
+//
+// One slot per skill id whose recharge we need from the API. Slots are
+// claimed once and never freed; every field is atomic, so the render, combat
+// and push paths read them without a lock and request a fetch with a single
+// CAS on the state:
+//
+//   UNKNOWN --request--> PENDING --worker--> INFLIGHT --+--> RESOLVED
+//      FAILED (retry_at passed) --request--^            +--> FAILED until retry_at
+//
+// A refresh (stale cache entry) moves a RESOLVED slot back to PENDING; its
+// recharge stays readable until the new one lands. The skill metadata
+// workers scan the table for PENDING slots and wait on g_cd_cv (g_cd_mutex
+// only guards that wait) when there are none.
+
+enum SkillResState : uint32_t {
+    SR_UNKNOWN = 0,
+    SR_PENDING,
+    SR_INFLIGHT,
+    SR_RESOLVED,
+    SR_FAILED,
+};
+
+struct SkillSlot {
+    std::atomic<uint32_t> id{ 0 };         // 0: free
+    std::atomic<uint32_t> state{ SR_UNKNOWN };
+    std::atomic<float>    recharge{ 0.f }; // > 0 once known
+    std::atomic<double>   retry_at{ 0.0 }; // now_s() when a FAILED slot may be requested again
+    std::atomic<uint32_t> attempts{ 0 };   // consecutive transport failures
+    std::atomic<bool>     negative{ false }; // the API has no recharge for it
+    // persisted by the skill cache
+    std::atomic<int64_t>  fetched{ 0 };    // unix seconds, 0 if never fetched
+    std::atomic<uint32_t> build{ 0 };      // API build it was fetched under
+};
+
+static constexpr uint32_t SKILL_TABLE_SIZE = 2048;  // power of two
+static SkillSlot g_skill_table[SKILL_TABLE_SIZE];
+
 static std::mutex g_cd_mutex;
-static std::unordered_set<uint32_t> g_cd_pending;
+static std::condition_variable g_cd_cv;
+static bool g_cd_workers_stop = false;
+static bool g_cd_preloaded = false;  // workers idle until the on-disk cache is in
+static std::atomic<uint32_t> g_cd_queue_depth{ 0 };
+static std::atomic<bool> g_skill_records_dirty{ false };
+static std::atomic<uint32_t> g_skill_api_build{ 0 };
+static std::atomic<int64_t> g_skill_session_wall{ 0 };   // wall time the workers started
+
+static constexpr int64_t SKILL_CACHE_TTL_S = 7 * 24 * 3600;
+static constexpr int64_t SKILL_NEGATIVE_TTL_S = 24 * 3600;
+static constexpr double SKILL_RETRY_MIN_S = 5.0;    // after a failed request,
+static constexpr double SKILL_RETRY_MAX_S = 600.0;  // doubling up to this
+
+// Finds the slot for sid, claiming a free one if `create`. Null if absent
+// (or the table is full, which tracked skills never get close to).
+static SkillSlot* skill_slot(uint32_t sid, bool create) {
+    if (sid == 0) return nullptr;
+    uint32_t i = (sid * 2654435761u) & (SKILL_TABLE_SIZE - 1);
+    for (uint32_t n = 0; n < SKILL_TABLE_SIZE; ++n, i = (i + 1) & (SKILL_TABLE_SIZE - 1)) {
+        SkillSlot& s = g_skill_table[i];
+        uint32_t cur = s.id.load(std::memory_order_acquire);
+        if (cur == sid) return &s;
+        if (cur != 0) continue;
+        if (!create) return nullptr;
+        if (s.id.compare_exchange_strong(cur, sid, std::memory_order_acq_rel)) return &s;
+        if (cur == sid) return &s;  // lost the race to the same id
+    }
+    return nullptr;
+}
 
+// Moves a slot into PENDING if it is in `from`; true if this call did it.
+static bool skill_slot_enqueue(SkillSlot& s, uint32_t from) {
+    if (!s.state.compare_exchange_strong(from, SR_PENDING, std::memory_order_acq_rel))
+        return false;
+    g_cd_queue_depth.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
 
+// Lock-free; safe from any thread. Requests for ids that are already queued,
+// in flight, resolved or backing off are no-ops.
 static void request_cd_fetch(uint32_t sid) {
-    std::lock_guard<std::mutex> lk(g_cd_mutex);
-    g_cd_pending.insert(sid);  // set semantics: no duplicates
+    SkillSlot* s = skill_slot(sid, true);
+    if (!s) return;
+    const uint32_t st = s->state.load(std::memory_order_acquire);
+    bool queued = false;
+    if (st == SR_UNKNOWN)
+        queued = skill_slot_enqueue(*s, SR_UNKNOWN);
+    else if (st == SR_FAILED && now_s() >= s->retry_at.load(std::memory_order_relaxed))
+        queued = skill_slot_enqueue(*s, SR_FAILED);
+    // notify_one doesn't need g_cd_mutex; a wakeup lost to the race with a
+    // worker going to sleep is picked up by its wait timeout
+    if (queued) g_cd_cv.notify_one();
 }
 
-static bool pop_next_cd_request(uint32_t& out_sid) {
-    std::lock_guard<std::mutex> lk(g_cd_mutex);
-    if (g_cd_pending.empty()) return false;
-    auto it = g_cd_pending.begin();
-    out_sid = *it;
-    g_cd_pending.erase(it);
+// Blocks until there is work (false once the workers are stopping) and moves
+// up to `max` PENDING slots to INFLIGHT.
+static bool wait_cd_batch(std::vector<uint32_t>& out, size_t max) {
+    out.clear();
+    while (out.empty()) {
+        {
+            std::unique_lock<std::mutex> lk(g_cd_mutex);
+            g_cd_cv.wait_for(lk, std::chrono::milliseconds(250), [] {
+                return g_cd_workers_stop ||
+                    (g_cd_preloaded && g_cd_queue_depth.load(std::memory_order_relaxed) > 0);
+            });
+            if (g_cd_workers_stop) return false;
+            if (!g_cd_preloaded) continue;
+        }
+        for (auto& s : g_skill_table) {
+            if (out.size() >= max) break;
+            uint32_t st = SR_PENDING;
+            if (s.state.load(std::memory_order_relaxed) != SR_PENDING) continue;
+            if (!s.state.compare_exchange_strong(st, SR_INFLIGHT, std::memory_order_acq_rel)) continue;
+            g_cd_queue_depth.fetch_sub(1, std::memory_order_relaxed);
+            out.push_back(s.id.load(std::memory_order_relaxed));
+        }
+    }
     return true;
 }
 
+// Settles a batch. With `found` (the request succeeded) every id gets its
+// recharge, or a negative result if the API returned none. Without it the
+// ids back off exponentially; a refresh that fails keeps its old value.
+static void finish_cd_batch(const std::vector<uint32_t>& ids,
+    const std::unordered_map<uint32_t, float>* found) {
+    const int64_t wall = (int64_t)std::time(nullptr);
+    const double now = now_s();
+    const uint32_t build = g_skill_api_build.load(std::memory_order_relaxed);
+    for (auto sid : ids) {
+        SkillSlot* s = skill_slot(sid, false);
+        if (!s) continue;
+
+        if (!found) {
+            if (s->recharge.load(std::memory_order_relaxed) > 0.f) {
+                s->state.store(SR_RESOLVED, std::memory_order_release);
+                continue;
+            }
+            const uint32_t n = s->attempts.fetch_add(1, std::memory_order_relaxed);
+            const double wait = std::min(SKILL_RETRY_MAX_S, SKILL_RETRY_MIN_S * (double)(1u << std::min(n, 10u)));
+            s->retry_at.store(now + wait, std::memory_order_relaxed);
+            s->state.store(SR_FAILED, std::memory_order_release);
+            continue;
+        }
+
+        auto it = found->find(sid);
+        const float cd = (it != found->end() && it->second > 0.f) ? it->second : 0.f;
+        s->attempts.store(0, std::memory_order_relaxed);
+        s->fetched.store(wall, std::memory_order_relaxed);
+        s->build.store(build, std::memory_order_relaxed);
+        s->negative.store(cd <= 0.f, std::memory_order_relaxed);
+        s->recharge.store(cd, std::memory_order_relaxed);
+        if (cd > 0.f) {
+            s->state.store(SR_RESOLVED, std::memory_order_release);
+        }
+        else {
+            s->retry_at.store(now + (double)SKILL_NEGATIVE_TTL_S, std::memory_order_relaxed);
+            s->state.store(SR_FAILED, std::memory_order_release);
+        }
+    }
+    if (found) g_skill_records_dirty = true;
+}
+
+// -------------------- interned names --------------------
+//
+// Process-wide, append-only table for skill names and labels. Timers, tracked
+// rows and peer entries hold a NameId; resolving one never locks or allocates.
+// Strings live in fixed chunks that are never moved, so readers only need the
+// chunk pointer (published with release) to get at a string they were handed.
+
+using NameId = uint32_t;   // 0 is always ""
+
+struct NameTable {
+    static constexpr uint32_t CHUNK_BITS = 8;
+    static constexpr uint32_t CHUNK = 1u << CHUNK_BITS;
+    static constexpr uint32_t MAX_CHUNKS = 1024;
+
+    std::mutex mu;
+    std::atomic<std::string*> chunks[MAX_CHUNKS] = {};
+    uint32_t count = 0;
+    std::unordered_map<std::string_view, NameId> index;   // views into chunks
+
+    NameTable() { intern(std::string_view()); }
+
+    NameId intern(std::string_view s) {
+        std::lock_guard<std::mutex> lk(mu);
+        auto it = index.find(s);
+        if (it != index.end()) return it->second;
+
+        const uint32_t id = count;
+        const uint32_t c = id >> CHUNK_BITS;
+        if (c >= MAX_CHUNKS) return 0;   // full: degrade to ""
+
+        std::string* chunk = chunks[c].load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new std::string[CHUNK];
+            chunks[c].store(chunk, std::memory_order_release);
+        }
+        std::string& slot = chunk[id & (CHUNK - 1)];
+        slot.assign(s.data(), s.size());
+        index.emplace(std::string_view(slot), id);
+        ++count;
+        return id;
+    }
+
+    const std::string& str(NameId id) const {
+        const std::string* chunk = chunks[id >> CHUNK_BITS].load(std::memory_order_acquire);
+        return chunk[id & (CHUNK - 1)];
+    }
+};
+
+static NameTable& name_table() {
+    static NameTable t;
+    return t;
+}
+
+static NameId intern_name(std::string_view s) { return name_table().intern(s); }
+static const std::string& name_str(NameId id) { return name_table().str(id); }
+static const char* name_cstr(NameId id) { return name_table().str(id).c_str(); }
+
+
+
+// Base = 1.0 → 1 second of cooldown removed per 1s real time.
+// Alac: +25% recharge rate → +0.25
+// Chill: -66% recharge rate → -0.66
+// Combined: 1.0 + 0.25 - 0.66 = 0.59
+static double recharge_rate(bool has_alac, bool has_chill) {
+    if (has_alac && has_chill) return 0.753;   // both at once
+    if (has_alac) return 1.25;                 // alacrity only
+    if (has_chill) return 0.602;               // chill only
+    return 1.0;                                // no modifiers
+}
+
+// Self recharge rate as a piecewise-constant function of time. Boon changes
+// append a segment (known expiries are scheduled as future segments), and a
+// timer's recharged amount is F(now) - F(cast) where F is the running
+// integral, so nothing has to be swept when the rate changes.
+struct RateSegment {
+    double start_s = 0.0;
+    double rate = 1.0;
+    double cum = 0.0;      // integral of rate from the origin up to start_s
+};
+
+struct RechargeTimeline {
+    std::vector<RateSegment> segs{ RateSegment{} };   // never empty
+
+    double integral_at(double t) const {
+        auto it = std::upper_bound(segs.begin(), segs.end(), t,
+            [](double v, const RateSegment& s) { return v < s.start_s; });
+        if (it != segs.begin()) --it;
+        return it->cum + it->rate * (t - it->start_s);
+    }
+
+    double integrate(double a, double b) const {
+        if (b <= a) return 0.0;
+        return integral_at(b) - integral_at(a);
+    }
+
+    // Inverse of integrate: the time at which `amount` has recharged since a.
+    double time_when(double a, double amount) const {
+        const double target = integral_at(a) + amount;
+        auto it = std::upper_bound(segs.begin(), segs.end(), target,
+            [](double v, const RateSegment& s) { return v < s.cum; });
+        if (it != segs.begin()) --it;
+        return it->start_s + (target - it->cum) / it->rate;
+    }
+
+    // Latest instant a rate change was recorded at. Earlier times are clamped
+    // to it: recharge before it has already been integrated into timers.
+    double present_s = 0.0;
+
+    // Forget anything scheduled at or after t (keeps at least one segment).
+    void truncate_from(double t) {
+        t = std::max(t, present_s);
+        present_s = t;
+        while (segs.size() > 1 && segs.back().start_s >= t) segs.pop_back();
+    }
+
+    void append(double t, double rate) {
+        t = std::max(t, present_s);
+        const RateSegment& last = segs.back();
+        if (last.rate == rate) return;
+        if (t <= last.start_s) {
+            segs.back().rate = rate;   // same instant (or before origin): replace
+            return;
+        }
+        RateSegment s;
+        s.start_s = t;
+        s.rate = rate;
+        s.cum = last.cum + last.rate * (t - last.start_s);
+        segs.push_back(s);
+    }
 
+    // Drop segments that end before t; integrals stay relative, so cum is untouched.
+    void drop_before(double t) {
+        auto it = std::upper_bound(segs.begin(), segs.end(), t,
+            [](double v, const RateSegment& s) { return v < s.start_s; });
+        if (it != segs.begin()) --it;
+        segs.erase(segs.begin(), it);
+    }
+};
 
 struct SlotTimer {
     uint32_t skillid = 0;
-    std::string name;
+    NameId name = 0;
+    const char* name_src = nullptr;   // arcdps pointer name was interned from
     float  base_cd = 0.f;
     double last_cast_s = -1.0;
-    double last_update_s = -1.0;
-    float  elapsed = 0.f;
+    bool   done = false;              // fully recharged; no longer pins the timeline
+    bool   wheel_armed = false;       // waiting in g_ready_wheel
+    bool   ready = true;              // ready transition fired, or never cast
+    uint32_t wheel_gen = 0;
 
     bool   cancel_active = false;
     double cancel_start_s = -1.0;
 
     void on_cast(double now_s_val) {
         last_cast_s = now_s_val;
-        last_update_s = now_s_val;
-        elapsed = 0.f;
+        done = false;
         cancel_active = false;
         cancel_start_s = -1.0;
     }
 
     void start_cancel_cd(double now_s_val) {
         last_cast_s = -1.0;
-        last_update_s = -1.0;
-        elapsed = 0.f;
+        done = false;
         cancel_active = true;
         cancel_start_s = now_s_val;
     }
 
-    void advance(double now_s_val, bool has_alac, bool has_chill) {
-        if (cancel_active)
-            return;
-
-        if (last_cast_s < 0 || base_cd <= 0) return;
-        if (last_update_s < 0) last_update_s = last_cast_s;
-
-        double dt = now_s_val - last_update_s;
-        if (dt <= 0.0) return;
-
-        // Base = 1.0 → 1 second of cooldown removed per 1s real time.
-        // Alac: +25% recharge rate → +0.25
-        // Chill: -66% recharge rate → -0.66
-        // Combined: 1.0 + 0.25 - 0.66 = 0.59
-        float rate = 1.0f;
-
-        if (has_alac && has_chill) {
-            rate = 0.753f;      // both at once
-        }
-        else if (has_alac) {
-            rate = 1.25f;       // alacrity only
-        }
-        else if (has_chill) {
-            rate = 0.602f;      // chill only
-        }
-        else {
-            rate = 1.0f;        // no modifiers
-        }
-
-        elapsed += float(dt * rate);
-        if (elapsed > base_cd) elapsed = base_cd;
-
-        last_update_s = now_s_val;
-    }
-
-
-    // RAW remaining time, no NET_OFFSET. This returns:
+    // RAW remaining time. This returns:
     // - for cancel_active: 0..CANCEL_COOLDOWN
     // - for normal: remaining cooldown in seconds
-    float predict_left_raw(double now_s_val, bool has_alac, bool has_chill) {
+    float predict_left_raw(double now_s_val, const RechargeTimeline& tl) {
         // --- Fake cancel cooldown path (no boon scaling) ---
         if (cancel_active) {
             if (cancel_start_s < 0.0) {
@@ -203,25 +493,25 @@ struct SlotTimer {
         }
 
         // --- Normal cooldown path ---
-        advance(now_s_val, has_alac, has_chill);
-
         if (last_cast_s < 0 || base_cd <= 0) return -1.f;
+        if (done) return 0.f;
 
-        float remaining = base_cd - elapsed;
-        if (remaining <= 0.f) return 0.f;
+        float remaining = float(base_cd - tl.integrate(last_cast_s, now_s_val));
+        if (remaining <= 0.f) {
+            done = true;
+            return 0.f;
+        }
 
         return remaining;
     }
 };
 
 
-
-
 struct TrackedEntry {
     bool enabled = true;
     uint32_t skillid = 0;
     float base_cd = 0.f;
-    std::string label = "Label";
+    NameId label = intern_name("Label");
 };
 
 struct SelfContext {
@@ -232,10 +522,13 @@ struct SelfContext {
     uint32_t elite = 0;    // NEW: current elite spec id
 };
 
+// Labels from the network stay plain strings owned by the snapshot: interning
+// them would let any peer grow the process-wide name table without bound.
 struct PeerEntry {
     std::string label;
     bool ready = false;
     float left = -1.f;
+    int64_t ready_at = 0;   // relay clock ms, 0 if the peer didn't send one
 };
 
 struct Peer {
@@ -246,37 +539,228 @@ struct Peer {
     uint32_t elite = 0;
     uint32_t subgroup = 0;
     std::vector<PeerEntry> entries;
+    // the peer's own measurement against the relay clock (see "relay clock")
+    bool clock_known = false;
+    uint32_t rtt_ms = 0;
+    int32_t clock_offset_ms = 0;
 };
 
 static std::mutex g_mutex;
 static SelfContext g_self;
 static std::unordered_map<uint32_t, SlotTimer> g_by_skill;
 
+// -------------------- ready-transition wheel --------------------
+//
+// Each running timer sits in a two-level timer wheel at its predicted ready
+// time and fires once when that tick passes. A timer's wheel_gen is bumped on
+// every (re)schedule, so stale entries from before a recast or a boon change
+// are simply skipped when their slot comes up.
+
+using ReadyListener = void(*)(uint32_t skillid, double now_s_val);
+static std::vector<ReadyListener> g_ready_listeners;
+
+static void subscribe_ready_transitions(ReadyListener fn) {
+    g_ready_listeners.push_back(fn);
+}
+
+struct TimerWheel {
+    static constexpr double TICK_S = 0.05;
+    static constexpr int64_t L0 = 64;          // 3.2 s of 50 ms ticks
+    static constexpr int64_t L1 = 64;          // 64 x 3.2 s = ~205 s
+
+    struct Item {
+        uint32_t skillid;
+        uint32_t gen;
+        int64_t  due;                          // tick
+    };
+
+    std::vector<Item> l0[L0];
+    std::vector<Item> l1[L1];
+    std::vector<Item> far;
+    int64_t cur = -1;                          // last processed tick
+
+    static int64_t tick_of(double t) { return (int64_t)std::floor(t / TICK_S); }
+
+    void place(const Item& it) {
+        const int64_t due = std::max(it.due, cur + 1);
+        const int64_t delta = due - cur;
+        if (delta < L0) l0[due % L0].push_back(it);
+        else if (delta < L0 * L1) l1[(due / L0) % L1].push_back(it);
+        else far.push_back(it);
+    }
+
+    void schedule(uint32_t sid, uint32_t gen, double due_s, double now_s_val) {
+        if (cur < 0) cur = tick_of(now_s_val) - 1;
+        place(Item{ sid, gen, tick_of(due_s) });
+    }
+
+    // Items already due at cur fire here: place() would push them to the
+    // next tick.
+    template <class Fire>
+    void cascade(std::vector<Item>& from, Fire& fire) {
+        std::vector<Item> items;
+        items.swap(from);
+        for (auto& it : items) {
+            if (it.due <= cur) fire(it);
+            else place(it);
+        }
+    }
+
+    template <class Fire>
+    void advance(double now_s_val, Fire&& fire) {
+        const int64_t target = tick_of(now_s_val);
+        if (cur < 0) cur = target - 1;
+
+        // Long stall (nobody ticked for minutes): collect everything once.
+        if (target - cur > L0 * L1) {
+            std::vector<Item> all;
+            for (auto& v : l0) { all.insert(all.end(), v.begin(), v.end()); v.clear(); }
+            for (auto& v : l1) { all.insert(all.end(), v.begin(), v.end()); v.clear(); }
+            all.insert(all.end(), far.begin(), far.end());
+            far.clear();
+            cur = target;
+            for (auto& it : all) {
+                if (it.due <= cur) fire(it);
+                else place(it);
+            }
+            return;
+        }
+
+        while (cur < target) {
+            ++cur;
+            if (cur % (L0 * L1) == 0) cascade(far, fire);
+            if (cur % L0 == 0) cascade(l1[(cur / L0) % L1], fire);
+
+            std::vector<Item> slot;
+            slot.swap(l0[cur % L0]);
+            for (auto& it : slot) {
+                if (it.due <= cur) fire(it);
+                else place(it);
+            }
+        }
+    }
+};
+
+static TimerWheel g_ready_wheel;   // g_mutex
+
 static double g_alac_until_s = 0.0;
 static double g_chill_until_s = 0.0;
+static RechargeTimeline g_recharge;
+
+// Predicted time the timer becomes ready, or < 0 if unknown.
+static double predict_ready_s_locked(const SlotTimer& st) {
+    if (st.cancel_active)
+        return st.cancel_start_s < 0.0 ? -1.0 : st.cancel_start_s + CANCEL_COOLDOWN;
+    if (st.last_cast_s < 0.0 || st.base_cd <= 0.f) return -1.0;
+    return g_recharge.time_when(st.last_cast_s, st.base_cd);
+}
+
+static void schedule_ready_locked(SlotTimer& st, double now_s_val) {
+    ++st.wheel_gen;
+    const double t = predict_ready_s_locked(st);
+    st.wheel_armed = t >= 0.0;
+    st.ready = !st.wheel_armed && st.last_cast_s < 0.0 && !st.cancel_active;
+    if (st.wheel_armed)
+        g_ready_wheel.schedule(st.skillid, st.wheel_gen, t, now_s_val);
+}
+
+// Recharge rate changed: everything still waiting gets a new ready time.
+static void reschedule_armed_timers_locked(double now_s_val) {
+    for (auto& kv : g_by_skill) {
+        if (kv.second.wheel_armed) schedule_ready_locked(kv.second, now_s_val);
+    }
+}
+
+static void tick_ready_wheel_locked(double now_s_val) {
+    g_ready_wheel.advance(now_s_val, [&](const TimerWheel::Item& it) {
+        auto found = g_by_skill.find(it.skillid);
+        if (found == g_by_skill.end()) return;
+        SlotTimer& st = found->second;
+        if (!st.wheel_armed || st.wheel_gen != it.gen) return;   // stale entry
+
+        // Tick granularity: fire if we're within one tick of ready.
+        const double t = predict_ready_s_locked(st);
+        if (t > now_s_val + TimerWheel::TICK_S) {
+            g_ready_wheel.schedule(st.skillid, st.wheel_gen, t, now_s_val);
+            return;
+        }
+        st.wheel_armed = false;
+        st.ready = true;
+        for (auto fn : g_ready_listeners) fn(st.skillid, now_s_val);
+        });
+}
+
+static constexpr size_t RECHARGE_PRUNE_AT = 64;
+static constexpr double RECHARGE_MAX_UNKNOWN_S = 600.0;   // cast with no base_cd yet
+
+// Drop timeline history no running timer can still ask about.
+static void prune_recharge_timeline_locked(double now_s_val) {
+    double oldest = now_s_val;
+    for (auto& kv : g_by_skill) {
+        SlotTimer& st = kv.second;
+        if (st.cancel_active || st.done || st.last_cast_s < 0.0) continue;
+        if (st.base_cd > 0.f) {
+            if (st.predict_left_raw(now_s_val, g_recharge) <= 0.f) continue;
+        }
+        else if (now_s_val - st.last_cast_s > RECHARGE_MAX_UNKNOWN_S) {
+            continue;
+        }
+        oldest = std::min(oldest, st.last_cast_s);
+    }
+    g_recharge.drop_before(oldest);
+}
+
+// Record self boon state as of now_s_val: the current rate plus the rate
+// changes already implied by known expiry times.
+static void set_self_boons_locked(double now_s_val, bool alac, double alac_until_s,
+    bool chill, double chill_until_s) {
+    g_self.has_alacrity = alac;
+    g_self.has_chill = chill;
+    g_alac_until_s = alac ? alac_until_s : 0.0;
+    g_chill_until_s = chill ? chill_until_s : 0.0;
+
+    g_recharge.truncate_from(now_s_val);
+    g_recharge.append(now_s_val, recharge_rate(alac, chill));
+
+    const bool a_ends = alac && g_alac_until_s > now_s_val;
+    const bool c_ends = chill && g_chill_until_s > now_s_val;
+    if (a_ends && c_ends) {
+        if (g_alac_until_s <= g_chill_until_s) {
+            g_recharge.append(g_alac_until_s, recharge_rate(false, true));
+            g_recharge.append(g_chill_until_s, recharge_rate(false, false));
+        }
+        else {
+            g_recharge.append(g_chill_until_s, recharge_rate(true, false));
+            g_recharge.append(g_alac_until_s, recharge_rate(false, false));
+        }
+    }
+    else if (a_ends) {
+        g_recharge.append(g_alac_until_s, recharge_rate(false, chill));
+    }
+    else if (c_ends) {
+        g_recharge.append(g_chill_until_s, recharge_rate(alac, false));
+    }
+
+    if (g_recharge.segs.size() > RECHARGE_PRUNE_AT)
+        prune_recharge_timeline_locked(now_s_val);
+
+    reschedule_armed_timers_locked(now_s_val);
+}
 
-static void advance_all_timers_locked(double now_s_val) {
-    // Start from current flags
-    bool has_alac = g_self.has_alacrity;
-    bool has_chill = g_self.has_chill;
+static void clear_self_boons_locked(double now_s_val) {
+    set_self_boons_locked(now_s_val, false, 0.0, false, 0.0);
+}
 
-    // Expire Alacrity if its timeout passed
-    if (has_alac && g_alac_until_s > 0.0 && now_s_val >= g_alac_until_s) {
-        has_alac = false;
+// The timeline already has the expiry; this just keeps the flags honest.
+static void expire_self_boon_flags_locked(double now_s_val) {
+    if (g_self.has_alacrity && g_alac_until_s > 0.0 && now_s_val >= g_alac_until_s) {
         g_self.has_alacrity = false;
         g_alac_until_s = 0.0;
     }
-
-    // Expire Chill if its timeout passed
-    if (has_chill && g_chill_until_s > 0.0 && now_s_val >= g_chill_until_s) {
-        has_chill = false;
+    if (g_self.has_chill && g_chill_until_s > 0.0 && now_s_val >= g_chill_until_s) {
         g_self.has_chill = false;
         g_chill_until_s = 0.0;
     }
-
-    for (auto& kv : g_by_skill) {
-        kv.second.advance(now_s_val, has_alac, has_chill);
-    }
 }
 
 static std::vector<TrackedEntry> g_tracked;
@@ -285,14 +769,92 @@ static double g_pick_armed_until_s = 0.0;
 static uint64_t g_last_ev_ms = 0;
 static uint64_t g_pick_not_before_ms = 0;
 
+// Tracked skill ids as a sorted array, readable from on_combat without a lock.
+// Seqlock: the writer (g_mutex held) makes `seq` odd while it rewrites the
+// array. A reader that overlaps a write answers "wanted", which only costs the
+// consumer a classification; a tracked cast is never dropped.
+struct TrackedFilter {
+    static constexpr uint32_t CAP = 64;
+    static constexpr uint32_t PASS_ALL = UINT32_MAX;   // too many rows to index
+
+    std::atomic<uint32_t> ids[CAP];
+    std::atomic<uint32_t> count{ 0 };
+    std::atomic<uint32_t> seq{ 0 };
+    std::atomic<double>   pick_until_s{ 0.0 };   // now_s() domain; 0 when not picking
+
+    bool wants(uint32_t sid, double now) const {
+        const double pick_until = pick_until_s.load(std::memory_order_relaxed);
+        if (pick_until > 0.0 && now <= pick_until) return true;
+
+        const uint32_t s0 = seq.load(std::memory_order_acquire);
+        if (s0 & 1u) return true;
+        const uint32_t n = count.load(std::memory_order_relaxed);
+        bool found = n > CAP;   // PASS_ALL
+        uint32_t lo = 0, hi = found ? 0 : n;
+        while (lo < hi) {
+            const uint32_t mid = (lo + hi) / 2;
+            const uint32_t v = ids[mid].load(std::memory_order_relaxed);
+            if (v == sid) { found = true; break; }
+            if (v < sid) lo = mid + 1;
+            else hi = mid;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return found || seq.load(std::memory_order_relaxed) != s0;
+    }
+
+    void publish(const std::vector<uint32_t>& sorted) {
+        const uint32_t s0 = seq.load(std::memory_order_relaxed);
+        seq.store(s0 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (sorted.size() > CAP) {
+            count.store(PASS_ALL, std::memory_order_relaxed);
+        }
+        else {
+            for (size_t i = 0; i < sorted.size(); ++i)
+                ids[i].store(sorted[i], std::memory_order_relaxed);
+            count.store((uint32_t)sorted.size(), std::memory_order_relaxed);
+        }
+        seq.store(s0 + 2, std::memory_order_release);
+    }
+};
+
+static TrackedFilter g_tracked_filter;
+
+// Call whenever a row is added/removed or its skill id changes.
+static void rebuild_tracked_filter_locked() {
+    std::vector<uint32_t> ids;
+    ids.reserve(g_tracked.size());
+    for (auto& e : g_tracked) {
+        if (e.skillid) ids.push_back(e.skillid);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    g_tracked_filter.publish(ids);
+}
+
+static void arm_pick_locked(int row, double until_s) {
+    g_pick_row = row;
+    g_pick_armed_until_s = until_s;
+    g_tracked_filter.pick_until_s.store(row >= 0 ? until_s : 0.0, std::memory_order_relaxed);
+}
+
+static void disarm_pick_locked() {
+    arm_pick_locked(-1, 0.0);
+}
+
 static std::string g_client_id;
 static std::string g_assigned_name = "cds";
-static std::vector<Peer> g_peers;
 
 static std::unordered_map<uint32_t, std::vector<std::string>> g_group_order;
 static std::unordered_set<uint32_t> g_group_order_dirty;
 static bool g_overlay_enabled = true;
+static bool g_ready_sound = false;
 static bool g_in_map_change = false;
+static double g_map_change_s = 0.0;            // when it started
+static bool g_map_change_saw_loading = false;  // its loading screen came up
+static bool g_self_in_combat = false;
+static double g_last_tracked_cast_s = -1e9;   // now_s() domain
+static std::atomic<bool> g_game_loading{ false };  // char select or loading screen
 static bool g_options_drawn_this_frame = false;
 
 static bool  g_tracked_open_prev = false;
@@ -302,15 +864,102 @@ static bool  g_tracked_added_row = false;
 static uint32_t g_self_prof = 0;
 static std::string g_self_charname;
 static std::string g_self_accountname;
-static std::unordered_set<std::string> g_squad_accounts;
-static std::unordered_set<std::string> g_dead_accounts;
 
-static json g_cached_raw;
+// Squad roster keyed by arcdps agent id (src->id on both combat events and
+// agent notifications). Names are copied once when an agent first shows up;
+// after that, squad / down state changes are O(1) field writes. Members are
+// evicted when arcdps reports them removed.
+struct RosterMember {
+    std::string name;       // character name
+    std::string account;    // account name from the agent notification
+    bool in_squad = false;
+    bool dead = false;
+    uint32_t gen = 0;       // g_roster_gen at last change
+};
+
+static std::unordered_map<uint64_t, RosterMember> g_roster;
+static uint32_t g_roster_gen = 0;
+
+// UI-side view of g_roster, rebuilt only when g_roster_gen moves.
+struct RosterView {
+    uint32_t gen = UINT32_MAX;
+    std::unordered_set<std::string> squad;
+    std::unordered_set<std::string> dead;
+};
+
+static RosterMember& roster_touch_locked(uint64_t id, const char* name) {
+    auto it = g_roster.find(id);
+    if (it != g_roster.end()) {
+        RosterMember& m = it->second;
+        if (m.name.empty() && name && *name) {
+            // first seen without a character name
+            m.name = name;
+            m.gen = ++g_roster_gen;
+        }
+        return m;
+    }
+
+    RosterMember& m = g_roster[id];
+    if (name) m.name = name;
+    m.gen = ++g_roster_gen;
+    return m;
+}
+
+static void roster_remove_locked(uint64_t id) {
+    if (g_roster.erase(id)) ++g_roster_gen;
+}
+
+static void roster_clear_locked() {
+    g_roster.clear();
+    ++g_roster_gen;
+}
+
+static void refresh_roster_view_locked(RosterView& v) {
+    if (v.gen == g_roster_gen) return;
+    v.squad.clear();
+    v.dead.clear();
+    for (auto& kv : g_roster) {
+        const RosterMember& m = kv.second;
+        if (m.in_squad) {
+            if (!m.name.empty()) v.squad.insert(m.name);
+            if (!m.account.empty()) v.squad.insert(m.account);
+        }
+        if (m.dead) {
+            if (!m.name.empty()) v.dead.insert(m.name);
+            if (!m.account.empty()) v.dead.insert(m.account);
+        }
+    }
+    v.gen = g_roster_gen;
+}
+
 static double g_last_label_edit_s = -1.0;
 static bool g_label_save_pending = false;
 static constexpr double LABEL_SAVE_DELAY_S = 30.0;
 static std::atomic<bool> g_settings_dirty{ false };
 
+// Ready-transition consumers (see g_ready_wheel)
+static constexpr double READY_FLASH_S = 1.5;
+static std::unordered_map<uint32_t, double> g_ready_flash_until;   // g_mutex
+static std::atomic<bool> g_push_requested{ false };
+static std::atomic<bool> g_ready_beep_pending{ false };   // set under g_mutex, played after
+
+// Wakes net_loop early; g_net_wake_mutex only guards its wait.
+static std::mutex g_net_wake_mutex;
+static std::condition_variable g_net_wake_cv;
+
+static void request_push_now() {
+    g_push_requested.store(true, std::memory_order_relaxed);
+    g_net_wake_cv.notify_one();
+}
+
+// Ready cue, played once the caller has released g_mutex.
+static void play_ready_beep() {
+    if (!g_ready_beep_pending.exchange(false, std::memory_order_relaxed)) return;
+#ifdef _WIN32
+    MessageBeep(MB_OK);
+#endif
+}
+
 
 static wchar_t* (__cdecl* arc_e0)() = nullptr;
 static void(__cdecl* arc_e3)(char*) = nullptr;
@@ -434,7 +1083,16 @@ static const char* icon_for_prof_elite(uint32_t prof, uint32_t elite) {
 
 
 
+#ifdef _WIN32
+static constexpr wchar_t PATH_SEP = L'\\';
+#else
+static constexpr wchar_t PATH_SEP = L'/';
+#endif
+
 static std::wstring dll_dir() {
+#ifndef _WIN32
+    return L".";
+#else
     wchar_t buf[MAX_PATH];
     GetModuleFileNameW((HMODULE)&__ImageBase, buf, MAX_PATH);
     std::wstring p(buf);
@@ -445,14 +1103,37 @@ static std::wstring dll_dir() {
         : (p2 == std::wstring::npos ? p1 : (p1 > p2 ? p1 : p2));
     if (pos != std::wstring::npos) p.resize(pos);
     return p;
+#endif
+}
+
+static std::wstring dll_file(const wchar_t* name) {
+    return dll_dir() + PATH_SEP + name;
+}
+
+static FILE* open_file(const std::wstring& path, const wchar_t* mode) {
+#ifdef _WIN32
+    return _wfopen(path.c_str(), mode);
+#else
+    // our own file names are ASCII and the directory is "."
+    return std::fopen(std::string(path.begin(), path.end()).c_str(),
+        std::string(mode, mode + std::wcslen(mode)).c_str());
+#endif
 }
 
 static std::wstring settings_path() {
-    return dll_dir() + L"\\arcdps_cooldowns.json";
+    return dll_file(L"arcdps_cooldowns.json");
+}
+
+static std::wstring skill_cache_path() {
+    return dll_file(L"arcdps_cooldowns_skills.json");
+}
+
+static std::wstring net_stats_path() {
+    return dll_file(L"arcdps_cooldowns_netstats.json");
 }
 
 static std::string read_file_utf8(const std::wstring& path) {
-    FILE* f = _wfopen(path.c_str(), L"rb");
+    FILE* f = open_file(path, L"rb");
     if (!f) return {};
     fseek(f, 0, SEEK_END);
     long n = ftell(f);
@@ -464,11 +1145,20 @@ static std::string read_file_utf8(const std::wstring& path) {
     return s;
 }
 
+// Writes a temp file next to `path` and renames it over the old one, so a
+// crash mid-write leaves the previous file rather than a truncated one.
 static void write_file_utf8(const std::wstring& path, const std::string& s) {
-    FILE* f = _wfopen(path.c_str(), L"wb");
+    const std::wstring tmp = path + L".tmp";
+    FILE* f = open_file(tmp, L"wb");
     if (!f) return;
-    fwrite(s.data(), 1, s.size(), f);
-    fclose(f);
+    const bool ok = fwrite(s.data(), 1, s.size(), f) == s.size() && fflush(f) == 0;
+    if (fclose(f) != 0 || !ok) return;
+#ifdef _WIN32
+    MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    std::rename(std::string(tmp.begin(), tmp.end()).c_str(),
+        std::string(path.begin(), path.end()).c_str());
+#endif
 }
 
 static void save_settings_all() {
@@ -481,6 +1171,14 @@ static void save_settings_all() {
     j["share_enabled"] = g_share_enabled;
     j["use_https"] = g_use_https;
     j["overlay_enabled"] = g_overlay_enabled;
+    j["ready_sound"] = g_ready_sound;
+    j["socket_transport"] = g_use_socket_transport.load();
+    j["binary_wire"] = g_binary_wire.load();
+    j["compress"] = g_http_compress.load();
+    j["udp"] = g_udp_enabled.load();
+    j["skill_api_host"] = g_skill_api_host;
+    j["skill_api_port"] = g_skill_api_port;
+    j["skill_api_https"] = g_skill_api_https;
 
     j["tracked"] = json::array();
     for (auto& e : g_tracked) {
@@ -488,7 +1186,7 @@ static void save_settings_all() {
         t["enabled"] = e.enabled;
         t["skillid"] = e.skillid;
         t["base_cd"] = e.base_cd;
-        t["label"] = e.label;
+        t["label"] = name_str(e.label);
         j["tracked"].push_back(t);
     }
 
@@ -516,6 +1214,14 @@ static void load_settings_all() {
         if (j.contains("share_enabled")) g_share_enabled = j["share_enabled"].get<bool>();
         if (j.contains("use_https")) g_use_https = j["use_https"].get<bool>();
         if (j.contains("overlay_enabled")) g_overlay_enabled = j["overlay_enabled"].get<bool>();
+        if (j.contains("ready_sound")) g_ready_sound = j["ready_sound"].get<bool>();
+        if (j.contains("socket_transport")) g_use_socket_transport = j["socket_transport"].get<bool>();
+        if (j.contains("binary_wire")) g_binary_wire = j["binary_wire"].get<bool>();
+        if (j.contains("compress")) g_http_compress = j["compress"].get<bool>();
+        if (j.contains("udp")) g_udp_enabled = j["udp"].get<bool>();
+        if (j.contains("skill_api_host")) g_skill_api_host = j["skill_api_host"].get<std::string>();
+        if (j.contains("skill_api_port")) g_skill_api_port = j["skill_api_port"].get<int>();
+        if (j.contains("skill_api_https")) g_skill_api_https = j["skill_api_https"].get<bool>();
 
         g_tracked.clear();
         if (j.contains("tracked")) {
@@ -524,10 +1230,11 @@ static void load_settings_all() {
                 e.enabled = t.value("enabled", true);
                 e.skillid = t.value("skillid", 0u);
                 e.base_cd = t.value("base_cd", 0.f);
-                e.label = t.value("label", std::string("Label"));
+                e.label = intern_name(t.value("label", std::string("Label")));
                 g_tracked.push_back(e);
             }
         }
+        rebuild_tracked_filter_locked();
 
         g_group_order.clear();
         if (j.contains("group_order") && j["group_order"].is_object()) {
@@ -542,161 +1249,1083 @@ static void load_settings_all() {
     catch (...) {}
 }
 
-static bool http_post_json(const std::string& host, int port, bool secure,
-    const std::wstring& path, const std::string& body,
-    std::string* out) {
-    bool ok = false;
-    HINTERNET hS = nullptr, hC = nullptr, hR = nullptr;
-    std::string resp;
-
-    hS = WinHttpOpen(L"ArcCooldowns/0.81", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
-        WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-    if (!hS) goto cleanup;
-
-    hC = WinHttpConnect(hS, std::wstring(host.begin(), host.end()).c_str(),
-        (INTERNET_PORT)port, 0);
-    if (!hC) goto cleanup;
-
-    hR = WinHttpOpenRequest(hC,
-        L"POST",
-        path.c_str(),
-        nullptr,
-        WINHTTP_NO_REFERER,
-        WINHTTP_DEFAULT_ACCEPT_TYPES,
-        secure ? WINHTTP_FLAG_SECURE : 0);
-    if (!hR) goto cleanup;
-
-    {
-        std::wstring hdr = L"Content-Type: application/json\r\n";
-        if (!WinHttpSendRequest(hR, hdr.c_str(), (DWORD)hdr.size(),
-            (LPVOID)body.data(), (DWORD)body.size(),
-            (DWORD)body.size(), 0)) goto cleanup;
-        if (!WinHttpReceiveResponse(hR, nullptr)) goto cleanup;
-
-        DWORD avail = 0;
-        do {
-            if (!WinHttpQueryDataAvailable(hR, &avail)) break;
-            if (!avail) break;
-            size_t old = resp.size();
-            resp.resize(old + avail);
-            DWORD read = 0;
-            if (!WinHttpReadData(hR, resp.data() + old, avail, &read)) break;
-            resp.resize(old + read);
-        } while (avail > 0);
+// -------------------- HTTP transport --------------------
+
+// Response of one exchange. `body` is cleared and refilled in place, so a
+// caller that keeps its HttpResponse around reuses the allocation.
+struct HttpResponse {
+    int status = 0;
+    std::string content_type;
+    std::string content_encoding;  // as received; http_get/http_post decode gzip
+    std::string body;
+    bool new_connection = false;   // this request had to open a connection first
+    int retry_after_s = -1;        // Retry-After in seconds, -1 if absent
+};
 
-        ok = true;
-    }
+using StreamSink = std::function<bool(const char* data, size_t len)>;
+
+// Long-lived connection layer. Implementations keep one session per host and
+// reuse keep-alive connections. An idempotent request whose pooled connection
+// turns out to be dead (closed or reset before any reply) is retried once on a
+// fresh one; timeouts and POSTs are not, the callers have their own schedule.
+class HttpTransport {
+public:
+    virtual ~HttpTransport() = default;
+    virtual const char* name() const = 0;
+    // `body` is only used for POST; `headers` are extra CRLF-terminated header
+    // lines (Content-Type, Accept, ...) or null. Connecting is bounded by
+    // HTTP_CONNECT_TIMEOUT_MS, the whole exchange by roughly `timeout_ms`.
+    virtual bool request(const char* method, const std::string& host, int port,
+        bool secure, const std::wstring& path, const std::string* body,
+        const char* headers, int timeout_ms, HttpResponse& out) = 0;
+    // Long-lived GET whose body is handed to `sink` as it arrives. Returns when
+    // the server closes, the sink returns false, the link stays silent for
+    // STREAM_IDLE_MS or cancel_stream() is called; false if no 200 response
+    // was opened. One stream per transport at a time.
+    virtual bool stream(const std::string& host, int port, bool secure,
+        const std::wstring& path, const StreamSink& sink) = 0;
+    // Abort the running stream() from another thread; later stream() calls
+    // return immediately until reset().
+    virtual void cancel_stream() = 0;
+    // Same for every request() in flight, on any thread.
+    virtual void cancel_requests() = 0;
+    // Close every pooled handle; the next request reconnects.
+    virtual void reset() = 0;
+
+    std::atomic<uint64_t> requests{ 0 };
+    std::atomic<uint64_t> failures{ 0 };
+    std::atomic<uint64_t> connects{ 0 };
+    std::atomic<uint64_t> retries{ 0 };
+};
 
-cleanup:
-    if (ok && out) *out = resp;
-    if (hR) WinHttpCloseHandle(hR);
-    if (hC) WinHttpCloseHandle(hC);
-    if (hS) WinHttpCloseHandle(hS);
-    return ok;
+static constexpr size_t HTTP_CHUNK = 8192;
+static constexpr int STREAM_IDLE_MS = 15000;   // relay pings open streams every 5 s
+static constexpr int HTTP_DEADLINE_MS = 2500;   // default per-request limit, see http_post
+static constexpr int HTTP_CONNECT_TIMEOUT_MS = 2000;
+static constexpr int RETRY_AFTER_DEFAULT_S = 5; // for the HTTP-date form, which we don't parse
+
+// Seconds from a Retry-After header value; -1 if it is empty.
+static int parse_retry_after(std::string_view v) {
+    while (!v.empty() && v.front() == ' ') v.remove_prefix(1);
+    if (v.empty()) return -1;
+    if (!std::isdigit((unsigned char)v.front())) return RETRY_AFTER_DEFAULT_S;
+    return (int)std::min(std::strtol(std::string(v).c_str(), nullptr, 10), 86400L);
 }
 
-static bool http_get(const std::string& host, int port, bool secure,
-    const std::wstring& path, std::string* out) {
-    bool ok = false;
-    HINTERNET hS = nullptr, hC = nullptr, hR = nullptr;
-    std::string resp;
-
-    hS = WinHttpOpen(L"ArcCooldowns/0.81", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
-        WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-    if (!hS) goto cleanup;
-
-    hC = WinHttpConnect(hS, std::wstring(host.begin(), host.end()).c_str(),
-        (INTERNET_PORT)port, 0);
-    if (!hC) goto cleanup;
-
-    hR = WinHttpOpenRequest(hC,
-        L"GET",
-        path.c_str(),
-        nullptr,
-        WINHTTP_NO_REFERER,
-        WINHTTP_DEFAULT_ACCEPT_TYPES,
-        secure ? WINHTTP_FLAG_SECURE : 0);
-    if (!hR) goto cleanup;
-
-    if (!WinHttpSendRequest(hR, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-        WINHTTP_NO_REQUEST_DATA, 0, 0, 0)) goto cleanup;
-    if (!WinHttpReceiveResponse(hR, nullptr)) goto cleanup;
-
-    DWORD avail = 0;
-    do {
-        if (!WinHttpQueryDataAvailable(hR, &avail)) break;
-        if (!avail) break;
-        size_t old = resp.size();
-        resp.resize(old + avail);
-        DWORD read = 0;
-        if (!WinHttpReadData(hR, resp.data() + old, avail, &read)) break;
-        resp.resize(old + read);
-    } while (avail > 0);
-
-    ok = true;
-
-cleanup:
-    if (ok && out) *out = resp;
-    if (hR) WinHttpCloseHandle(hR);
-    if (hC) WinHttpCloseHandle(hC);
-    if (hS) WinHttpCloseHandle(hS);
-    return ok;
+// Only these are retried after a dead pooled connection; a POST may already
+// have been applied by the relay.
+static bool http_idempotent(const char* method) {
+    return std::strcmp(method, "GET") == 0 || std::strcmp(method, "HEAD") == 0;
 }
 
-// -------------------- JSON helper --------------------
-
-static bool parse_root_object(const std::string& resp_raw, json& jr) {
-    try {
-        if (resp_raw.empty()) return false;
+// ---- WinHTTP ----
+
+#ifdef _WIN32
+
+// One WinHTTP session for the process and one connect handle per host:port.
+// WinHTTP pools the keep-alive sockets (and TLS sessions) underneath the
+// session handle, so reusing it is what removes the per-call handshake.
+//
+// A request handle belongs to the thread that opened it and only that thread
+// closes it. Cancelling closes the parent handles instead: cancel_requests()
+// the shared session and its connect handles, cancel_stream() the stream's
+// own session. Request handles are opened under m_, so none is opened from a
+// parent that is being closed.
+class WinHttpTransport final : public HttpTransport {
+public:
+    const char* name() const override { return "winhttp"; }
+
+    bool request(const char* method, const std::string& host, int port,
+        bool secure, const std::wstring& path, const std::string* body,
+        const char* headers, int timeout_ms, HttpResponse& out) override {
+        requests.fetch_add(1, std::memory_order_relaxed);
+        out.new_connection = false;
+        bool created = false;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (int attempt = 0; attempt < 2 && !requests_cancelled_; ++attempt) {
+            // the retry only gets what is left of the deadline
+            const int left_ms = attempt == 0 ? timeout_ms : (int)std::chrono::duration_cast<
+                std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left_ms <= 0) break;
+            if (attempt > 0) retries.fetch_add(1, std::memory_order_relaxed);
+            bool dead_conn = false;
+            if (exchange(host, port, method, secure, path, body, headers, left_ms, out,
+                    created, dead_conn)) {
+                // WinHTTP hides its socket pool; a new connect handle is the
+                // closest we get to "this one paid for the handshake"
+                out.new_connection = created;
+                return true;
+            }
+            if (!dead_conn || !http_idempotent(method)) break;
+        }
+        failures.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
 
-        // Strip any embedded NULs just in case
-        std::string resp;
-        resp.reserve(resp_raw.size());
-        for (unsigned char c : resp_raw) {
-            if (c == '\0') continue;
-            resp.push_back(static_cast<char>(c));
+    bool stream(const std::string& host, int port, bool secure,
+        const std::wstring& path, const StreamSink& sink) override {
+        HINTERNET hC = nullptr, hR = nullptr;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stream_cancelled_) return false;
+            if (!stream_session_) stream_session_ = open_session();
+            if (!stream_session_) return false;
+            hC = WinHttpConnect(stream_session_, std::wstring(host.begin(), host.end()).c_str(),
+                (INTERNET_PORT)port, 0);
+            if (!hC) return false;
+            hR = WinHttpOpenRequest(hC, L"GET", path.c_str(), nullptr,
+                WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                secure ? WINHTTP_FLAG_SECURE : 0);
+            if (!hR) {
+                WinHttpCloseHandle(hC);
+                return false;
+            }
+        }
+        WinHttpSetTimeouts(hR, HTTP_DEADLINE_MS, HTTP_CONNECT_TIMEOUT_MS, HTTP_DEADLINE_MS, STREAM_IDLE_MS);
+
+        bool opened = false;
+        static const wchar_t hdr[] = L"Accept: text/event-stream\r\n";
+        if (WinHttpSendRequest(hR, hdr, (DWORD)(sizeof(hdr) / sizeof(hdr[0]) - 1),
+                WINHTTP_NO_REQUEST_DATA, 0, 0, 0) &&
+            WinHttpReceiveResponse(hR, nullptr)) {
+            DWORD code = 0, len = sizeof(code);
+            WinHttpQueryHeaders(hR, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                WINHTTP_HEADER_NAME_BY_INDEX, &code, &len, WINHTTP_NO_HEADER_INDEX);
+            opened = code == 200;
+
+            // WinHttpReadData blocks until the relay sends something
+            char chunk[HTTP_CHUNK];
+            DWORD read = 0;
+            while (opened && WinHttpReadData(hR, chunk, (DWORD)sizeof(chunk), &read) && read) {
+                if (!sink(chunk, read)) break;
+            }
         }
 
-        if (resp.empty()) return false;
+        WinHttpCloseHandle(hR);
+        WinHttpCloseHandle(hC);
+        return opened;
+    }
 
-        size_t start = resp.find('{');
-        if (start == std::string::npos) return false;
+    void cancel_stream() override {
+        // fails the stream's blocking calls; stream() still closes its handles
+        std::lock_guard<std::mutex> lk(m_);
+        stream_cancelled_ = true;
+        if (stream_session_) WinHttpCloseHandle(stream_session_);
+        stream_session_ = nullptr;
+    }
 
-        size_t end = resp.rfind('}');
-        if (end == std::string::npos || end < start) return false;
+    void cancel_requests() override {
+        // same for every exchange() under the shared session
+        std::lock_guard<std::mutex> lk(m_);
+        requests_cancelled_ = true;
+        close_session_locked();
+    }
 
-        std::string sub = resp.substr(start, end - start + 1);
-        jr = json::parse(sub);
-        return true;
+    void reset() override {
+        std::lock_guard<std::mutex> lk(m_);
+        stream_cancelled_ = false;
+        requests_cancelled_ = false;
+        close_session_locked();
+        if (stream_session_) WinHttpCloseHandle(stream_session_);
+        stream_session_ = nullptr;
     }
-    catch (const std::exception& e) {
-        char buf[256];
-        std::snprintf(buf, sizeof(buf),
-            "[sqcd] JSON parse error: %s", e.what());
-        arc_log(buf);
+
+private:
+    static HINTERNET open_session() {
+        return WinHttpOpen(L"ArcCooldowns/0.81", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
+            WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
     }
-    catch (...) {
-        arc_log("[sqcd] JSON parse error: unknown");
+
+    void close_session_locked() {
+        for (auto& kv : conns_) WinHttpCloseHandle(kv.second);
+        conns_.clear();
+        if (session_) WinHttpCloseHandle(session_);
+        session_ = nullptr;
     }
-    return false;
-}
 
-// -----------------------------------------------------
+    // Opens a request on the pooled connect handle for host:port; null once
+    // requests are cancelled. The caller owns and closes the handle.
+    HINTERNET open_request(const std::string& host, int port, const wchar_t* verb,
+        const std::wstring& path, bool secure, bool& created) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (requests_cancelled_) return nullptr;
+        if (!session_) session_ = open_session();
+        if (!session_) return nullptr;
+        std::string key = host + ':' + std::to_string(port);
+        auto it = conns_.find(key);
+        if (it == conns_.end()) {
+            HINTERNET hC = WinHttpConnect(session_, std::wstring(host.begin(), host.end()).c_str(),
+                (INTERNET_PORT)port, 0);
+            if (!hC) return nullptr;
+            connects.fetch_add(1, std::memory_order_relaxed);
+            it = conns_.emplace(std::move(key), hC).first;
+            created = true;
+        }
+        return WinHttpOpenRequest(it->second, verb, path.c_str(), nullptr,
+            WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+            secure ? WINHTTP_FLAG_SECURE : 0);
+    }
 
-static std::unordered_map<uint32_t, float> g_api_cd_cache;
-static std::unordered_set<uint32_t> g_api_cd_tried;
+    bool exchange(const std::string& host, int port, const char* method, bool secure,
+        const std::wstring& path, const std::string* body, const char* headers,
+        int timeout_ms, HttpResponse& out, bool& created, bool& dead_conn) {
+        out.status = 0;
+        out.content_type.clear();
+        out.content_encoding.clear();
+        out.body.clear();
+        out.retry_after_s = -1;
+
+        std::wstring verb(method, method + std::strlen(method));
+        HINTERNET hR = open_request(host, port, verb.c_str(), path, secure, created);
+        if (!hR) return false;
+        // resolve, connect, send, receive: each phase is bounded on its own
+        WinHttpSetTimeouts(hR, timeout_ms, std::min(timeout_ms, HTTP_CONNECT_TIMEOUT_MS),
+            timeout_ms, timeout_ms);
+
+        bool ok = false;
+        std::wstring hdr;
+        if (headers) hdr.assign(headers, headers + std::strlen(headers));
+        const wchar_t* hdr_ptr = hdr.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : hdr.c_str();
+        BOOL sent;
+        if (body) {
+            sent = WinHttpSendRequest(hR, hdr_ptr, (DWORD)hdr.size(),
+                (LPVOID)body->data(), (DWORD)body->size(), (DWORD)body->size(), 0);
+        }
+        else {
+            sent = WinHttpSendRequest(hR, hdr_ptr, (DWORD)hdr.size(),
+                WINHTTP_NO_REQUEST_DATA, 0, 0, 0);
+        }
 
-static float parse_recharge_from_skill_json(const json& j) {
-    if (j.contains("facts") && j["facts"].is_array()) {
-        for (auto& f : j["facts"]) {
-            if (f.is_object()) {
-                std::string ty = f.value("type", std::string(""));
-                if (ty == "Recharge") {
-                    if (f.contains("value")) {
-                        try { return (float)f["value"].get<double>(); }
-                        catch (...) {}
-                    }
-                }
+        if (sent && WinHttpReceiveResponse(hR, nullptr)) {
+            DWORD code = 0, len = sizeof(code);
+            if (WinHttpQueryHeaders(hR, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                WINHTTP_HEADER_NAME_BY_INDEX, &code, &len, WINHTTP_NO_HEADER_INDEX))
+                out.status = (int)code;
+
+            wchar_t ctype[128];
+            len = sizeof(ctype);
+            if (WinHttpQueryHeaders(hR, WINHTTP_QUERY_CONTENT_TYPE, WINHTTP_HEADER_NAME_BY_INDEX,
+                ctype, &len, WINHTTP_NO_HEADER_INDEX)) {
+                for (DWORD i = 0; i < len / sizeof(wchar_t); ++i) out.content_type += (char)ctype[i];
+            }
+            len = sizeof(ctype);
+            if (WinHttpQueryHeaders(hR, WINHTTP_QUERY_CONTENT_ENCODING, WINHTTP_HEADER_NAME_BY_INDEX,
+                ctype, &len, WINHTTP_NO_HEADER_INDEX)) {
+                for (DWORD i = 0; i < len / sizeof(wchar_t); ++i) out.content_encoding += (char)ctype[i];
+            }
+            len = sizeof(ctype);
+            if (WinHttpQueryHeaders(hR, WINHTTP_QUERY_RETRY_AFTER, WINHTTP_HEADER_NAME_BY_INDEX,
+                ctype, &len, WINHTTP_NO_HEADER_INDEX)) {
+                std::string v;
+                for (DWORD i = 0; i < len / sizeof(wchar_t); ++i) v += (char)ctype[i];
+                out.retry_after_s = parse_retry_after(v);
+            }
+
+            char chunk[HTTP_CHUNK];
+            for (;;) {
+                DWORD avail = 0;
+                if (!WinHttpQueryDataAvailable(hR, &avail) || !avail) break;
+                DWORD read = 0;
+                if (!WinHttpReadData(hR, chunk, std::min<DWORD>(avail, (DWORD)sizeof(chunk)), &read) || !read)
+                    break;
+                out.body.append(chunk, read);
+            }
+            ok = true;
+        }
+        else {
+            // the connection broke before a reply; a timeout is not this
+            const DWORD err = GetLastError();
+            dead_conn = err == ERROR_WINHTTP_CONNECTION_ERROR || err == ERROR_WINHTTP_CANNOT_CONNECT;
+        }
+
+        WinHttpCloseHandle(hR);
+        return ok && !requests_cancelled_;
+    }
+
+    std::mutex m_;
+    HINTERNET session_ = nullptr;
+    HINTERNET stream_session_ = nullptr;   // the stream's own, so cancel_stream() spares requests
+    bool stream_cancelled_ = false;
+    std::atomic<bool> requests_cancelled_{ false };
+    std::unordered_map<std::string, HINTERNET> conns_;
+};
+#endif   // _WIN32
+
+// ---- plain sockets ----
+
+#ifdef _WIN32
+using sock_t = SOCKET;
+static constexpr sock_t BAD_SOCK = INVALID_SOCKET;
+static constexpr int SEND_FLAGS = 0;
+static constexpr int SOCK_SHUT_BOTH = SD_BOTH;
+static void sock_close(sock_t s) { closesocket(s); }
+static bool sock_timed_out() { return WSAGetLastError() == WSAETIMEDOUT; }
+#else
+using sock_t = int;
+static constexpr sock_t BAD_SOCK = -1;
+static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+static constexpr int SOCK_SHUT_BOTH = SHUT_RDWR;
+static void sock_close(sock_t s) { ::close(s); }
+static bool sock_timed_out() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+#endif
+
+static void sock_set_timeouts(sock_t s, int ms) {
+#ifdef _WIN32
+    DWORD tv = (DWORD)ms;
+#else
+    timeval tv{ ms / 1000, (ms % 1000) * 1000 };
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof(tv));
+}
+
+static void sock_set_blocking(sock_t s, bool blocking) {
+#ifdef _WIN32
+    u_long nb = blocking ? 0 : 1;
+    ioctlsocket(s, FIONBIO, &nb);
+#else
+    const int fl = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, blocking ? (fl & ~O_NONBLOCK) : (fl | O_NONBLOCK));
+#endif
+}
+
+// connect() that gives up after `timeout_ms`, or within 50 ms of `cancelled`
+// being set, instead of waiting out the system's SYN retries.
+static bool sock_connect(sock_t s, const sockaddr* addr, int addrlen, int timeout_ms,
+    const std::atomic<bool>& cancelled) {
+    sock_set_blocking(s, false);
+    bool ok = ::connect(s, addr, addrlen) == 0;
+#ifdef _WIN32
+    const bool pending = !ok && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    const bool pending = !ok && errno == EINPROGRESS;
+#endif
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (pending && !cancelled.load(std::memory_order_relaxed)) {
+        const auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) break;
+        timeval tv{ 0, (long)std::min<long long>(left, 50000) };
+        fd_set wr, ex;
+        FD_ZERO(&wr);
+        FD_ZERO(&ex);
+        FD_SET(s, &wr);
+        FD_SET(s, &ex);
+        const int n = ::select((int)s + 1, nullptr, &wr, &ex, &tv);
+        if (n < 0) break;
+        if (n == 0) continue;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+        ok = err == 0;
+        break;
+    }
+    sock_set_blocking(s, true);
+    return ok;
+}
+
+// Minimal HTTP/1.1 client over BSD sockets / Winsock: plain http only, keep-alive
+// connections pooled per host:port, Content-Length and chunked bodies. It
+// exists so the network path can be measured against a local relay.js without
+// WinHTTP; https requests always go through WinHTTP and are refused here.
+class SocketTransport final : public HttpTransport {
+public:
+    const char* name() const override { return "socket"; }
+
+    bool request(const char* method, const std::string& host, int port,
+        bool secure, const std::wstring& path, const std::string* body,
+        const char* headers, int timeout_ms, HttpResponse& out) override {
+        requests.fetch_add(1, std::memory_order_relaxed);
+        out.new_connection = false;
+        if (secure) {   // no TLS here
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        thread_local std::string req;
+        req.clear();
+        req += method;
+        req += ' ';
+        for (wchar_t c : path) req += (char)c;
+        req += " HTTP/1.1\r\nHost: ";
+        req += host;
+        req += "\r\nConnection: keep-alive\r\n";
+        if (headers) req += headers;
+        if (body) {
+            req += "Content-Length: ";
+            req += std::to_string(body->size());
+            req += "\r\n";
+        }
+        req += "\r\n";
+        if (body) req += *body;
+
+        const std::string key = host + ':' + std::to_string(port);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (int attempt = 0; attempt < 2 && !requests_cancelled_; ++attempt) {
+            // the retry only gets what is left of the deadline
+            const int left_ms = attempt == 0 ? timeout_ms : (int)std::chrono::duration_cast<
+                std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left_ms <= 0) break;
+            Conn c;
+            bool pooled = attempt == 0 && take_idle(key, c);
+            if (!pooled && !open(host, port, c, requests_cancelled_)) break;
+            if (attempt > 0) retries.fetch_add(1, std::memory_order_relaxed);
+            if (c.timeout_ms != left_ms) {
+                sock_set_timeouts(c.fd, left_ms);
+                c.timeout_ms = left_ms;
+            }
+            c.deadline = deadline;
+            if (!track(c.fd)) {
+                sock_close(c.fd);
+                break;
+            }
+
+            bool keep = false;
+            c.timed_out = c.answered = false;
+            const bool done = exchange(c, req, out, keep);
+            untrack(c.fd);
+            if (done) {
+                out.new_connection = !pooled;
+                if (keep) give_idle(key, std::move(c));
+                else sock_close(c.fd);
+                return true;
+            }
+            sock_close(c.fd);
+            // only a pooled connection that was already dead gets a second
+            // try: closed or reset before any reply, and only for a request
+            // that is safe to send twice. A fresh connection that fails or a
+            // timeout means the relay is really unreachable or slow.
+            if (!pooled || c.timed_out || c.answered || !http_idempotent(method)) break;
+        }
+        failures.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool stream(const std::string& host, int port, bool secure,
+        const std::wstring& path, const StreamSink& sink) override {
+        if (secure) return false;
+        Conn c;
+        if (!open(host, port, c, stream_cancelled_)) return false;
+        sock_set_timeouts(c.fd, STREAM_IDLE_MS);
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stream_cancelled_) {
+                sock_close(c.fd);
+                return false;
+            }
+            stream_fd_ = c.fd;
+        }
+
+        std::string req = "GET ";
+        for (wchar_t ch : path) req += (char)ch;
+        req += " HTTP/1.1\r\nHost: " + host + "\r\nAccept: text/event-stream\r\n\r\n";
+
+        Head h;
+        bool opened = send_all(c, req) && read_head(c, h) && h.status == 200;
+        if (opened) read_body(c, h, sink);
+
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stream_fd_ = BAD_SOCK;
+        }
+        sock_close(c.fd);
+        return opened;
+    }
+
+    void cancel_stream() override {
+        // unblocks the recv() in stream(); the fd is closed there
+        std::lock_guard<std::mutex> lk(m_);
+        stream_cancelled_ = true;
+        if (stream_fd_ != BAD_SOCK) ::shutdown(stream_fd_, SOCK_SHUT_BOTH);
+    }
+
+    void cancel_requests() override {
+        // as above: the blocked send/recv fails and request() closes the fd
+        std::lock_guard<std::mutex> lk(m_);
+        requests_cancelled_ = true;
+        for (sock_t fd : busy_) ::shutdown(fd, SOCK_SHUT_BOTH);
+    }
+
+    void reset() override {
+        std::lock_guard<std::mutex> lk(m_);
+        stream_cancelled_ = false;
+        requests_cancelled_ = false;
+        for (auto& kv : idle_)
+            for (auto& c : kv.second) sock_close(c.fd);
+        idle_.clear();
+#ifdef _WIN32
+        if (wsa_started_) WSACleanup();
+        wsa_started_ = false;
+#endif
+    }
+
+private:
+    struct Conn {
+        sock_t fd = BAD_SOCK;
+        std::string in;   // bytes received past the current position; capacity is kept
+        int timeout_ms = 0;   // SO_RCVTIMEO/SO_SNDTIMEO currently set
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        bool timed_out = false;   // this exchange ran out of time
+        bool answered = false;    // the peer sent something back
+    };
+
+    // Registers a socket an exchange is about to block on, so cancel_requests()
+    // can reach it; false once requests are cancelled.
+    bool track(sock_t fd) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (requests_cancelled_) return false;
+        busy_.push_back(fd);
+        return true;
+    }
+
+    void untrack(sock_t fd) {
+        std::lock_guard<std::mutex> lk(m_);
+        busy_.erase(std::find(busy_.begin(), busy_.end(), fd));
+    }
+
+    bool take_idle(const std::string& key, Conn& c) {
+        std::lock_guard<std::mutex> lk(m_);
+        auto it = idle_.find(key);
+        if (it == idle_.end() || it->second.empty()) return false;
+        c = std::move(it->second.back());
+        it->second.pop_back();
+        return true;
+    }
+
+    void give_idle(const std::string& key, Conn&& c) {
+        std::lock_guard<std::mutex> lk(m_);
+        idle_[key].push_back(std::move(c));
+    }
+
+    // getaddrinfo() can't be bounded or cancelled; relays are usually given
+    // as an address or resolve from the local cache.
+    bool open(const std::string& host, int port, Conn& c, const std::atomic<bool>& cancelled) {
+#ifdef _WIN32
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (!wsa_started_) {
+                WSADATA wsa;
+                if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+                wsa_started_ = true;
+            }
+        }
+#endif
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0)
+            return false;
+
+        sock_t s = BAD_SOCK;
+        for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+            s = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (s == BAD_SOCK) continue;
+            if (sock_connect(s, ai->ai_addr, (int)ai->ai_addrlen, HTTP_CONNECT_TIMEOUT_MS, cancelled))
+                break;
+            sock_close(s);
+            s = BAD_SOCK;
+        }
+        freeaddrinfo(res);
+        if (s == BAD_SOCK) return false;
+
+        int one = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+        c.fd = s;
+        c.in.clear();
+        connects.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    static bool fill(Conn& c) {
+        if (std::chrono::steady_clock::now() >= c.deadline) {
+            c.timed_out = true;
+            return false;
+        }
+        char chunk[HTTP_CHUNK];
+        int n = (int)::recv(c.fd, chunk, (int)sizeof(chunk), 0);
+        if (n < 0 && sock_timed_out()) c.timed_out = true;
+        if (n <= 0) return false;
+        c.answered = true;
+        c.in.append(chunk, (size_t)n);
+        return true;
+    }
+
+    // Reads until `c.in` holds a CRLF at or after `from`; returns its offset.
+    static bool read_line(Conn& c, size_t from, size_t& eol) {
+        for (;;) {
+            eol = c.in.find("\r\n", from);
+            if (eol != std::string::npos) return true;
+            if (!fill(c)) return false;
+        }
+    }
+
+    static bool header_is(std::string_view line, std::string_view name, std::string_view& value) {
+        if (line.size() <= name.size() || line[name.size()] != ':') return false;
+        for (size_t i = 0; i < name.size(); ++i)
+            if (std::tolower((unsigned char)line[i]) != name[i]) return false;
+        value = line.substr(name.size() + 1);
+        while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+        return true;
+    }
+
+    static bool contains_token(std::string_view v, std::string_view tok) {
+        std::string low(v);
+        for (auto& ch : low) ch = (char)std::tolower((unsigned char)ch);
+        return low.find(tok) != std::string::npos;
+    }
+
+    static bool send_all(Conn& c, const std::string& req) {
+        for (size_t off = 0; off < req.size();) {
+            int n = (int)::send(c.fd, req.data() + off, (int)(req.size() - off), SEND_FLAGS);
+            if (n < 0 && sock_timed_out()) c.timed_out = true;
+            if (n <= 0) return false;
+            off += (size_t)n;
+        }
+        return true;
+    }
+
+    struct Head {
+        int status = 0;
+        std::string content_type;
+        std::string content_encoding;
+        int retry_after_s = -1;
+        bool keep = false;
+        bool chunked = false;
+        long long content_len = -1;
+    };
+
+    // Reads the status line and headers and consumes them from `c.in`.
+    static bool read_head(Conn& c, Head& h) {
+        size_t hdr_end;
+        for (;;) {
+            hdr_end = c.in.find("\r\n\r\n");
+            if (hdr_end != std::string::npos) break;
+            if (!fill(c)) return false;
+        }
+        std::string_view head(c.in.data(), hdr_end);
+        size_t sp = head.find(' ');
+        if (head.compare(0, 5, "HTTP/") != 0 || sp == std::string_view::npos) return false;
+        h.status = std::atoi(c.in.c_str() + sp + 1);
+
+        h.keep = head.compare(0, 8, "HTTP/1.0") != 0;
+        for (size_t p = head.find("\r\n"); p != std::string_view::npos && p < head.size();) {
+            size_t q = head.find("\r\n", p + 2);
+            std::string_view line = head.substr(p + 2, (q == std::string_view::npos ? head.size() : q) - p - 2);
+            std::string_view v;
+            if (header_is(line, "content-length", v)) h.content_len = std::atoll(std::string(v).c_str());
+            else if (header_is(line, "transfer-encoding", v)) h.chunked = contains_token(v, "chunked");
+            else if (header_is(line, "content-type", v)) h.content_type.assign(v);
+            else if (header_is(line, "content-encoding", v)) h.content_encoding.assign(v);
+            else if (header_is(line, "retry-after", v)) h.retry_after_s = parse_retry_after(v);
+            else if (header_is(line, "connection", v)) {
+                if (contains_token(v, "close")) h.keep = false;
+                else if (contains_token(v, "keep-alive")) h.keep = true;
+            }
+            p = q;
+        }
+        c.in.erase(0, hdr_end + 4);
+        return true;
+    }
+
+    // Delivers the body to `sink` piece by piece as it is decoded.
+    static bool read_body(Conn& c, Head& h, const StreamSink& sink) {
+        if (h.status == 204 || h.status == 304 || (h.status >= 100 && h.status < 200))
+            return true;
+
+        if (h.chunked) {
+            for (;;) {
+                size_t eol;
+                if (!read_line(c, 0, eol)) return false;
+                size_t n = (size_t)std::strtoull(c.in.c_str(), nullptr, 16);
+                c.in.erase(0, eol + 2);
+                if (n == 0) {
+                    // optional trailers, then the blank line
+                    for (;;) {
+                        if (!read_line(c, 0, eol)) return false;
+                        c.in.erase(0, eol + 2);
+                        if (eol == 0) return true;
+                    }
+                }
+                while (n > 0) {
+                    if (c.in.empty() && !fill(c)) return false;
+                    size_t take = std::min(n, c.in.size());
+                    if (!sink(c.in.data(), take)) return false;
+                    c.in.erase(0, take);
+                    n -= take;
+                }
+                while (c.in.size() < 2)
+                    if (!fill(c)) return false;
+                c.in.erase(0, 2);
+            }
+        }
+
+        if (h.content_len >= 0) {
+            while (c.in.size() < (size_t)h.content_len)
+                if (!fill(c)) return false;
+            if (!sink(c.in.data(), (size_t)h.content_len)) return false;
+            c.in.erase(0, (size_t)h.content_len);
+            return true;
+        }
+
+        // no framing: the body runs to connection close
+        h.keep = false;
+        do {
+            if (!c.in.empty() && !sink(c.in.data(), c.in.size())) return false;
+            c.in.clear();
+        } while (fill(c));
+        return true;
+    }
+
+    static bool exchange(Conn& c, const std::string& req, HttpResponse& out, bool& keep) {
+        out.status = 0;
+        out.content_type.clear();
+        out.content_encoding.clear();
+        out.body.clear();
+        out.retry_after_s = -1;
+
+        Head h;
+        if (!send_all(c, req) || !read_head(c, h)) return false;
+        out.status = h.status;
+        out.content_type = std::move(h.content_type);
+        out.content_encoding = std::move(h.content_encoding);
+        out.retry_after_s = h.retry_after_s;
+        bool ok = read_body(c, h, [&](const char* d, size_t n) {
+            out.body.append(d, n);
+            return true;
+            });
+        keep = h.keep;
+        return ok;
+    }
+
+    std::mutex m_;
+    std::unordered_map<std::string, std::vector<Conn>> idle_;
+    std::vector<sock_t> busy_;   // sockets of exchanges in progress
+    sock_t stream_fd_ = BAD_SOCK;
+    std::atomic<bool> stream_cancelled_{ false };
+    std::atomic<bool> requests_cancelled_{ false };
+#ifdef _WIN32
+    bool wsa_started_ = false;
+#endif
+};
+
+static SocketTransport g_socket_transport;
+#ifdef _WIN32
+static WinHttpTransport g_winhttp_transport;
+static HttpTransport* const g_transports[] = { &g_winhttp_transport, &g_socket_transport };
+
+static HttpTransport& transport_for(bool secure) {
+    if (!secure && g_use_socket_transport.load(std::memory_order_relaxed))
+        return g_socket_transport;
+    return g_winhttp_transport;
+}
+#else
+static HttpTransport* const g_transports[] = { &g_socket_transport };
+
+static HttpTransport& transport_for(bool) {
+    return g_socket_transport;   // refuses https
+}
+#endif
+
+// ---- compression ----
+//
+// With g_http_compress on, every request offers "Accept-Encoding: gzip" and
+// POST bodies of at least HTTP_GZIP_MIN_BYTES go out gzipped; smaller ones
+// aren't worth the header and the CPU. The relay's body parser inflates
+// gzip bodies, and it only compresses replies for clients that asked.
+
+static constexpr size_t HTTP_GZIP_MIN_BYTES = 1024;
+
+static std::atomic<uint64_t> g_gzip_sent_raw{ 0 };   // POST bodies before/after gzip
+static std::atomic<uint64_t> g_gzip_sent_wire{ 0 };
+static std::atomic<uint64_t> g_gzip_recv_wire{ 0 };  // gzipped replies as received/inflated
+static std::atomic<uint64_t> g_gzip_recv_raw{ 0 };
+static std::atomic<uint64_t> g_gzip_errors{ 0 };
+
+// Inflates a gzip reply in place; a reply we can't decode is a failed request.
+static bool decode_content(HttpResponse& out) {
+    if (out.content_encoding.empty() || out.content_encoding == "identity") return true;
+
+    thread_local std::string t_inflated;  // swapped with the body, so both buffers get reused
+    if (out.content_encoding != "gzip" ||
+        !gzip_decompress((const uint8_t*)out.body.data(), out.body.size(), t_inflated)) {
+        g_gzip_errors.fetch_add(1, std::memory_order_relaxed);
+        arc_log("[sqcd] could not decode compressed reply");
+        out.status = 0;
+        out.body.clear();
+        return false;
+    }
+    g_gzip_recv_wire.fetch_add(out.body.size(), std::memory_order_relaxed);
+    g_gzip_recv_raw.fetch_add(t_inflated.size(), std::memory_order_relaxed);
+    out.body.swap(t_inflated);
+    out.content_encoding.clear();
+    return true;
+}
+
+// ---- request stats ----
+//
+// Per-endpoint counters behind the "Network" rows of the options window and
+// the export file. http_post/http_get classify every request by path and
+// record its latency, bytes and outcome; the callers time their parsing and
+// their g_mutex sections with NetScope. Everything is a relaxed atomic add, so
+// recording never blocks or reorders the thread being measured.
+
+enum NetEndpoint : int { EP_UPDATE, EP_AGGREGATE, EP_SKILLS, EP_TIME, EP_OTHER, EP_COUNT };
+static const char* const NET_ENDPOINT_NAMES[EP_COUNT] = {
+    "/update", "/aggregate", "/v2/skills", "/time", "other"
+};
+
+// upper bounds (ms) of the latency buckets; the last bucket is open-ended
+static constexpr double NET_HIST_BOUNDS_MS[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 };
+static constexpr int NET_HIST_BUCKETS = (int)(sizeof(NET_HIST_BOUNDS_MS) / sizeof(NET_HIST_BOUNDS_MS[0])) + 1;
+
+struct EndpointStats {
+    std::atomic<uint64_t> ok{ 0 };         // 2xx/3xx
+    std::atomic<uint64_t> rejected{ 0 };   // 4xx
+    std::atomic<uint64_t> failed{ 0 };     // no response, 5xx or undecodable
+    std::atomic<uint64_t> bytes_out{ 0 };  // request bodies as sent
+    std::atomic<uint64_t> bytes_in{ 0 };   // response bodies as received
+    std::atomic<uint64_t> latency_us{ 0 };
+    std::atomic<uint64_t> latency_max_us{ 0 };
+    std::atomic<uint64_t> hist[NET_HIST_BUCKETS]{};
+    // requests that had to open a connection (TCP, plus TLS for https)
+    std::atomic<uint64_t> fresh{ 0 };
+    std::atomic<uint64_t> fresh_us{ 0 };
+    std::atomic<uint64_t> parses{ 0 };
+    std::atomic<uint64_t> parse_us{ 0 };
+    std::atomic<uint64_t> locks{ 0 };      // g_mutex sections applying this endpoint's data
+    std::atomic<uint64_t> lock_us{ 0 };
+    std::atomic<int> last_fail_status{ 0 };
+    std::atomic<double> last_fail_s{ 0.0 };  // now_s() of the last failure
+};
+
+static EndpointStats g_net_stats[EP_COUNT];
+static std::atomic<double> g_net_stats_since_s{ 0.0 };
+
+static NetEndpoint classify_endpoint(const std::wstring& path) {
+    auto starts = [&](const wchar_t* p) { return path.compare(0, std::wcslen(p), p) == 0; };
+    if (starts(L"/update")) return EP_UPDATE;
+    if (starts(L"/aggregate")) return EP_AGGREGATE;
+    if (starts(L"/v2/skills")) return EP_SKILLS;
+    if (starts(L"/time")) return EP_TIME;
+    return EP_OTHER;
+}
+
+static void atomic_max(std::atomic<uint64_t>& a, uint64_t v) {
+    uint64_t cur = a.load(std::memory_order_relaxed);
+    while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+static void net_record(NetEndpoint ep, std::chrono::steady_clock::time_point t0,
+    bool ok, const HttpResponse& out, size_t bytes_out, size_t bytes_in) {
+    const uint64_t us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    EndpointStats& s = g_net_stats[ep];
+
+    if (!ok || out.status == 0 || out.status >= 500) {
+        s.failed.fetch_add(1, std::memory_order_relaxed);
+        s.last_fail_status.store(ok ? out.status : 0, std::memory_order_relaxed);
+        s.last_fail_s.store(now_s(), std::memory_order_relaxed);
+    }
+    else if (out.status >= 400) {
+        s.rejected.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        s.ok.fetch_add(1, std::memory_order_relaxed);
+    }
+    s.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+    s.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+    s.latency_us.fetch_add(us, std::memory_order_relaxed);
+    atomic_max(s.latency_max_us, us);
+
+    int b = 0;
+    while (b < NET_HIST_BUCKETS - 1 && us > NET_HIST_BOUNDS_MS[b] * 1000.0) ++b;
+    s.hist[b].fetch_add(1, std::memory_order_relaxed);
+
+    if (out.new_connection) {
+        s.fresh.fetch_add(1, std::memory_order_relaxed);
+        s.fresh_us.fetch_add(us, std::memory_order_relaxed);
+    }
+}
+
+enum NetPhase { NP_PARSE, NP_LOCK };
+
+// Times its own lifetime into an endpoint's parse or lock counters; a null
+// `stats` times nothing. For a g_mutex section declare it right after the
+// lock, so it stops just before the unlock.
+struct NetScope {
+    EndpointStats* stats;
+    NetPhase phase;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    NetScope(EndpointStats* s, NetPhase p) : stats(s), phase(p) {}
+    ~NetScope() {
+        if (!stats) return;
+        const uint64_t us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+        (phase == NP_PARSE ? stats->parses : stats->locks).fetch_add(1, std::memory_order_relaxed);
+        (phase == NP_PARSE ? stats->parse_us : stats->lock_us).fetch_add(us, std::memory_order_relaxed);
+    }
+};
+
+static void reset_net_stats() {
+    for (auto& s : g_net_stats) {
+        for (auto* a : { &s.ok, &s.rejected, &s.failed, &s.bytes_out, &s.bytes_in,
+                &s.latency_us, &s.latency_max_us, &s.fresh, &s.fresh_us,
+                &s.parses, &s.parse_us, &s.locks, &s.lock_us })
+            a->store(0, std::memory_order_relaxed);
+        for (auto& h : s.hist) h.store(0, std::memory_order_relaxed);
+        s.last_fail_status.store(0, std::memory_order_relaxed);
+        s.last_fail_s.store(0.0, std::memory_order_relaxed);
+    }
+    g_net_stats_since_s.store(now_s(), std::memory_order_relaxed);
+}
+
+// Latency (ms) under which fraction q of the requests finished, read off the
+// buckets: the bucket's upper bound, or the max for the open-ended one.
+static double net_percentile_ms(const EndpointStats& s, double q) {
+    uint64_t h[NET_HIST_BUCKETS], total = 0;
+    for (int i = 0; i < NET_HIST_BUCKETS; ++i) total += h[i] = s.hist[i].load(std::memory_order_relaxed);
+    if (!total) return 0.0;
+    const uint64_t want = (uint64_t)std::ceil(q * (double)total);
+    uint64_t seen = 0;
+    for (int i = 0; i < NET_HIST_BUCKETS - 1; ++i) {
+        seen += h[i];
+        if (seen >= want) return NET_HIST_BOUNDS_MS[i];
+    }
+    return s.latency_max_us.load(std::memory_order_relaxed) / 1000.0;
+}
+
+static json net_stats_json() {
+    json j;
+    j["exported"] = (int64_t)std::time(nullptr);
+    j["seconds"] = std::lround(now_s() - g_net_stats_since_s.load(std::memory_order_relaxed));
+    json eps = json::object();
+    for (int i = 0; i < EP_COUNT; ++i) {
+        const EndpointStats& s = g_net_stats[i];
+        const uint64_t ok = s.ok.load(std::memory_order_relaxed);
+        const uint64_t rejected = s.rejected.load(std::memory_order_relaxed);
+        const uint64_t failed = s.failed.load(std::memory_order_relaxed);
+        const uint64_t n = ok + rejected + failed;
+        if (!n) continue;
+        auto avg = [](uint64_t sum, uint64_t count) { return count ? (double)sum / (double)count : 0.0; };
+
+        json e;
+        e["ok"] = ok;
+        e["rejected"] = rejected;
+        e["failed"] = failed;
+        e["bytes_out"] = s.bytes_out.load(std::memory_order_relaxed);
+        e["bytes_in"] = s.bytes_in.load(std::memory_order_relaxed);
+
+        json lat;
+        lat["avg"] = avg(s.latency_us.load(std::memory_order_relaxed), n) / 1000.0;
+        lat["max"] = s.latency_max_us.load(std::memory_order_relaxed) / 1000.0;
+        lat["p50"] = net_percentile_ms(s, 0.50);
+        lat["p90"] = net_percentile_ms(s, 0.90);
+        lat["p99"] = net_percentile_ms(s, 0.99);
+        json buckets = json::array();
+        for (int b = 0; b < NET_HIST_BUCKETS; ++b) {
+            json bj;
+            bj["le"] = b < NET_HIST_BUCKETS - 1 ? json(NET_HIST_BOUNDS_MS[b]) : json(nullptr);
+            bj["count"] = s.hist[b].load(std::memory_order_relaxed);
+            buckets.push_back(std::move(bj));
+        }
+        lat["buckets"] = std::move(buckets);
+        e["latency_ms"] = std::move(lat);
+
+        const uint64_t fresh = s.fresh.load(std::memory_order_relaxed);
+        e["new_connections"] = { { "count", fresh },
+            { "avg_ms", avg(s.fresh_us.load(std::memory_order_relaxed), fresh) / 1000.0 } };
+        const uint64_t parses = s.parses.load(std::memory_order_relaxed);
+        e["parse_us"] = { { "count", parses },
+            { "avg", avg(s.parse_us.load(std::memory_order_relaxed), parses) } };
+        const uint64_t locks = s.locks.load(std::memory_order_relaxed);
+        e["lock_us"] = { { "count", locks },
+            { "avg", avg(s.lock_us.load(std::memory_order_relaxed), locks) } };
+        e["last_fail_status"] = s.last_fail_status.load(std::memory_order_relaxed);
+        eps[NET_ENDPOINT_NAMES[i]] = std::move(e);
+    }
+    j["endpoints"] = std::move(eps);
+    return j;
+}
+
+static void export_net_stats() {
+    write_file_utf8(net_stats_path(), net_stats_json().dump(2));
+}
+
+// Both give up after about `deadline_ms` (see HttpTransport::request); the
+// relay's requests keep the default, the skill API gets longer. When they
+// return false `out.status` is 0.
+static bool http_post(const std::string& host, int port, bool secure,
+    const std::wstring& path, const std::string& body, const char* content_type,
+    HttpResponse& out, int deadline_ms = HTTP_DEADLINE_MS) {
+    std::string hdr = "Content-Type: ";
+    hdr += content_type;
+    hdr += "\r\n";
+
+    const std::string* send = &body;
+    thread_local std::string t_deflated;
+    if (g_http_compress.load(std::memory_order_relaxed)) {
+        hdr += "Accept-Encoding: gzip\r\n";
+        if (body.size() >= HTTP_GZIP_MIN_BYTES) {
+            t_deflated.clear();
+            gzip_compress((const uint8_t*)body.data(), body.size(), t_deflated);
+            hdr += "Content-Encoding: gzip\r\n";
+            send = &t_deflated;
+            g_gzip_sent_raw.fetch_add(body.size(), std::memory_order_relaxed);
+            g_gzip_sent_wire.fetch_add(t_deflated.size(), std::memory_order_relaxed);
+        }
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    bool ok = transport_for(secure).request("POST", host, port, secure, path, send,
+        hdr.c_str(), deadline_ms, out);
+    const size_t received = ok ? out.body.size() : 0;
+    ok = ok && decode_content(out);
+    if (!ok) out.status = 0;
+    net_record(classify_endpoint(path), t0, ok, out, send->size(), received);
+    return ok;
+}
+
+static bool http_post_json(const std::string& host, int port, bool secure,
+    const std::wstring& path, const std::string& body, HttpResponse& out) {
+    return http_post(host, port, secure, path, body, "application/json", out);
+}
+
+// `accept`, if set, is sent as the Accept header.
+static bool http_get(const std::string& host, int port, bool secure,
+    const std::wstring& path, HttpResponse& out, const char* accept = nullptr,
+    int deadline_ms = HTTP_DEADLINE_MS) {
+    std::string hdr;
+    if (accept) {
+        hdr = "Accept: ";
+        hdr += accept;
+        hdr += "\r\n";
+    }
+    if (g_http_compress.load(std::memory_order_relaxed))
+        hdr += "Accept-Encoding: gzip\r\n";
+    const auto t0 = std::chrono::steady_clock::now();
+    bool ok = transport_for(secure).request("GET", host, port, secure, path, nullptr,
+        hdr.empty() ? nullptr : hdr.c_str(), deadline_ms, out);
+    const size_t received = ok ? out.body.size() : 0;
+    ok = ok && decode_content(out);
+    if (!ok) out.status = 0;
+    net_record(classify_endpoint(path), t0, ok, out, 0, received);
+    return ok;
+}
+
+// -----------------------------------------------------
+
+static float parse_recharge_from_skill_json(const json& j) {
+    if (j.contains("facts") && j["facts"].is_array()) {
+        for (auto& f : j["facts"]) {
+            if (f.is_object()) {
+                std::string ty = f.value("type", std::string(""));
+                if (ty == "Recharge") {
+                    if (f.contains("value")) {
+                        try { return (float)f["value"].get<double>(); }
+                        catch (...) {}
+                    }
+                }
             }
         }
     }
@@ -717,23 +2346,269 @@ static float parse_recharge_from_skill_json(const json& j) {
     return 0.f;
 }
 
-static float fetch_skill_recharge_api(uint32_t skillid) {
-    std::wstring path = L"/v2/skills?id=" + std::to_wstring(skillid);
-    std::string resp;
-    if (!http_get("api.guildwars2.com", 443, true, path, &resp)) return 0.f;
+// -------------------- skill metadata worker --------------------
+//
+// Recharges the API has to tell us are fetched by a small pool of workers, off
+// net_loop, so relay traffic never waits on api.guildwars2.com. Pending ids
+// are grouped into /v2/skills?ids=a,b,c requests. The endpoint can be pointed
+// at a local stand-in through the skill_api_* settings.
+
+static constexpr size_t SKILL_BATCH_MAX = 50;        // ids per request (API allows 200)
+static constexpr int SKILL_FETCH_WORKERS = 2;        // concurrent requests
+static constexpr int SKILL_API_DEADLINE_MS = 10000;  // per request; the API can be slow
+
+static std::thread g_skill_workers[SKILL_FETCH_WORKERS];
+static std::atomic<uint32_t> g_skill_batches_inflight{ 0 };
+static std::atomic<uint64_t> g_skill_batches{ 0 };
+static std::atomic<uint64_t> g_skill_batch_failures{ 0 };
+static std::atomic<uint32_t> g_skill_latency_last_ms{ 0 };
+static std::atomic<uint32_t> g_skill_latency_max_ms{ 0 };
+static std::atomic<uint64_t> g_skill_latency_sum_ms{ 0 };
+
+// GET /v2/skills?ids=...; `out` gets every skill the API returned (recharge
+// 0 if it has none). Ids missing from `out` are unknown to the API. False if
+// the request or the parse failed.
+static bool fetch_skill_recharges_api(const std::vector<uint32_t>& ids,
+    std::unordered_map<uint32_t, float>& out, HttpResponse& resp) {
+    out.clear();
+    std::wstring path = L"/v2/skills?ids=";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i) path += L',';
+        path += std::to_wstring(ids[i]);
+    }
+
+    if (!http_get(g_skill_api_host, g_skill_api_port, g_skill_api_https, path, resp,
+        nullptr, SKILL_API_DEADLINE_MS))
+        return false;
+    // 404 is how the API answers when none of the ids exist
+    if (resp.status != 200 && resp.status != 206 && resp.status != 404)
+        return false;
+    if (resp.status == 404)
+        return true;
+
     try {
-        json j = json::parse(resp);
-        if (j.is_object()) {
-            return parse_recharge_from_skill_json(j);
-        }
-        else if (j.is_array() && !j.empty()) {
-            return parse_recharge_from_skill_json(j[0]);
+        NetScope parse(&g_net_stats[EP_SKILLS], NP_PARSE);
+        json j = json::parse(resp.body);
+        if (!j.is_array()) return false;
+        for (auto& sj : j) {
+            if (!sj.is_object() || !sj.contains("id") || !sj["id"].is_number_unsigned()) continue;
+            out[sj["id"].get<uint32_t>()] = parse_recharge_from_skill_json(sj);
         }
+        return true;
+    }
+    catch (const std::exception& e) {
+        char buf[256];
+        std::snprintf(buf, sizeof(buf),
+            "[sqcd] /v2/skills JSON error: %s", e.what());
+        arc_log(buf);
+    }
+    return false;
+}
+
+// ---- skill recharge cache ----
+//
+// Everything fetched into g_skill_table is written to
+// arcdps_cooldowns_skills.json next to the settings, so a launch starts with
+// the recharges (and the ids the API could not resolve) from last time
+// instead of refetching them. Entries are refreshed in the background once
+// they outlive SKILL_CACHE_TTL_S or the API build they were fetched under has
+// changed.
+
+static std::thread g_skill_cache_thread;
+static std::atomic<uint32_t> g_skill_cache_loaded{ 0 };    // entries read at startup
+static std::atomic<uint32_t> g_skill_cache_refreshed{ 0 }; // of those, queued again
+
+static std::wstring skill_cache_path();
+static std::string read_file_utf8(const std::wstring& path);
+static void write_file_utf8(const std::wstring& path, const std::string& s);
+
+// Build a record was fetched under. Fetches that finished before /v2/build
+// answered carry 0; they were made this session, so they get its build.
+static uint32_t skill_record_build(const SkillSlot& sl, int64_t fetched) {
+    const uint32_t b = sl.build.load(std::memory_order_relaxed);
+    if (b || fetched < g_skill_session_wall.load(std::memory_order_relaxed)) return b;
+    return g_skill_api_build.load(std::memory_order_relaxed);
+}
+
+static void save_skill_cache() {
+    static std::mutex s_write_mutex;  // two workers can drain the queue back to back
+    g_skill_records_dirty = false;
+    json j;
+    j["build"] = g_skill_api_build.load(std::memory_order_relaxed);
+    json arr = json::array();
+    for (auto& sl : g_skill_table) {
+        const uint32_t sid = sl.id.load(std::memory_order_acquire);
+        const int64_t fetched = sl.fetched.load(std::memory_order_relaxed);
+        if (sid == 0 || fetched == 0) continue;
+        json e;
+        e["id"] = sid;
+        const float cd = sl.recharge.load(std::memory_order_relaxed);
+        if (cd > 0.f) e["recharge"] = cd;
+        else e["negative"] = true;
+        e["fetched"] = fetched;
+        e["build"] = skill_record_build(sl, fetched);
+        arr.push_back(std::move(e));
+    }
+    j["skills"] = std::move(arr);
+    std::lock_guard<std::mutex> lk(s_write_mutex);
+    write_file_utf8(skill_cache_path(), j.dump());
+}
+
+// GET /v2/build; 0 if unavailable.
+static uint32_t fetch_skill_api_build() {
+    HttpResponse resp;
+    if (!http_get(g_skill_api_host, g_skill_api_port, g_skill_api_https, L"/v2/build", resp,
+        nullptr, SKILL_API_DEADLINE_MS) ||
+        resp.status != 200)
+        return 0;
+    try {
+        json j = json::parse(resp.body);
+        if (j.is_object() && j.contains("id") && j["id"].is_number_unsigned())
+            return j["id"].get<uint32_t>();
     }
     catch (...) {}
-    return 0.f;
+    return 0;
+}
+
+static void skill_cache_preload() {
+    const int64_t wall = (int64_t)std::time(nullptr);
+    const double now = now_s();
+    uint32_t loaded = 0;
+
+    std::string s = read_file_utf8(skill_cache_path());
+    if (!s.empty()) {
+        try {
+            json j = json::parse(s);
+            if (j.contains("skills") && j["skills"].is_array()) {
+                for (auto& e : j["skills"]) {
+                    if (!e.is_object() || !e.contains("id")) continue;
+                    SkillSlot* sl = skill_slot(e["id"].get<uint32_t>(), true);
+                    if (!sl) continue;
+
+                    const bool neg = e.value("negative", false);
+                    const float cd = neg ? 0.f : e.value("recharge", 0.f);
+                    const int64_t fetched = e.value("fetched", (int64_t)0);
+                    if (!neg && cd <= 0.f) continue;
+                    sl->fetched.store(fetched, std::memory_order_relaxed);
+                    sl->build.store(e.value("build", 0u), std::memory_order_relaxed);
+                    sl->negative.store(neg, std::memory_order_relaxed);
+                    sl->recharge.store(cd, std::memory_order_relaxed);
+                    if (neg) {
+                        sl->retry_at.store(now + (double)(fetched + SKILL_NEGATIVE_TTL_S - wall),
+                            std::memory_order_relaxed);
+                    }
+
+                    // the rows may have asked for it already; workers haven't started
+                    uint32_t st = sl->state.load(std::memory_order_acquire);
+                    while (st == SR_UNKNOWN || st == SR_PENDING) {
+                        if (sl->state.compare_exchange_weak(st, neg ? SR_FAILED : SR_RESOLVED,
+                            std::memory_order_acq_rel)) {
+                            if (st == SR_PENDING) g_cd_queue_depth.fetch_sub(1, std::memory_order_relaxed);
+                            break;
+                        }
+                    }
+                    ++loaded;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            char buf[256];
+            std::snprintf(buf, sizeof(buf), "[sqcd] skill cache unreadable: %s", e.what());
+            arc_log(buf);
+        }
+    }
+    g_skill_cache_loaded = loaded;
+    {
+        std::lock_guard<std::mutex> lk(g_cd_mutex);
+        g_cd_preloaded = true;
+    }
+    g_cd_cv.notify_all();
+
+    // anything fetched under another API build, or too long ago, is refetched;
+    // the old value stays readable until the new one lands
+    const uint32_t build = fetch_skill_api_build();
+    if (build) g_skill_api_build = build;
+    uint32_t stale = 0;
+    bool stamped = false;
+    for (auto& sl : g_skill_table) {
+        const int64_t fetched = sl.fetched.load(std::memory_order_relaxed);
+        if (sl.id.load(std::memory_order_acquire) == 0 || fetched == 0) continue;
+        const bool neg = sl.negative.load(std::memory_order_relaxed);
+        const uint32_t rec_build = skill_record_build(sl, fetched);
+        if (rec_build != sl.build.load(std::memory_order_relaxed)) {
+            sl.build.store(rec_build, std::memory_order_relaxed);
+            stamped = true;
+        }
+        const bool old_build = build && rec_build != build;
+        const bool expired = wall - fetched >= (neg ? SKILL_NEGATIVE_TTL_S : SKILL_CACHE_TTL_S);
+        if (!old_build && !expired) continue;
+        if (skill_slot_enqueue(sl, neg ? SR_FAILED : SR_RESOLVED)) ++stale;
+    }
+    g_skill_cache_refreshed = stale;
+    if (stale) g_cd_cv.notify_all();
+    // the workers may have saved those records with build 0 already
+    else if (stamped) save_skill_cache();
+}
+
+static void skill_worker_loop() {
+    std::vector<uint32_t> batch;
+    std::unordered_map<uint32_t, float> found;
+    HttpResponse resp;
+
+    while (wait_cd_batch(batch, SKILL_BATCH_MAX)) {
+        g_skill_batches_inflight.fetch_add(1, std::memory_order_relaxed);
+        const auto t0 = std::chrono::steady_clock::now();
+        const bool ok = fetch_skill_recharges_api(batch, found, resp);
+        const uint32_t ms = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+
+        g_skill_batches.fetch_add(1, std::memory_order_relaxed);
+        g_skill_latency_last_ms.store(ms, std::memory_order_relaxed);
+        g_skill_latency_sum_ms.fetch_add(ms, std::memory_order_relaxed);
+        if (ms > g_skill_latency_max_ms.load(std::memory_order_relaxed))
+            g_skill_latency_max_ms.store(ms, std::memory_order_relaxed);
+
+        if (!ok) g_skill_batch_failures.fetch_add(1, std::memory_order_relaxed);
+        finish_cd_batch(batch, ok ? &found : nullptr);
+
+        // write the cache once the queue has drained
+        const bool last = g_skill_batches_inflight.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        if (last && g_cd_queue_depth.load(std::memory_order_relaxed) == 0 &&
+            g_skill_records_dirty.load(std::memory_order_relaxed))
+            save_skill_cache();
+    }
+}
+
+static void start_skill_workers() {
+    {
+        std::lock_guard<std::mutex> lk(g_cd_mutex);
+        g_cd_workers_stop = false;
+        g_cd_preloaded = false;
+    }
+    g_skill_session_wall = (int64_t)std::time(nullptr);
+    for (auto& t : g_skill_workers) t = std::thread(skill_worker_loop);
+    g_skill_cache_thread = std::thread(skill_cache_preload);
+}
+
+static void stop_skill_workers() {
+    {
+        std::lock_guard<std::mutex> lk(g_cd_mutex);
+        g_cd_workers_stop = true;
+    }
+    g_cd_cv.notify_all();
+    for (auto& t : g_skill_workers) {
+        if (t.joinable()) t.join();
+    }
+    if (g_skill_cache_thread.joinable()) {
+        g_skill_cache_thread.join();
+    }
+
+    if (g_skill_records_dirty) save_skill_cache();
 }
 
+static bool g_combat_sandboxed = false;   // g_mutex: a replay's state is swapped in
+
+// g_mutex held by every caller.
 static float get_base_cd_for_skill(uint32_t sid, float row_base) {
     // 1) hard override wins
     auto itH = g_hard_override_cd.find(sid);
@@ -744,535 +2619,3305 @@ static float get_base_cd_for_skill(uint32_t sid, float row_base) {
     if (row_base > 0.f)
         return row_base;
 
-    // 3) cached from previous API fetch
-    auto it = g_api_cd_cache.find(sid);
-    if (it != g_api_cd_cache.end())
-        return it->second;
+    // 3) resolved by the API (this launch or the on-disk cache); lock-free
+    if (const SkillSlot* s = skill_slot(sid, false)) {
+        const float cd = s->recharge.load(std::memory_order_acquire);
+        if (cd > 0.f)
+            return cd;
+    }
 
-    // 4) not known yet -> ask background thread to fetch it
-    request_cd_fetch(sid);
+    // 4) not known yet -> ask background thread to fetch it (no-op while it is
+    //    queued, in flight or backing off). A replay resolves only from what
+    //    is already known: its skills must not reach the API or the disk cache.
+    if (!g_combat_sandboxed) request_cd_fetch(sid);
 
     // non-blocking: return 0 for "unknown" so caller can show "waiting"
     return 0.f;
 }
 
 
-// INTERNAL: raw computation with optional net_offset
-static float compute_left_for_internal(uint32_t sid, float row_base, double now, float net_offset) {
+// Manual base cooldown of the first row tracking sid (0 if none).
+static float tracked_row_base_locked(uint32_t sid) {
+    for (auto& e : g_tracked) {
+        if (e.skillid == sid) return e.base_cd;
+    }
+    return 0.f;
+}
+
+// INTERNAL: raw remaining time of a tracked skill. `ready` is the wheel's
+// verdict, so the table and pushes flip at the same moment; a timer that is
+// ready costs nothing beyond the lookup.
+static float compute_left_for_internal(uint32_t sid, float row_base, double now, bool& ready) {
     auto it = g_by_skill.find(sid);
-    if (it == g_by_skill.end()) return -1.f;
+    if (it == g_by_skill.end()) {
+        ready = true;
+        return -1.f;
+    }
 
     SlotTimer& st = it->second;
+    ready = st.ready;
+    if (st.ready) return 0.f;
 
-    // --- Cancel path: ignore NET_OFFSET entirely ---
+    // --- Cancel path ---
     if (st.cancel_active) {
         // cancel cooldown is short and purely client-side
-        return st.predict_left_raw(now, false, false);
+        return st.predict_left_raw(now, g_recharge);
     }
 
     // --- Normal cooldown path (needs a valid base_cd) ---
     const float base = get_base_cd_for_skill(sid, row_base);
     if (base <= 0.f) return -1.f;
 
-    st.base_cd = base;
-
-    // NOTE: this function is always called with g_mutex already locked
-    bool has_alac = g_self.has_alacrity;
-    bool has_chill = g_self.has_chill;
-
-    // Expire Alacrity at query time if needed
-    if (has_alac && g_alac_until_s > 0.0 && now >= g_alac_until_s) {
-        has_alac = false;
-        g_self.has_alacrity = false;
-        g_alac_until_s = 0.0;
+    if (st.base_cd != base) {
+        st.base_cd = base;
+        st.done = false;
+        schedule_ready_locked(st, now);
     }
 
-    // Expire Chill at query time if needed
-    if (has_chill && g_chill_until_s > 0.0 && now >= g_chill_until_s) {
-        has_chill = false;
-        g_self.has_chill = false;
-        g_chill_until_s = 0.0;
+    return st.predict_left_raw(now, g_recharge);
+}
+
+// Local UI
+static float compute_left_for_local(uint32_t sid, float row_base, double now, bool& ready) {
+    return compute_left_for_internal(sid, row_base, now, ready);
+}
+
+// Shared/relay: the same raw value. Delay is no longer fudged here; pushes
+// also carry the ready time on the relay clock and viewers count down to it
+// with their own measured offset (see "relay clock").
+static float compute_left_for_shared(uint32_t sid, float row_base, double now, bool& ready) {
+    return compute_left_for_internal(sid, row_base, now, ready);
+}
+
+
+
+// -------------------- skill classification --------------------
+//
+// Skill ids never change class, so each id is classified once (by name) and
+// cached. Unseen names go through a single-pass Aho-Corasick scan over the
+// junk/boon patterns instead of one strstr per pattern.
+
+enum class SkillClass : uint8_t { Unknown = 0, Trackable, Junk, Boon };
+
+static constexpr uint8_t SKILLPAT_JUNK = 1;
+static constexpr uint8_t SKILLPAT_BOON = 2;
+
+// Columns are the characters that occur in some pattern (column 0 is every
+// other character), so the goto table stays small (MAX_NODES x MAX_SYMS).
+struct SkillNameMatcher {
+    static constexpr int MAX_NODES = 256;
+    static constexpr int MAX_SYMS = 48;
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    uint16_t next[MAX_NODES][MAX_SYMS];
+    uint16_t fail[MAX_NODES];
+    uint8_t  out[MAX_NODES];
+    uint8_t  sym[128];
+    int      count = 1;
+    int      syms = 1;
+
+    SkillNameMatcher() {
+        std::fill(&next[0][0], &next[0][0] + MAX_NODES * MAX_SYMS, NONE);
+        std::fill(fail, fail + MAX_NODES, 0);
+        std::fill(out, out + MAX_NODES, 0);
+        std::fill(sym, sym + 128, 0);
+    }
+
+    void add(const char* pat, uint8_t bits) {
+        int u = 0;
+        for (const unsigned char* p = (const unsigned char*)pat; *p; ++p) {
+            const unsigned c = *p & 0x7F;
+            if (!sym[c]) {
+                if (syms >= MAX_SYMS) return;
+                sym[c] = (uint8_t)syms++;
+            }
+            const unsigned k = sym[c];
+            if (next[u][k] == NONE) {
+                if (count >= MAX_NODES) return;
+                next[u][k] = (uint16_t)count++;
+            }
+            u = next[u][k];
+        }
+        out[u] |= bits;
     }
 
-    float remaining = st.predict_left_raw(now, has_alac, has_chill);
-    if (remaining < 0.f) return remaining;
+    // Turn the trie into a full goto table (BFS over failure links).
+    void build() {
+        std::vector<uint16_t> q;
+        q.reserve(count);
+        for (int k = 0; k < syms; ++k) {
+            if (next[0][k] == NONE) {
+                next[0][k] = 0;
+            }
+            else {
+                fail[next[0][k]] = 0;
+                q.push_back(next[0][k]);
+            }
+        }
+        for (size_t qi = 0; qi < q.size(); ++qi) {
+            const uint16_t u = q[qi];
+            out[u] |= out[fail[u]];
+            for (int k = 0; k < syms; ++k) {
+                const uint16_t v = next[u][k];
+                if (v == NONE) {
+                    next[u][k] = next[fail[u]][k];
+                }
+                else {
+                    fail[v] = next[fail[u]][k];
+                    q.push_back(v);
+                }
+            }
+        }
+    }
 
-    if (net_offset <= 0.f) {
-        // local: no fudging
-        return remaining;
+    uint8_t scan(const char* s) const {
+        uint8_t bits = 0;
+        uint16_t st = 0;
+        for (const unsigned char* p = (const unsigned char*)s; *p; ++p) {
+            // patterns are plain ASCII; anything else can't be part of a match
+            st = (*p < 128) ? next[st][sym[*p]] : 0;
+            bits |= out[st];
+        }
+        return bits;
     }
+};
 
-    float left = remaining - net_offset;
-    if (left < 0.f) left = 0.f;
-    return left;
+// Built in place in static storage on first use (never on the caller's stack).
+static const SkillNameMatcher& skill_name_matcher() {
+    struct Built : SkillNameMatcher {
+        Built() {
+            static const char* junk[] = {
+                "Weapon Draw","Weapon Stow","Weapon Swap","Dodge","Mount","Dismount",
+                "Aura","Barrier","Stow Weapon","Draw Weapon",
+                "Leader of The Pact III","Leader of The Pact II","Leader of The Pact I",
+            };
+            static const char* boons[] = {
+                "Swiftness","Superspeed","Regeneration","Resolution","Vigor",
+                "Protection","Might","Fury","Quickness","Alacrity","Stability",
+                "Resistance","Aegis",
+            };
+            for (auto* p : junk) add(p, SKILLPAT_JUNK);
+            for (auto* p : boons) add(p, SKILLPAT_BOON);
+            build();
+        }
+    };
+    static const Built m;
+    return m;
 }
 
-// Local UI: no network fudge
-static float compute_left_for_local(uint32_t sid, float row_base, double now) {
-    return compute_left_for_internal(sid, row_base, now, 0.0f);
+// Bundled seed: ids we already know are never worth tracking.
+static const std::pair<uint32_t, SkillClass> SKILL_CLASS_SEED[] = {
+    { 740,   SkillClass::Boon },   // Might
+    { 725,   SkillClass::Boon },   // Fury
+    { 1187,  SkillClass::Boon },   // Quickness
+    { BUFF_ALACRITY, SkillClass::Boon },
+    { 717,   SkillClass::Boon },   // Protection
+    { 718,   SkillClass::Boon },   // Regeneration
+    { 726,   SkillClass::Boon },   // Vigor
+    { 743,   SkillClass::Boon },   // Aegis
+    { 1122,  SkillClass::Boon },   // Stability
+    { 719,   SkillClass::Boon },   // Swiftness
+    { 26980, SkillClass::Boon },   // Resistance
+    { 873,   SkillClass::Boon },   // Resolution
+    { 5974,  SkillClass::Boon },   // Superspeed
+    { BUFF_CHILL, SkillClass::Boon },
+};
+
+// Written by the combat consumer with g_mutex held.
+static std::unordered_map<uint32_t, SkillClass> g_skill_class = [] {
+    std::unordered_map<uint32_t, SkillClass> m;
+    for (auto& kv : SKILL_CLASS_SEED) m.emplace(kv.first, kv.second);
+    return m;
+    }();
+static std::atomic<uint64_t> g_skill_class_hits{ 0 };
+static std::atomic<uint64_t> g_skill_class_misses{ 0 };
+
+static SkillClass classify_skill_locked(uint32_t sid, const char* nm) {
+    auto it = g_skill_class.find(sid);
+    if (it != g_skill_class.end()) {
+        g_skill_class_hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second;
+    }
+    g_skill_class_misses.fetch_add(1, std::memory_order_relaxed);
+
+    // no name yet: answer as trackable, but don't cache a guess
+    if (!nm || !*nm) return SkillClass::Trackable;
+
+    const uint8_t bits = skill_name_matcher().scan(nm);
+    const SkillClass cls = (bits & SKILLPAT_BOON) ? SkillClass::Boon
+        : (bits & SKILLPAT_JUNK) ? SkillClass::Junk
+        : SkillClass::Trackable;
+    g_skill_class.emplace(sid, cls);
+    return cls;
 }
 
-// Shared/relay: apply NET_OFFSET for early "ready"
-static float compute_left_for_shared(uint32_t sid, float row_base, double now) {
-    return compute_left_for_internal(sid, row_base, now, NET_OFFSET);
+// -------------------- arcdps clock mapping --------------------
+//
+// Maps arcdps ev->time (ms) into the now_s() domain. Each event gives
+// offset = callback_s - ev_s = true_offset + delivery delay (>= 0), so the
+// per-second minimum is the best guess at the true offset. A line fitted
+// through recent minima gives offset + drift; event times are then stamped
+// as ev_s + offset(ev_s), never later than the callback itself.
+
+struct ClockMap {
+    static constexpr int    BUCKETS = 32;
+    static constexpr double BUCKET_S = 1.0;
+    static constexpr double RESET_JUMP_S = 5.0;     // new arcdps session, replay, ...
+    static constexpr double MIN_DRIFT_SPAN_S = 5.0;
+    static constexpr double MAX_DRIFT = 1e-3;        // 1000 ppm; anything more is noise
+
+    struct Bucket {
+        int64_t idx = -1;
+        double  x = 0.0;        // ev time (s) of the minimum
+        double  min_off = 0.0;
+    };
+
+    Bucket   buckets[BUCKETS];
+    int64_t  newest = -1;
+    bool     valid = false;
+    double   x0 = 0.0;          // fit is offset(x) = a + drift * (x - x0)
+    double   a = 0.0;
+    double   drift = 0.0;
+
+    // stats (for display)
+    double   delay_mean = 0.0;
+    double   delay_var = 0.0;
+    uint64_t samples = 0;
+    uint64_t resets = 0;
+
+    double predict(double x) const { return a + drift * (x - x0); }
+
+    void reset() {
+        for (auto& b : buckets) b = Bucket{};
+        newest = -1;
+        valid = false;
+        delay_mean = delay_var = 0.0;
+        ++resets;
+    }
+
+    void refit() {
+        double sx = 0, sy = 0, n = 0;
+        double lo = 0, hi = 0;
+        for (auto& b : buckets) {
+            if (b.idx < 0 || newest - b.idx >= BUCKETS) continue;
+            if (n == 0) lo = hi = b.x;
+            lo = std::min(lo, b.x);
+            hi = std::max(hi, b.x);
+            sx += b.x;
+            sy += b.min_off;
+            n += 1;
+        }
+        if (n == 0) return;
+        x0 = sx / n;
+        a = sy / n;
+        drift = 0.0;
+        if (n >= 2 && hi - lo >= MIN_DRIFT_SPAN_S) {
+            double sxx = 0, sxy = 0;
+            for (auto& b : buckets) {
+                if (b.idx < 0 || newest - b.idx >= BUCKETS) continue;
+                sxx += (b.x - x0) * (b.x - x0);
+                sxy += (b.x - x0) * (b.min_off - a);
+            }
+            if (sxx > 0) drift = sxy / sxx;
+            if (std::fabs(drift) > MAX_DRIFT) drift = 0.0;
+        }
+        // The line runs through the mean of the minima; lower it onto the
+        // lowest one so it stays a lower envelope.
+        double shift = 0.0;
+        for (auto& b : buckets) {
+            if (b.idx < 0 || newest - b.idx >= BUCKETS) continue;
+            shift = std::min(shift, b.min_off - predict(b.x));
+        }
+        a += shift;
+        valid = true;
+    }
+
+    // Stamps never run backwards: an event delivered late (or one whose
+    // delay beat the fitted minimum) is clamped to the previous stamp.
+    double last_t = 0.0;
+
+    double map(uint64_t ev_ms, double cb_s) {
+        if (ev_ms == 0) return last_t = std::max(cb_s, last_t);
+
+        const double x = (double)ev_ms / 1000.0;
+        const double off = cb_s - x;
+
+        if (valid && std::fabs(off - predict(x)) > RESET_JUMP_S) reset();
+
+        const int64_t idx = (int64_t)std::floor(x / BUCKET_S);
+        Bucket& b = buckets[((idx % BUCKETS) + BUCKETS) % BUCKETS];
+        if (b.idx != idx) {
+            b.idx = idx;
+            b.x = x;
+            b.min_off = off;
+            newest = std::max(newest, idx);
+            refit();
+        }
+        else if (off < b.min_off) {
+            b.x = x;
+            b.min_off = off;
+            refit();
+        }
+
+        const double est = predict(x);
+        const double delay = off - est;
+        ++samples;
+        const double k = samples < 64 ? 1.0 / (double)samples : 1.0 / 64.0;
+        const double d = delay - delay_mean;
+        delay_mean += k * d;
+        delay_var = (1.0 - k) * (delay_var + k * d * d);
+
+        const double t = x + est;
+        return last_t = std::max(t < cb_s ? t : cb_s, last_t);
+    }
+};
+
+static ClockMap g_clock_map;   // g_mutex
+
+// Everything apply_combat_event_locked changes apart from the tracked rows and
+// the skill-class cache. A replay applies into its own CombatState, swapped
+// in for the length of a drain (g_mutex held throughout), so it never touches
+// the live timers, roster or clock and nothing synthetic is pushed.
+struct CombatState {
+    std::unordered_map<uint32_t, SlotTimer> by_skill;
+    TimerWheel ready_wheel;
+    RechargeTimeline recharge;
+    double alac_until_s = 0.0;
+    double chill_until_s = 0.0;
+    SelfContext self;
+    uint32_t self_prof = 0;
+    std::string self_charname;
+    std::string self_accountname;
+    std::unordered_map<uint64_t, RosterMember> roster;
+    bool in_map_change = false;
+    double map_change_s = 0.0;
+    bool map_change_saw_loading = false;
+    bool self_in_combat = false;
+    double last_tracked_cast_s = -1e9;
+    ClockMap clock_map;
+    uint64_t last_ev_ms = 0;
+    int pick_row = -1;
+    double pick_armed_until_s = 0.0;
+    uint64_t pick_not_before_ms = 0;
+};
+
+static void swap_combat_state_locked(CombatState& s) {
+    std::swap(g_by_skill, s.by_skill);
+    std::swap(g_ready_wheel, s.ready_wheel);
+    std::swap(g_recharge, s.recharge);
+    std::swap(g_alac_until_s, s.alac_until_s);
+    std::swap(g_chill_until_s, s.chill_until_s);
+    std::swap(g_self, s.self);
+    std::swap(g_self_prof, s.self_prof);
+    std::swap(g_self_charname, s.self_charname);
+    std::swap(g_self_accountname, s.self_accountname);
+    std::swap(g_roster, s.roster);
+    std::swap(g_in_map_change, s.in_map_change);
+    std::swap(g_map_change_s, s.map_change_s);
+    std::swap(g_map_change_saw_loading, s.map_change_saw_loading);
+    std::swap(g_self_in_combat, s.self_in_combat);
+    std::swap(g_last_tracked_cast_s, s.last_tracked_cast_s);
+    std::swap(g_clock_map, s.clock_map);
+    std::swap(g_last_ev_ms, s.last_ev_ms);
+    std::swap(g_pick_row, s.pick_row);
+    std::swap(g_pick_armed_until_s, s.pick_armed_until_s);
+    std::swap(g_pick_not_before_ms, s.pick_not_before_ms);
+    g_combat_sandboxed = !g_combat_sandboxed;
+    ++g_roster_gen;   // the roster view must not outlive a swap
 }
 
+// -------------------- combat event queue --------------------
+//
+// on_combat only copies what it needs into a fixed-size SPSC ring and returns;
+// arcdps is the single producer. Consumers always drain with g_mutex held, so
+// the consumer side is serialized as well (UI frame + net thread).
 
+static constexpr uint32_t COMBAT_QUEUE_CAP = 2048;      // must be a power of two
+static constexpr size_t COMBAT_NAME_MAX = 64;
 
-static bool is_probable_junk_name(const char* nm) {
-    if (!nm || !*nm) return false;
-    static const char* bads[] = {
-        "Weapon Draw","Weapon Stow","Weapon Swap","Dodge","Mount","Dismount",
-        "Aura","Swiftness","Superspeed","Regeneration","Resolution","Vigor",
-        "Protection","Might","Fury","Quickness","Alacrity","Stability",
-        "Resistance","Aegis","Barrier","Stow Weapon","Draw Weapon",
-        "Leader of The Pact III","Leader of The Pact II","Leader of The Pact I",
-    };
-    for (auto* b : bads) {
-        if (strstr(nm, b) != nullptr) return true;
+struct CombatAgent {
+    bool     present = false;
+    char     name[COMBAT_NAME_MAX] = {};
+    uint64_t id = 0;
+    uint32_t prof = 0;
+    uint32_t elite = 0;
+    uint32_t self = 0;
+    uint16_t team = 0;
+};
+
+struct CombatEvent {
+    double   t_s = 0.0;             // now_s() at callback time
+    bool     has_ev = false;        // false -> agent/identity notification
+    uint64_t time = 0;
+    int32_t  value = 0;
+    uint32_t skillid = 0;
+    uint8_t  is_activation = 0;
+    uint8_t  is_buffremove = 0;
+    uint8_t  is_statechange = 0;
+    uint8_t  is_buff = 0;
+    bool     cd_candidate = false;  // self cast of a tracked skill (or pick mode)
+    bool     relevant = true;       // false: only queued for the capture file
+    const char* skillname = nullptr; // arcdps skill names live as long as arcdps
+    CombatAgent src;
+    CombatAgent dst;
+};
+
+struct CombatQueue {
+    CombatEvent slots[COMBAT_QUEUE_CAP];
+    alignas(64) std::atomic<uint32_t> head{ 0 };   // written by producer
+    alignas(64) std::atomic<uint32_t> tail{ 0 };   // written by consumer
+    std::atomic<uint32_t> peak{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+
+    // Producer: returns a slot to fill, or nullptr when full.
+    CombatEvent* reserve() {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        const uint32_t t = tail.load(std::memory_order_acquire);
+        if (h - t >= COMBAT_QUEUE_CAP) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &slots[h & (COMBAT_QUEUE_CAP - 1)];
+    }
+
+    void commit() {
+        const uint32_t h = head.load(std::memory_order_relaxed) + 1;
+        head.store(h, std::memory_order_release);
+
+        const uint32_t depth = h - tail.load(std::memory_order_relaxed);
+        if (depth > peak.load(std::memory_order_relaxed))
+            peak.store(depth, std::memory_order_relaxed);
+    }
+
+    // Consumer: nullptr when empty. Call pop() once done with the slot.
+    const CombatEvent* front() const {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return nullptr;
+        return &slots[t & (COMBAT_QUEUE_CAP - 1)];
+    }
+
+    void pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    uint32_t depth() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+};
+
+static CombatQueue g_combat_queue;
+
+static void copy_agent(CombatAgent& out, const ag* a) {
+    if (!a) {
+        out.present = false;
+        out.name[0] = '\0';
+        return;
+    }
+    out.present = true;
+    out.id = a->id;
+    out.prof = a->prof;
+    out.elite = a->elite;
+    out.self = a->self;
+    out.team = a->team;
+    if (a->name) {
+        std::strncpy(out.name, a->name, COMBAT_NAME_MAX - 1);
+        out.name[COMBAT_NAME_MAX - 1] = '\0';
+    }
+    else {
+        out.name[0] = '\0';
     }
-    return false;
 }
 
-static void __cdecl on_combat(cbtevent* ev, ag* src, ag* dst,
-    const char* skillname, uint64_t id, uint64_t rev) {
+static bool agent_is_self(const CombatAgent& a) { return a.present && a.self; }
+
+// Skill names from arcdps are stable pointers, so only re-intern when it moves.
+static void set_timer_name(SlotTimer& st, uint32_t sid, const char* skillname) {
+    st.skillid = sid;
+    if (skillname && *skillname) {
+        if (st.name_src != skillname) {
+            st.name = intern_name(skillname);
+            st.name_src = skillname;
+        }
+    }
+    else if (st.name == 0) {
+        st.name = intern_name("skill " + std::to_string(sid));
+    }
+}
+
+// Everything below runs on the consumer side with g_mutex held.
+static void apply_combat_event_locked(const CombatEvent& ce) {
+    const CombatAgent* src = ce.src.present ? &ce.src : nullptr;
+    const CombatAgent* dst = ce.dst.present ? &ce.dst : nullptr;
 
     // ---- IDENTITY / MAP CHANGE HANDSHAKE ----
-    if (!ev) {
+    if (!ce.has_ev) {
         // Full map change / log reset
         if (!src && !dst) {
-            std::scoped_lock lk(g_mutex);
             g_in_map_change = true;
-            g_squad_accounts.clear();
+            g_map_change_s = ce.t_s;
+            g_map_change_saw_loading = false;
+            g_self_in_combat = false;
+            roster_clear_locked();
             g_self_accountname.clear();
-            g_dead_accounts.clear();
-            g_self.has_alacrity = false;
-            g_self.has_chill = false;
-            g_alac_until_s = 0.0;
-            g_chill_until_s = 0.0;
+            clear_self_boons_locked(ce.t_s);
             return;
         }
 
+        // Agent added / removed: src->id is the agent id combat events carry,
+        // src->name the character, dst->name the account, dst->team the subgroup
+        if (src && dst && src->elite == 0) {
+            if (src->prof == 0) {
+                roster_remove_locked(src->id);
+                return;
+            }
+            RosterMember& m = roster_touch_locked(src->id, src->name);
+            if (m.account != dst->name || !m.in_squad) {
+                m.account = dst->name;
+                m.in_squad = true;
+                m.gen = ++g_roster_gen;
+            }
+        }
+
         // Agent info for self
         if (dst && dst->self) {
-            std::scoped_lock lk(g_mutex);
             g_self_prof = dst->prof;
             g_self.self_instid = dst->id;
             g_self.subgroup = dst->team;
             g_self.elite = dst->elite;   // read elite spec from Arc
 
-            if (src && src->name && *src->name) {
+            if (src && *src->name) {
                 g_self_charname = src->name;
             }
-            else if (dst->name && *dst->name) {
+            else if (*dst->name) {
                 g_self_charname = dst->name;
             }
 
-            if (dst->name && *dst->name) {
+            if (*dst->name) {
                 g_self_accountname = dst->name;
-                g_squad_accounts.insert(g_self_accountname);
             }
         }
-        return;
+        return;
+    }
+
+    // ---- SQUAD MEMBERSHIP TRACKING ----
+    g_in_map_change = false;
+
+    auto record_member = [&](const CombatAgent* a) {
+        if (!a || !*a->name || a->team == 0) return;
+        RosterMember& m = roster_touch_locked(a->id, a->name);
+        if (!m.in_squad) {
+            m.in_squad = true;
+            m.gen = ++g_roster_gen;
+        }
+        };
+    record_member(src);
+    record_member(dst);
+
+    g_last_ev_ms = ce.time;
+    const double now = g_clock_map.map(ce.time, ce.t_s);
+
+    // ---- DOWN / DEAD / UP TRACKING (for greying + self boon clear) ----
+    if (ce.is_statechange == CBTS_CHANGEDOWN ||
+        ce.is_statechange == CBTS_CHANGEDEAD ||
+        ce.is_statechange == CBTS_CHANGEUP) {
+
+        // Arc usually puts the changing agent in src, but fall back to dst just in case.
+        const CombatAgent* a = src ? src : dst;
+        if (a && *a->name) {
+            if (ce.is_statechange == CBTS_CHANGEDOWN ||
+                ce.is_statechange == CBTS_CHANGEDEAD) {
+                // Mark as down/dead for UI grey-out
+                RosterMember& m = roster_touch_locked(a->id, a->name);
+                if (!m.dead) {
+                    m.dead = true;
+                    m.gen = ++g_roster_gen;
+                }
+
+                // If it's us, boons are gone from here on
+                if (a->self) {
+                    clear_self_boons_locked(now);
+                }
+            }
+            else if (ce.is_statechange == CBTS_CHANGEUP) {
+                // Back up -> clear dead flag
+                auto it = g_roster.find(a->id);
+                if (it != g_roster.end() && it->second.dead) {
+                    it->second.dead = false;
+                    it->second.gen = ++g_roster_gen;
+                }
+            }
+        }
+    }
+
+    // ---- SELF COMBAT STATE (drives the net cadence) ----
+    if ((ce.is_statechange == CBTS_ENTERCOMBAT ||
+        ce.is_statechange == CBTS_EXITCOMBAT ||
+        ce.is_statechange == CBTS_LOGEND) &&
+        ((src && src->self) || (dst && dst->self))) {
+
+        g_self_in_combat = ce.is_statechange == CBTS_ENTERCOMBAT;
+    }
+
+    // ---- CLEAR ALAC/CHILL ON EXITCOMBAT / LOGEND ----
+    if ((ce.is_statechange == CBTS_EXITCOMBAT ||
+        ce.is_statechange == CBTS_LOGEND) &&
+        dst && dst->self) {
+
+        clear_self_boons_locked(now);
+    }
+
+    // ---- TRACK ALAC / CHILL BUFFS ----
+    if (ce.is_statechange == CBTS_NONE &&
+        dst && dst->self &&
+        (ce.skillid == BUFF_ALACRITY || ce.skillid == BUFF_CHILL)) {
+
+        // Start from the state as of this event (expiries already passed drop out)
+        expire_self_boon_flags_locked(now);
+        bool alac = g_self.has_alacrity;
+        bool chill = g_self.has_chill;
+        double alac_until = g_alac_until_s;
+        double chill_until = g_chill_until_s;
+
+        // Many buff events have duration in ms in ev->value, but not all.
+        double dur_s = 0.0;
+        if (ce.value > 0) {
+            dur_s = (double)ce.value / 1000.0;
+        }
+
+        if (ce.skillid == BUFF_ALACRITY) {
+            if (ce.is_buffremove == 0) {
+                // Alacrity applied / refreshed
+                alac = true;
+
+                // If we got a duration, remember it; otherwise 0 means “unknown”
+                // and we rely on explicit buffremove/exitcombat/down
+                alac_until = (dur_s > 0.0) ? now + dur_s : 0.0;
+            }
+            else {
+                // Alacrity removed / strips / full clear
+                alac = false;
+            }
+        }
+        else { // BUFF_CHILL
+            if (ce.is_buffremove == 0) {
+                // Chill applied / refreshed
+                chill = true;
+
+                // Chill is usually short. If the event has no duration, fall back to a
+                // small timeout so it can NEVER get stuck “on”.
+                if (dur_s <= 0.0) {
+                    dur_s = 3.0; // conservative fallback, tweak if you want
+                }
+                chill_until = now + dur_s;
+            }
+            else {
+                // Chill removed / expired / cleansed
+                chill = false;
+            }
+        }
+
+        set_self_boons_locked(now, alac, alac_until, chill, chill_until);
+    }
+
+    // --------------------------------------------------------------------
+    // From here down: your existing self/pick/cooldown logic unchanged
+    // --------------------------------------------------------------------
+
+    const bool is_self = ((src && src->self) || (dst && dst->self));
+    if (!is_self) return;
+
+    const char* skillname = ce.skillname;
+    const bool trackable = ce.cd_candidate &&
+        classify_skill_locked(ce.skillid, skillname) == SkillClass::Trackable;
+
+    // Keep subgroup up to date
+    uint32_t team_src = (src ? src->team : 0);
+    uint32_t team_dst = (dst ? dst->team : 0);
+    uint32_t new_team = team_src ? team_src : team_dst;
+    if (new_team != 0) {
+        g_self.subgroup = new_team;
+    }
+
+    // ---- PICK MODE (Add tracked skill) ----
+    if (g_pick_row >= 0 && g_pick_row < (int)g_tracked.size()) {
+        if (now <= g_pick_armed_until_s) {
+            if (trackable && ce.time > g_pick_not_before_ms) {
+
+                auto& row = g_tracked[g_pick_row];
+
+                row.skillid = ce.skillid;
+                row.label = (skillname && *skillname)
+                    ? intern_name(skillname)
+                    : intern_name("skill " + std::to_string(ce.skillid));
+
+                auto itH = g_hard_override_cd.find(ce.skillid);
+                if (itH != g_hard_override_cd.end())
+                    row.base_cd = itH->second;
+
+                disarm_pick_locked();
+                rebuild_tracked_filter_locked();
+                g_settings_dirty.store(true, std::memory_order_relaxed);
+            }
+        }
+        else {
+            disarm_pick_locked();
+        }
+    }
+
+    // ---- COOLDOWN LOGIC WITH ACTIVATION GUARD ----
+    if (trackable) {
+
+        const uint32_t sid = ce.skillid;
+
+        switch (ce.is_activation) {
+        case ACTV_START:
+        case ACTV_CANCEL_FIRE:
+            // Real cast -> full cooldown
+        {
+            SlotTimer& st = g_by_skill[sid];
+            set_timer_name(st, sid, skillname);
+            st.on_cast(now);
+            const float base = get_base_cd_for_skill(sid, tracked_row_base_locked(sid));
+            if (base > 0.f) st.base_cd = base;
+            schedule_ready_locked(st, now);
+
+            // the squad should see this now, not on the next interval
+            g_last_tracked_cast_s = now;
+            if (!g_combat_sandboxed) request_push_now();
+        }
+        break;
+
+        case ACTV_CANCEL_CANCEL:
+        case ACTV_RESET:
+            // Cancelled cast -> short fake cooldown
+        {
+            SlotTimer& st = g_by_skill[sid];
+            set_timer_name(st, sid, skillname);
+            st.start_cancel_cd(now);
+            schedule_ready_locked(st, now);
+        }
+        break;
+
+        default:
+            // ACTV_NONE or others -> ignore for CD
+            break;
+        }
+    }
+}
+
+// -------------------- combat capture --------------------
+//
+// While capture is on, every combat callback (including ones the fast reject
+// would drop) is queued; the consumer serializes it into g_capture_buf and
+// flush_capture() writes that out after g_mutex is released, so neither the
+// combat thread nor a g_mutex holder ever touches the file. Format:
+// "SQCDCAP1", then one record per event:
+//   f64 t_s, u8 has_ev, u64 time, i32 value, u32 skillid,
+//   u8 activation, u8 buffremove, u8 statechange, u8 is_buff,
+//   str skillname, agent src, agent dst
+// where str = u16 len + bytes, and agent = u8 present
+//   [+ u64 id, u32 prof, u32 elite, u32 self, u16 team, str name].
+
+static const char CAPTURE_MAGIC[8] = { 'S','Q','C','D','C','A','P','1' };
+
+static std::atomic<bool> g_capture_enabled{ false };
+static std::string g_capture_buf;             // g_mutex; records not yet written
+static uint64_t g_capture_count = 0;          // g_mutex
+// Owns the file. Taken before g_mutex, never while holding it.
+static std::mutex g_capture_io_mutex;
+static FILE* g_capture_file = nullptr;        // g_capture_io_mutex
+
+static std::wstring capture_path() {
+    return dll_file(L"arcdps_cooldowns_capture.bin");
+}
+
+template <class T>
+static void cap_put(std::string& b, const T& v) {
+    b.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+static void cap_put_str(std::string& b, const char* s) {
+    const size_t n = s ? std::strlen(s) : 0;
+    const uint16_t len = (uint16_t)std::min<size_t>(n, 0xFFFF);
+    cap_put(b, len);
+    if (len) b.append(s, len);
+}
+
+static void cap_put_agent(std::string& b, const CombatAgent& a) {
+    const uint8_t present = a.present ? 1 : 0;
+    cap_put(b, present);
+    if (!present) return;
+    cap_put(b, a.id);
+    cap_put(b, a.prof);
+    cap_put(b, a.elite);
+    cap_put(b, a.self);
+    cap_put(b, a.team);
+    cap_put_str(b, a.name);
+}
+
+static void capture_event_locked(const CombatEvent& ce) {
+    std::string& b = g_capture_buf;
+    const uint8_t has_ev = ce.has_ev ? 1 : 0;
+    cap_put(b, ce.t_s);
+    cap_put(b, has_ev);
+    cap_put(b, ce.time);
+    cap_put(b, ce.value);
+    cap_put(b, ce.skillid);
+    cap_put(b, ce.is_activation);
+    cap_put(b, ce.is_buffremove);
+    cap_put(b, ce.is_statechange);
+    cap_put(b, ce.is_buff);
+    cap_put_str(b, ce.skillname);
+    cap_put_agent(b, ce.src);
+    cap_put_agent(b, ce.dst);
+    ++g_capture_count;
+}
+
+// g_capture_io_mutex held.
+static void write_capture_pending() {
+    std::string out;
+    {
+        std::scoped_lock lk(g_mutex);
+        out.swap(g_capture_buf);
+    }
+    if (g_capture_file && !out.empty()) fwrite(out.data(), 1, out.size(), g_capture_file);
+}
+
+// Call without g_mutex, after a pump.
+static void flush_capture() {
+    if (!g_capture_enabled.load(std::memory_order_relaxed)) return;
+    std::scoped_lock io(g_capture_io_mutex);
+    write_capture_pending();
+}
+
+static void set_capture(bool on) {
+    std::scoped_lock io(g_capture_io_mutex);
+    if (on && !g_capture_file) {
+        FILE* f = open_file(capture_path(), L"wb");
+        if (!f) {
+            arc_log("[sqcd] capture: could not open file");
+            return;
+        }
+        fwrite(CAPTURE_MAGIC, 1, sizeof(CAPTURE_MAGIC), f);
+        {
+            std::scoped_lock lk(g_mutex);
+            g_capture_buf.clear();
+            g_capture_count = 0;
+        }
+        g_capture_file = f;
+        g_capture_enabled.store(true, std::memory_order_relaxed);
+    }
+    else if (!on && g_capture_file) {
+        g_capture_enabled.store(false, std::memory_order_relaxed);
+        write_capture_pending();
+        fclose(g_capture_file);
+        g_capture_file = nullptr;
+    }
+}
+
+// Apply everything queued so far. Caller holds g_mutex.
+static void drain_combat_queue_locked() {
+    while (const CombatEvent* ce = g_combat_queue.front()) {
+        if (g_capture_enabled.load(std::memory_order_relaxed)) capture_event_locked(*ce);
+        if (ce->relevant) apply_combat_event_locked(*ce);
+        g_combat_queue.pop();
+    }
+}
+
+// A map change ends with the next combat event, when the loading screen it
+// brought up goes away, or after MAP_CHANGE_MAX_S on a map too quiet for
+// either; until then net_loop doesn't pull.
+static void end_map_change_if_done_locked(double now) {
+    if (!g_in_map_change) return;
+    if (g_game_loading.load(std::memory_order_relaxed))
+        g_map_change_saw_loading = true;
+    else if (g_map_change_saw_loading || now - g_map_change_s > MAP_CHANGE_MAX_S)
+        g_in_map_change = false;
+}
+
+// Consumer entry point: apply queued events, then fire due ready transitions.
+static void pump_combat_locked() {
+    drain_combat_queue_locked();
+    const double now = now_s();
+    end_map_change_if_done_locked(now);
+    if (g_pick_row >= 0 && now > g_pick_armed_until_s) disarm_pick_locked();   // nothing picked in time
+    expire_self_boon_flags_locked(now);
+    tick_ready_wheel_locked(now);
+}
+
+// Producer side of on_combat (and of a replay, into its own queue). t_s is
+// the timestamp the consumer will use. False if nothing was queued.
+static bool enqueue_combat(CombatQueue& q, cbtevent* ev, ag* src, ag* dst,
+    const char* skillname, double t_s) {
+    bool cd_candidate = false;
+    bool relevant = true;
+    if (ev) {
+        const bool is_self = (src && src->self) || (dst && dst->self);
+        cd_candidate = is_self && ev->skillid != 0 && ev->is_buff == 0 &&
+            g_tracked_filter.wants(ev->skillid, t_s);
+
+        // Fast reject: not about us, not a state change, no squad member involved.
+        auto in_squad = [](const ag* a) { return a && a->name && *a->name && a->team != 0; };
+        if (!is_self && ev->is_statechange == CBTS_NONE && !in_squad(src) && !in_squad(dst)) {
+            if (!g_capture_enabled.load(std::memory_order_relaxed))
+                return false;
+            relevant = false;   // queued only so the capture sees it
+        }
+    }
+
+    CombatEvent* ce = q.reserve();
+    if (!ce) return false;   // full: counted in q.dropped
+
+    ce->t_s = t_s;
+    ce->has_ev = (ev != nullptr);
+    ce->cd_candidate = cd_candidate;
+    ce->relevant = relevant;
+    ce->skillname = skillname;
+    copy_agent(ce->src, src);
+    copy_agent(ce->dst, dst);
+
+    if (ev) {
+        ce->time = ev->time;
+        ce->value = ev->value;
+        ce->skillid = ev->skillid;
+        ce->is_activation = ev->is_activation;
+        ce->is_buffremove = ev->is_buffremove;
+        ce->is_statechange = ev->is_statechange;
+        ce->is_buff = ev->is_buff;
+    }
+    else {
+        ce->time = 0;
+        ce->value = 0;
+        ce->skillid = 0;
+        ce->is_activation = 0;
+        ce->is_buffremove = 0;
+        ce->is_statechange = 0;
+        ce->is_buff = 0;
+    }
+
+    q.commit();
+    return true;
+}
+
+static void __cdecl on_combat(cbtevent* ev, ag* src, ag* dst,
+    const char* skillname, uint64_t id, uint64_t rev) {
+    (void)id;
+    (void)rev;
+
+    enqueue_combat(g_combat_queue, ev, src, dst, skillname, now_s());
+}
+
+// -------------------- combat replay --------------------
+//
+// Feeds a capture back through enqueue_combat on a worker thread, using the
+// captured timestamps (rebased) so the resulting timers are reproducible.
+// The worker produces into its own queue (on_combat stays the only producer
+// of the live one) and drains it once per frame's worth of wall time into a
+// CombatState of its own. Latency is enqueue to timer update, queue wait
+// included. Pacing: speed 1 = real time, 0 = as fast as possible.
+
+static constexpr auto REPLAY_FRAME = std::chrono::milliseconds(16);   // a consumer pump per frame
+static CombatQueue g_replay_queue;   // replay thread is producer and consumer
+
+struct ReplayEvent {
+    double   t_s = 0.0;
+    bool     has_ev = false;
+    cbtevent ev{};
+    bool     has_src = false, has_dst = false;
+    ag       src{}, dst{};
+    NameId   skillname = 0, src_name = 0, dst_name = 0;
+};
+
+struct ReplayReport {
+    bool     running = false;
+    uint64_t events = 0;
+    double   wall_s = 0.0;
+    double   events_per_s = 0.0;
+    double   p50_us = 0.0, p90_us = 0.0, p99_us = 0.0, max_us = 0.0;
+    size_t   timers = 0;
+    std::string error;
+};
+
+static std::mutex g_replay_mutex;
+static ReplayReport g_replay_report;     // g_replay_mutex
+static std::thread g_replay_thread;
+static std::atomic<bool> g_replay_stop{ false };   // mod_release: end a paced replay early
+static float g_replay_speed = 0.f;
+
+static bool cap_read(FILE* f, void* p, size_t n) { return fread(p, 1, n, f) == n; }
+
+static bool cap_read_str(FILE* f, NameId& out) {
+    uint16_t len = 0;
+    if (!cap_read(f, &len, sizeof(len))) return false;
+    std::string s(len, '\0');
+    if (len && !cap_read(f, s.data(), len)) return false;
+    out = len ? intern_name(s) : 0;
+    return true;
+}
+
+static bool cap_read_agent(FILE* f, bool& present, ag& a, NameId& name) {
+    uint8_t p = 0;
+    if (!cap_read(f, &p, 1)) return false;
+    present = p != 0;
+    if (!present) return true;
+    uint64_t id = 0;
+    uint16_t team = 0;
+    if (!cap_read(f, &id, sizeof(id)) ||
+        !cap_read(f, &a.prof, sizeof(a.prof)) ||
+        !cap_read(f, &a.elite, sizeof(a.elite)) ||
+        !cap_read(f, &a.self, sizeof(a.self)) ||
+        !cap_read(f, &team, sizeof(team))) return false;
+    a.id = (uintptr_t)id;
+    a.team = team;
+    return cap_read_str(f, name);
+}
+
+static bool load_capture(const std::wstring& path, std::vector<ReplayEvent>& out, std::string& err) {
+    FILE* f = open_file(path, L"rb");
+    if (!f) { err = "no capture file"; return false; }
+
+    char magic[sizeof(CAPTURE_MAGIC)];
+    if (!cap_read(f, magic, sizeof(magic)) || std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0) {
+        fclose(f);
+        err = "bad capture header";
+        return false;
+    }
+
+    for (;;) {
+        ReplayEvent r;
+        uint8_t has_ev = 0;
+        if (!cap_read(f, &r.t_s, sizeof(r.t_s))) break;   // clean EOF
+        bool ok =
+            cap_read(f, &has_ev, 1) &&
+            cap_read(f, &r.ev.time, sizeof(r.ev.time)) &&
+            cap_read(f, &r.ev.value, sizeof(r.ev.value)) &&
+            cap_read(f, &r.ev.skillid, sizeof(r.ev.skillid)) &&
+            cap_read(f, &r.ev.is_activation, 1) &&
+            cap_read(f, &r.ev.is_buffremove, 1) &&
+            cap_read(f, &r.ev.is_statechange, 1) &&
+            cap_read(f, &r.ev.is_buff, 1) &&
+            cap_read_str(f, r.skillname) &&
+            cap_read_agent(f, r.has_src, r.src, r.src_name) &&
+            cap_read_agent(f, r.has_dst, r.dst, r.dst_name);
+        if (!ok) break;   // truncated tail (capture still open) is fine
+        r.has_ev = has_ev != 0;
+        out.push_back(r);
+    }
+    fclose(f);
+    if (out.empty()) err = "capture is empty";
+    return !out.empty();
+}
+
+// Also run directly, off the game, by tests/replay.cpp.
+static void replay_worker(float speed, const std::wstring& path) {
+    using clock = std::chrono::steady_clock;
+    ReplayReport rep;
+
+    std::vector<ReplayEvent> events;
+    if (!load_capture(path, events, rep.error)) {
+        std::lock_guard<std::mutex> lk(g_replay_mutex);
+        g_replay_report = rep;
+        return;
+    }
+
+    const double base_s = now_s();
+    const double t0 = events.front().t_s;
+    auto sandbox = std::make_unique<CombatState>();
+
+    std::vector<clock::time_point> queued_at;   // per queued event, in queue order
+    queued_at.reserve(events.size());
+    size_t applied = 0;
+    std::vector<float> lat_us;
+    lat_us.reserve(events.size());
+
+    auto drain = [&] {
+        std::scoped_lock lk(g_mutex);
+        swap_combat_state_locked(*sandbox);
+        while (const CombatEvent* ce = g_replay_queue.front()) {
+            if (ce->relevant) apply_combat_event_locked(*ce);
+            g_replay_queue.pop();
+            lat_us.push_back(std::chrono::duration<float, std::micro>(
+                clock::now() - queued_at[applied++]).count());
+        }
+        swap_combat_state_locked(*sandbox);
+        };
+
+    const auto wall0 = clock::now();
+    auto next_pump = wall0 + REPLAY_FRAME;
+    auto pump_if_due = [&] {
+        if (clock::now() >= next_pump || g_replay_queue.depth() >= COMBAT_QUEUE_CAP / 2) {
+            drain();
+            next_pump = clock::now() + REPLAY_FRAME;
+        }
+        };
+
+    for (auto& r : events) {
+        if (g_replay_stop.load(std::memory_order_relaxed)) break;
+        if (speed > 0.f) {
+            const auto due = wall0 + std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double>((r.t_s - t0) / speed));
+            // in slices, so a long gap in the capture can't hold up unloading
+            for (auto t = clock::now(); t < due && !g_replay_stop.load(std::memory_order_relaxed);
+                t = clock::now()) {
+                pump_if_due();
+                std::this_thread::sleep_for(std::min<clock::duration>({ due - t,
+                    std::max<clock::duration>(next_pump - t, clock::duration::zero()),
+                    std::chrono::milliseconds(50) }));
+            }
+        }
+        pump_if_due();
+
+        r.src.name = r.src_name ? const_cast<char*>(name_cstr(r.src_name)) : nullptr;
+        r.dst.name = r.dst_name ? const_cast<char*>(name_cstr(r.dst_name)) : nullptr;
+
+        const auto a = clock::now();
+        if (enqueue_combat(g_replay_queue, r.has_ev ? &r.ev : nullptr,
+            r.has_src ? &r.src : nullptr,
+            r.has_dst ? &r.dst : nullptr,
+            r.skillname ? name_cstr(r.skillname) : nullptr,
+            base_s + (r.t_s - t0)))
+            queued_at.push_back(a);
+    }
+    drain();
+    const auto wall1 = clock::now();
+
+    // Dump timers relative to the replay start so runs can be diffed.
+    std::string dump;
+    {
+        std::scoped_lock lk(g_mutex);
+        swap_combat_state_locked(*sandbox);
+        rep.timers = g_by_skill.size();
+        const double end_s = base_s + (events.back().t_s - t0);
+        char line[256];
+        for (auto& kv : g_by_skill) {
+            const SlotTimer& st = kv.second;
+            const double recharged = st.last_cast_s < 0 ? 0.0
+                : g_recharge.integrate(st.last_cast_s, end_s);
+            std::snprintf(line, sizeof(line), "%u\t%s\tcast=%.3f\trecharged=%.3f\tcancel=%d\n",
+                st.skillid, name_cstr(st.name),
+                st.last_cast_s < 0 ? -1.0 : st.last_cast_s - base_s,
+                recharged, st.cancel_active ? 1 : 0);
+            dump += line;
+        }
+        swap_combat_state_locked(*sandbox);
+    }
+    write_file_utf8(dll_file(L"arcdps_cooldowns_replay.txt"), dump);
+
+    rep.events = events.size();
+    rep.wall_s = std::chrono::duration<double>(wall1 - wall0).count();
+    rep.events_per_s = rep.wall_s > 0.0 ? rep.events / rep.wall_s : 0.0;
+
+    if (!lat_us.empty()) {
+        std::sort(lat_us.begin(), lat_us.end());
+        auto pct = [&](double q) { return (double)lat_us[(size_t)(q * (lat_us.size() - 1))]; };
+        rep.p50_us = pct(0.50);
+        rep.p90_us = pct(0.90);
+        rep.p99_us = pct(0.99);
+        rep.max_us = lat_us.back();
+    }
+
+    std::lock_guard<std::mutex> lk(g_replay_mutex);
+    g_replay_report = rep;
+}
+
+static void start_replay(float speed) {
+    {
+        std::lock_guard<std::mutex> lk(g_replay_mutex);
+        if (g_replay_report.running) return;
+        g_replay_report = ReplayReport{};
+        g_replay_report.running = true;
+    }
+    if (g_replay_thread.joinable()) g_replay_thread.join();   // previous run is done
+    g_replay_thread = std::thread(replay_worker, speed, capture_path());
+}
+
+static std::thread g_net_thread;
+static bool g_net_alive = false;
+static bool g_initialized = false;
+
+static std::string make_guid() {
+#ifdef _WIN32
+    GUID g;
+    CoCreateGuid(&g);
+#else
+    struct { uint32_t Data1; uint16_t Data2, Data3; uint8_t Data4[8]; } g;
+    std::random_device rd;
+    for (uint8_t* p = (uint8_t*)&g; p < (uint8_t*)&g + sizeof(g); ++p) *p = (uint8_t)rd();
+#endif
+    char buf[64];
+    std::snprintf(buf, sizeof(buf),
+        "%08lX-%04hX-%04hX-%02hhX%02hhX-%02hhX%02hhX%02hhX%02hhX%02hhX%02hhX",
+        (unsigned long)g.Data1, g.Data2, g.Data3,
+        g.Data4[0], g.Data4[1], g.Data4[2], g.Data4[3],
+        g.Data4[4], g.Data4[5], g.Data4[6], g.Data4[7]);
+    return buf;
+}
+
+// -------------------- published peer list --------------------
+//
+// The peer list the overlay draws is an immutable PeerSnapshot. The threads
+// that change it (net, room stream, UDP; serialized by g_peers_mutex) build
+// the next one off to the side, take g_mutex only to settle it against the
+// local state (self entry, group orders), and publish it with one pointer
+// swap. The render thread is the only reader: it pins the current snapshot in
+// a hazard slot while it draws, and writers reclaim every retired snapshot but
+// the pinned one. Nothing on the render or combat path waits for a decode.
+// Lock order: g_peers_mutex, then g_mutex.
+
+struct PeerSnapshot {
+    std::vector<Peer> peers;
+};
+
+static std::mutex g_peers_mutex;                             // writers only
+static std::atomic<PeerSnapshot*> g_peer_snap{ nullptr };
+static std::atomic<PeerSnapshot*> g_peer_snap_pinned{ nullptr };  // render thread's hazard
+static std::vector<PeerSnapshot*> g_peer_snap_retired;       // g_peers_mutex
+static PeerSnapshot* g_peer_snap_spare = nullptr;            // g_peers_mutex; storage to refill
+
+// The snapshot to fill next, with g_peers_mutex held. With `copy` it starts as
+// the current list; otherwise its contents are stale and the caller replaces
+// them. Reclaimed snapshots are refilled, so the copy reuses their strings.
+static PeerSnapshot* next_peer_snapshot(bool copy) {
+    PeerSnapshot* s = g_peer_snap_spare;
+    g_peer_snap_spare = nullptr;
+    if (!s) s = new PeerSnapshot;
+    if (copy) {
+        const PeerSnapshot* cur = g_peer_snap.load();
+        if (cur) s->peers = cur->peers;
+        else s->peers.clear();
+    }
+    return s;
+}
+
+// mod_release, once the writers are joined and nothing draws any more.
+static void free_peer_snapshots() {
+    std::scoped_lock pk(g_peers_mutex);
+    delete g_peer_snap.exchange(nullptr);
+    for (PeerSnapshot* s : g_peer_snap_retired) delete s;
+    g_peer_snap_retired.clear();
+    delete g_peer_snap_spare;
+    g_peer_snap_spare = nullptr;
+}
+
+// Makes `next` current and reclaims what the render thread is not drawing.
+// g_peers_mutex held; `next` must not be touched afterwards.
+static void publish_peer_snapshot(PeerSnapshot* next) {
+    PeerSnapshot* old = g_peer_snap.exchange(next);
+    if (old) g_peer_snap_retired.push_back(old);
+
+    PeerSnapshot* pinned = g_peer_snap_pinned.load();
+    auto& retired = g_peer_snap_retired;
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [&](PeerSnapshot* s) {
+        if (s == pinned) return false;
+        if (!g_peer_snap_spare) g_peer_snap_spare = s;
+        else delete s;
+        return true;
+        }), retired.end());
+}
+
+// The current snapshot, held for the render thread until the pin goes out of
+// scope. The re-check after pinning catches a publish in between: either the
+// writer saw the pin, or we see its new snapshot and pin that instead.
+struct PeerSnapshotPin {
+    const PeerSnapshot* snap;
+
+    PeerSnapshotPin() {
+        PeerSnapshot* s = g_peer_snap.load();
+        for (;;) {
+            g_peer_snap_pinned.store(s);
+            PeerSnapshot* again = g_peer_snap.load();
+            if (again == s) break;
+            s = again;
+        }
+        snap = s;
+    }
+    ~PeerSnapshotPin() { g_peer_snap_pinned.store(nullptr); }
+
+    PeerSnapshotPin(const PeerSnapshotPin&) = delete;
+    PeerSnapshotPin& operator=(const PeerSnapshotPin&) = delete;
+};
+
+static void ensure_group_membership_locked(const std::vector<Peer>& peers) {
+    std::unordered_map<uint32_t, std::unordered_set<std::string>> have;
+    for (auto& kv : g_group_order) {
+        have[kv.first] = std::unordered_set<std::string>(kv.second.begin(), kv.second.end());
+    }
+    for (auto& p : peers) {
+        uint32_t pr = p.prof;
+        if (g_group_order.find(pr) == g_group_order.end())
+            g_group_order[pr] = {};
+        if (!have[pr].count(p.id)) {
+            g_group_order[pr].push_back(p.id);
+            have[pr].insert(p.id);
+        }
+    }
+    std::unordered_set<std::string> all_ids_now;
+    for (auto& p : peers) all_ids_now.insert(p.id);
+    for (auto& kv : g_group_order) {
+        auto& vec = kv.second;
+        vec.erase(std::remove_if(vec.begin(), vec.end(), [&](const std::string& id) {
+            return all_ids_now.find(id) == all_ids_now.end();
+            }), vec.end());
+    }
+}
+
+// Fills `p` from one peer object; false if it has no id.
+// Converts a number a peer sent. Out of range (or NaN) clamps to the type's
+// limits; a plain cast would be undefined.
+template <typename T>
+static T clamp_number(double v) {
+    if (!(v >= (double)std::numeric_limits<T>::lowest())) return std::numeric_limits<T>::lowest();
+    if (v >= (double)std::numeric_limits<T>::max()) return std::numeric_limits<T>::max();
+    return (T)v;
+}
+
+static bool parse_peer_json(const json& pj, Peer& p) {
+    if (!pj.is_object()) return false;
+
+    // ID: clientId preferred, fall back to legacy "id"
+    if (pj.contains("clientId") && pj["clientId"].is_string()) {
+        p.id = pj["clientId"].get<std::string>();
+    }
+    else if (pj.contains("id") && pj["id"].is_string()) {
+        p.id = pj["id"].get<std::string>();
+    }
+    else {
+        p.id.clear();
+    }
+    auto u32 = [&](const char* key) {
+        return pj.contains(key) && pj[key].is_number() ? clamp_number<uint32_t>(pj[key].get<double>()) : 0u;
+    };
+    p.elite = u32("elite");
+    p.prof = u32("prof");
+    p.subgroup = u32("subgroup");
+
+    // name may be null / missing
+    if (pj.contains("name") && pj["name"].is_string()) {
+        p.name = pj["name"].get<std::string>();
+    }
+    else {
+        p.name = "unknown";
+    }
+
+    // account can be null on old clients
+    if (pj.contains("account") && pj["account"].is_string()) {
+        p.account = pj["account"].get<std::string>();
+    }
+    else {
+        p.account.clear();
+    }
+
+    // clock measurement, from clients that sync with the relay
+    p.clock_known = pj.contains("rtt") && pj["rtt"].is_number();
+    p.rtt_ms = p.clock_known ? clamp_number<uint32_t>(pj["rtt"].get<double>()) : 0;
+    p.clock_offset_ms = (pj.contains("clockOffset") && pj["clockOffset"].is_number())
+        ? clamp_number<int32_t>(pj["clockOffset"].get<double>()) : 0;
+
+    p.entries.clear();
+    if (pj.contains("entries") && pj["entries"].is_array()) {
+        for (auto& ej : pj["entries"]) {
+            PeerEntry e;
+
+            if (ej.contains("label") && ej["label"].is_string()) {
+                e.label = ej["label"].get<std::string>();
+            }
+            else {
+                e.label.clear();
+            }
+
+            e.ready = ej.value("ready", false);
+
+            if (ej.contains("left") && ej["left"].is_number()) {
+                e.left = clamp_number<float>(ej["left"].get<double>());
+            }
+            else {
+                e.left = -1.f;
+            }
+
+            if (ej.contains("readyAt") && ej["readyAt"].is_number()) {
+                e.ready_at = clamp_number<int64_t>(ej["readyAt"].get<double>());
+            }
+
+            p.entries.push_back(e);
+        }
+    }
+
+    return !p.id.empty();
+}
+
+// Replaces the peer with the same id in place (keeping its position) or
+// appends it.
+static void upsert_peer(std::vector<Peer>& peers, Peer&& p) {
+    for (auto& q : peers) {
+        if (q.id == p.id) {
+            q = std::move(p);
+            return;
+        }
+    }
+    peers.push_back(std::move(p));
+}
+
+static void remove_peer(std::vector<Peer>& peers, const std::string& id) {
+    peers.erase(std::remove_if(peers.begin(), peers.end(),
+        [&](const Peer& p) { return p.id == id; }), peers.end());
+}
+
+// Departures first: a peer that left and came back is listed in both.
+static void apply_partial_peers(std::vector<Peer>& peers, std::vector<Peer>& changed,
+    const std::vector<std::string>& left) {
+    for (auto& id : left) remove_peer(peers, id);
+    for (auto& p : changed) upsert_peer(peers, std::move(p));
+}
+
+// Room version the peer table reflects, from the last /aggregate reply. Sent
+// back as since=/epoch= so the relay answers with only what changed, or 304.
+// The epoch changes when the relay restarts. net thread only.
+struct AggregateMeta {
+    uint64_t epoch = 0;
+    uint64_t version = 0;
+    bool partial = false;
+    std::vector<std::string> left;
+};
+
+static AggregateMeta g_agg_seen;
+
+static void inject_self_if_missing_locked(std::vector<Peer>& peers) {
+    const bool have_self =
+        std::any_of(peers.begin(), peers.end(), [&](const Peer& p) { return p.id == g_client_id; });
+
+    if (have_self) return;
+
+    Peer self;
+    self.id = g_client_id;
+    self.name = !g_self_charname.empty()
+        ? g_self_charname
+        : (g_assigned_name.empty() ? std::string("me") : g_assigned_name);
+    self.prof = g_self_prof;
+    self.subgroup = g_self.subgroup;
+
+    double now = now_s();
+
+    for (auto& e : g_tracked) {
+        if (!e.enabled || e.skillid == 0) continue;
+        bool ready = false;
+        float left = compute_left_for_local(e.skillid, e.base_cd, now, ready);
+
+        PeerEntry pe;
+        pe.label = name_str(e.label);
+        pe.ready = ready;
+        pe.left = (left < 0.f ? -1.f : left);
+        self.entries.push_back(pe);
+    }
+
+    peers.push_back(std::move(self));
+}
+
+// Last step before a snapshot is published: our own entry and the group
+// orders follow the list.
+static void settle_peers_locked(std::vector<Peer>& peers) {
+    inject_self_if_missing_locked(peers);
+    ensure_group_membership_locked(peers);
+}
+
+// -------------------- relay clock --------------------
+//
+// NTP-style sync against the relay: GET /time is answered with the relay's
+// clock ({ "now": ms }); with t0/t3 our send/receive times the sample is
+//   rtt = t3 - t0,  offset = now - (t0 + t3) / 2
+// The sample with the lowest RTT among the last CLOCK_SAMPLES wins (the one
+// least skewed by queueing). Pushes state when a cooldown will be ready on
+// the relay clock, so a viewer's countdown is right whatever the delay on
+// either leg; each client also reports its RTT and wall-clock offset, shown
+// per peer.
+
+static constexpr int CLOCK_SAMPLES = 8;
+static constexpr int CLOCK_BURST_MS = 250;        // until the first CLOCK_BURST samples
+static constexpr int CLOCK_BURST = 4;
+static constexpr int CLOCK_SYNC_MS = 15000;
+static constexpr int CLOCK_UNSUPPORTED_MS = 60000; // relay without /time
+
+struct ClockSample {
+    double rtt_ms = 0.0;
+    double offset_ms = 0.0;       // relay ms - now_s() ms
+    double wall_offset_ms = 0.0;  // relay ms - system clock ms
+};
+
+// net thread only
+static ClockSample g_clock_samples[CLOCK_SAMPLES];
+static int g_clock_sample_count = 0;
+static int g_clock_sample_next = 0;
+
+static std::atomic<bool> g_relay_clock_synced{ false };
+static std::atomic<double> g_relay_offset_ms{ 0.0 };
+static std::atomic<uint32_t> g_relay_rtt_ms{ 0 };
+static std::atomic<int32_t> g_relay_wall_offset_ms{ 0 };
+
+static double relay_now_ms() {
+    return now_s() * 1000.0 + g_relay_offset_ms.load(std::memory_order_relaxed);
+}
+
+static void smooth_ms(std::atomic<double>& avg, double sample) {
+    const double prev = avg.load(std::memory_order_relaxed);
+    avg.store(prev > 0.0 ? prev * 0.8 + sample * 0.2 : sample, std::memory_order_relaxed);
+}
+
+// Publish to arrival of peer changes, per path we receive them on: pushes
+// carry sentAt on the relay clock and the relay passes it along with the
+// change. Both ends read the relay clock through their own offset estimate,
+// so a sample is off by up to half of each side's best /time round trip.
+struct FanoutLatency {
+    std::atomic<double> avg_ms{ 0.0 };
+    std::atomic<double> min_ms{ 0.0 };
+    std::atomic<uint64_t> samples{ 0 };
+};
+
+static FanoutLatency g_fanout_udp;   // room datagrams
+static FanoutLatency g_fanout_sse;   // "peer" events on /events
+
+static constexpr double FANOUT_SAMPLE_MAX_MS = 10000.0;   // older means a stale stamp, not a delay
+
+static void note_fanout(FanoutLatency& f, int64_t sent_at) {
+    if (sent_at <= 0 || !g_relay_clock_synced.load(std::memory_order_relaxed)) return;
+    const double ms = relay_now_ms() - (double)sent_at;
+    if (ms > FANOUT_SAMPLE_MAX_MS || ms < -FANOUT_SAMPLE_MAX_MS) return;
+    smooth_ms(f.avg_ms, ms);
+    const double lo = f.min_ms.load(std::memory_order_relaxed);
+    if (f.samples.fetch_add(1, std::memory_order_relaxed) == 0 || ms < lo)
+        f.min_ms.store(ms, std::memory_order_relaxed);
+}
+
+// One /time exchange; false if the relay didn't answer it.
+static bool sample_relay_clock(HttpResponse& resp) {
+    const double t0 = now_s() * 1000.0;
+    if (!http_get(g_server_host, g_server_port, g_use_https, L"/time", resp) || resp.status != 200)
+        return false;
+    const double t3 = now_s() * 1000.0;
+    const double wall_t3 = (double)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    double relay_ms;
+    try {
+        NetScope parse(&g_net_stats[EP_TIME], NP_PARSE);
+        json j = json::parse(resp.body);
+        if (!j.is_object() || !j.contains("now") || !j["now"].is_number()) return false;
+        relay_ms = j["now"].get<double>();
+    }
+    catch (...) {
+        return false;
+    }
+
+    ClockSample cs;
+    cs.rtt_ms = t3 - t0;
+    cs.offset_ms = relay_ms - (t0 + t3) / 2.0;
+    cs.wall_offset_ms = relay_ms - (wall_t3 - cs.rtt_ms / 2.0);
+    g_clock_samples[g_clock_sample_next] = cs;
+    g_clock_sample_next = (g_clock_sample_next + 1) % CLOCK_SAMPLES;
+    if (g_clock_sample_count < CLOCK_SAMPLES) ++g_clock_sample_count;
+
+    const ClockSample* best = &g_clock_samples[0];
+    for (int i = 1; i < g_clock_sample_count; ++i) {
+        if (g_clock_samples[i].rtt_ms < best->rtt_ms) best = &g_clock_samples[i];
+    }
+    g_relay_offset_ms.store(best->offset_ms, std::memory_order_relaxed);
+    g_relay_rtt_ms.store((uint32_t)std::lround(best->rtt_ms), std::memory_order_relaxed);
+    g_relay_wall_offset_ms.store((int32_t)std::lround(best->wall_offset_ms), std::memory_order_relaxed);
+    g_relay_clock_synced.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+// Ready time of a peer entry on our clock: seconds left, or the sender's
+// `left` when there is no relay time to go by. Ready within one wheel tick,
+// the same slack the sender's own wheel fires with.
+static float peer_entry_left(const PeerEntry& e, double relay_now, bool& ready) {
+    if (e.ready_at > 0 && g_relay_clock_synced.load(std::memory_order_relaxed)) {
+        const float left = (float)(((double)e.ready_at - relay_now) / 1000.0);
+        ready = left <= (float)TimerWheel::TICK_S;
+        return left < 0.f ? 0.f : left;
+    }
+    ready = e.ready;
+    return e.left;
+}
+
+// -------------------- relay health --------------------
+//
+// Keeps the plugin from hammering a relay that is down or asking us to slow
+// down. net_loop reports each of its relay requests through relay_note():
+//  - no response or a 5xx is a failure; RELAY_TRIP_FAILURES in a row open
+//    the breaker. While it is open net_loop sends nothing but GET /health
+//    probes, spaced by exponential backoff with jitter (RELAY_BACKOFF_MIN_MS
+//    doubling up to RELAY_BACKOFF_MAX_MS), and the room stream and the UDP
+//    join hold off as well. The first probe the relay answers closes it and
+//    traffic resumes on the next tick.
+//  - a 429, or a 503 with Retry-After, holds all relay traffic for the time
+//    asked (at most RELAY_RETRY_AFTER_MAX_S) without counting as a failure.
+
+static constexpr int RELAY_TRIP_FAILURES = 2;
+static constexpr int RELAY_BACKOFF_MIN_MS = 500;
+static constexpr int RELAY_BACKOFF_MAX_MS = 10000;
+static constexpr int RELAY_RETRY_AFTER_MAX_S = 120;
+static constexpr int RELAY_THROTTLE_DEFAULT_S = 1;   // 429 without Retry-After
+static constexpr int RELAY_PROBE_DEADLINE_MS = 2000;
+
+// read by the other threads and the options window
+static std::atomic<bool> g_relay_open{ false };
+static std::atomic<double> g_relay_hold_until_s{ 0.0 };   // now_s() until which nothing is sent
+static std::atomic<double> g_relay_down_since_s{ 0.0 };   // first failure of the current outage
+static std::atomic<double> g_relay_next_probe_s{ 0.0 };
+static std::atomic<uint32_t> g_relay_probes{ 0 };         // sent during the current/last outage
+static std::atomic<uint64_t> g_relay_outages{ 0 };
+static std::atomic<uint64_t> g_relay_throttled{ 0 };      // 429/503 replies honoured
+static std::atomic<double> g_relay_last_outage_s{ 0.0 };
+
+// net thread only
+static int g_relay_failures = 0;   // consecutive
+static int g_relay_backoff_ms = RELAY_BACKOFF_MIN_MS;
+
+// True while relay traffic should wait: breaker open or Retry-After pending.
+static bool relay_paused() {
+    return g_relay_open.load(std::memory_order_relaxed) ||
+        now_s() < g_relay_hold_until_s.load(std::memory_order_relaxed);
+}
+
+// Half the delay fixed, half random, so clients that lost the relay together
+// don't all come back in the same instant.
+static int jittered_ms(int ms) {
+    thread_local std::minstd_rand rng{ (unsigned)std::chrono::steady_clock::now().time_since_epoch().count() };
+    return ms / 2 + (int)(rng() % (unsigned)(ms / 2 + 1));
+}
+
+// Honours a 429 / 503+Retry-After; false if `r` isn't one.
+static bool relay_note_throttle(const HttpResponse& r) {
+    if (r.status != 429 && !(r.status == 503 && r.retry_after_s >= 0)) return false;
+    const int s = r.retry_after_s >= 0
+        ? std::min(r.retry_after_s, RELAY_RETRY_AFTER_MAX_S) : RELAY_THROTTLE_DEFAULT_S;
+    const double until = now_s() + s;
+    if (until > g_relay_hold_until_s.load(std::memory_order_relaxed))
+        g_relay_hold_until_s.store(until, std::memory_order_relaxed);
+    g_relay_throttled.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Outcome of one relay request made by net_loop (status 0: no response).
+static void relay_note(const HttpResponse& r) {
+    if (relay_note_throttle(r)) return;
+    if (r.status > 0 && r.status < 500) {
+        g_relay_failures = 0;
+        return;
+    }
+    const double now = now_s();
+    if (++g_relay_failures == 1) g_relay_down_since_s.store(now, std::memory_order_relaxed);
+    if (g_relay_failures < RELAY_TRIP_FAILURES || g_relay_open.load(std::memory_order_relaxed)) return;
+
+    g_relay_backoff_ms = RELAY_BACKOFF_MIN_MS;
+    g_relay_next_probe_s.store(now + jittered_ms(g_relay_backoff_ms) / 1000.0, std::memory_order_relaxed);
+    g_relay_probes.store(0, std::memory_order_relaxed);
+    g_relay_outages.fetch_add(1, std::memory_order_relaxed);
+    g_relay_open.store(true, std::memory_order_relaxed);
+    arc_log("[sqcd] relay unreachable, backing off");
+}
+
+// While the breaker is open: GET /health once the backoff has run out. Any
+// answer below 500 (a relay without /health says 404) closes the breaker.
+static void relay_probe(HttpResponse& resp) {
+    if (now_s() < g_relay_next_probe_s.load(std::memory_order_relaxed)) return;
+    g_relay_probes.fetch_add(1, std::memory_order_relaxed);
+    http_get(g_server_host, g_server_port, g_use_https, L"/health", resp, nullptr, RELAY_PROBE_DEADLINE_MS);
+
+    const double now = now_s();
+    if (relay_note_throttle(resp) || (resp.status > 0 && resp.status < 500)) {
+        g_relay_failures = 0;
+        g_relay_last_outage_s.store(now - g_relay_down_since_s.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        g_relay_open.store(false, std::memory_order_relaxed);
+        g_push_requested.store(true, std::memory_order_relaxed);
+
+        char buf[128];
+        std::snprintf(buf, sizeof(buf), "[sqcd] relay back after %.1f s (%u probes)",
+            g_relay_last_outage_s.load(std::memory_order_relaxed),
+            g_relay_probes.load(std::memory_order_relaxed));
+        arc_log(buf);
+        return;
+    }
+    g_relay_backoff_ms = std::min(g_relay_backoff_ms * 2, RELAY_BACKOFF_MAX_MS);
+    g_relay_next_probe_s.store(now + jittered_ms(g_relay_backoff_ms) / 1000.0, std::memory_order_relaxed);
+}
+
+// -------------------- /update delta encoding --------------------
+//
+// Every push carries a sequence number. Once the relay has acknowledged a full
+// payload ("ack": seq), later pushes only carry what differs from the last
+// acknowledged state ("base": acked seq): changed top-level fields, the entry
+// count if it moved, and changed fields of changed entries. `left` moves on
+// every tick while a cooldown runs, so it is not diffed raw: an entry with
+// readyAt (viewers count down from that) doesn't send it at all, and one
+// without only when it crosses a whole second. The relay's change test skips
+// `left` the same way, so a push in a fight where nothing was cast or came off
+// cooldown is a heartbeat that doesn't touch the room version. The relay
+// answers "resync" when it cannot apply a delta (restart, prune, lost ack) and
+// the next push is full again. Relays that never acknowledge keep getting full
+// payloads.
+
+struct PushEntry {
+    std::string label;
+    bool ready = false;
+    float left = -1.f;     // < 0 is sent as null
+    uint32_t skillid = 0;
+    int64_t ready_at = 0;  // relay clock ms, 0 (sent as null) when idle or not synced
+};
+
+struct PushState {
+    std::string name;
+    std::string account;
+    uint32_t prof = 0;
+    uint32_t subgroup = 0;
+    uint32_t elite = 0;
+    bool clock = false;    // rtt/offset below are measured
+    uint32_t rtt_ms = 0;
+    int32_t clock_offset_ms = 0;
+    std::vector<PushEntry> entries;
+    int64_t sent_at = 0;   // relay ms when collected for sending, 0 = clock not synced
+};
+
+static constexpr int64_t READY_AT_STEP_MS = 50;  // keeps recomputed ready times from jittering deltas
+// Rows shared per client. relay.js refuses more (ENTRIES_MAX) and the delta
+// encoders size their per-row masks by it; tracked rows past it stay local.
+static constexpr size_t PUSH_ENTRIES_MAX = 256;
+
+// net thread only
+static PushState g_push_baseline;       // state the relay acknowledged
+static uint64_t g_push_seq = 0;
+static uint64_t g_push_acked = 0;       // 0 = no usable baseline, send full
+static std::atomic<bool> g_push_delta_ok{ false };  // relay acknowledged a full push
+static size_t g_push_full_size = 0;     // size of the last full payload
+
+// bytes/min over the last complete minute, for the options window
+static std::atomic<uint64_t> g_push_bytes_min{ 0 };
+static std::atomic<uint64_t> g_push_full_bytes_min{ 0 };
+static std::atomic<uint64_t> g_push_resyncs{ 0 };
+
+static void collect_push_state_locked(PushState& ps, double now) {
+    ps.name = !g_self_charname.empty() ? g_self_charname : g_assigned_name;
+    ps.account = g_self_accountname;
+    ps.prof = g_self_prof;
+    ps.subgroup = g_self.subgroup;
+    ps.elite = g_self.elite;
+    ps.clock = g_relay_clock_synced.load(std::memory_order_relaxed);
+    ps.rtt_ms = ps.clock ? g_relay_rtt_ms.load(std::memory_order_relaxed) : 0;
+    ps.clock_offset_ms = ps.clock ? g_relay_wall_offset_ms.load(std::memory_order_relaxed) : 0;
+    const double relay_now = relay_now_ms();
+    ps.sent_at = ps.clock ? (int64_t)std::llround(relay_now) : 0;
+
+    ps.entries.clear();
+    for (auto& e : g_tracked) {
+        if (!e.enabled || e.skillid == 0) continue;
+        if (ps.entries.size() == PUSH_ENTRIES_MAX) break;
+
+        bool ready = false;
+        float left = compute_left_for_shared(e.skillid, e.base_cd, now, ready);
+
+        PushEntry pe;
+        pe.label = name_str(e.label);
+        pe.ready = ready;
+        pe.left = (left < 0.f ? -1.f : left);
+        pe.skillid = e.skillid;
+        if (ps.clock && left > 0.f) {
+            const double at = relay_now + (double)left * 1000.0;
+            pe.ready_at = (int64_t)std::llround(at / READY_AT_STEP_MS) * READY_AT_STEP_MS;
+        }
+        ps.entries.push_back(std::move(pe));
+    }
+}
+
+static json push_left_json(float left) {
+    return left < 0.f ? json(nullptr) : json(left);
+}
+
+static json push_ready_at_json(int64_t at) {
+    return at == 0 ? json(nullptr) : json(at);
+}
+
+static void encode_full_update(const PushState& ps, json& payload) {
+    payload["name"] = ps.name;
+    payload["prof"] = ps.prof;
+    payload["subgroup"] = ps.subgroup;
+    payload["elite"] = ps.elite;
+    if (!ps.account.empty()) {
+        payload["account"] = ps.account;
+    }
+    if (ps.clock) {
+        payload["rtt"] = ps.rtt_ms;
+        payload["clockOffset"] = ps.clock_offset_ms;
+    }
+
+    payload["entries"] = json::array();
+    for (auto& pe : ps.entries) {
+        json row;
+        row["label"] = pe.label;
+        row["ready"] = pe.ready;
+        row["left"] = push_left_json(pe.left);
+        row["skillid"] = pe.skillid;
+        if (pe.ready_at) row["readyAt"] = pe.ready_at;
+        payload["entries"].push_back(std::move(row));
+    }
+}
+
+// Which top-level fields / entry fields differ from the baseline. Shared by
+// the JSON and binary delta encoders.
+enum : uint8_t {
+    PF_NAME = 1, PF_PROF = 2, PF_SUBGROUP = 4, PF_ELITE = 8, PF_ACCOUNT = 16, PF_COUNT = 32,
+    PF_CLOCK = 64
+};
+enum : uint8_t { PE_LABEL = 1, PE_READY = 2, PE_LEFT = 4, PE_SKILLID = 8, PE_READY_AT = 16 };
+static constexpr uint8_t PE_ALL = PE_LABEL | PE_READY | PE_LEFT | PE_SKILLID | PE_READY_AT;
+
+static uint8_t push_field_mask(const PushState& ps, const PushState& base) {
+    uint8_t m = 0;
+    if (ps.name != base.name) m |= PF_NAME;
+    if (ps.prof != base.prof) m |= PF_PROF;
+    if (ps.subgroup != base.subgroup) m |= PF_SUBGROUP;
+    if (ps.elite != base.elite) m |= PF_ELITE;
+    if (ps.account != base.account) m |= PF_ACCOUNT;
+    if (ps.entries.size() != base.entries.size()) m |= PF_COUNT;
+    if (ps.clock && (ps.rtt_ms != base.rtt_ms || ps.clock_offset_ms != base.clock_offset_ms ||
+        !base.clock))
+        m |= PF_CLOCK;
+    return m;
+}
+
+static int push_left_seconds(float left) {
+    return left < 0.f ? -1 : (int)std::ceil(left);
+}
+
+static uint8_t push_entry_mask(const PushEntry& pe, const PushEntry* be) {
+    if (!be) return PE_ALL;
+    uint8_t m = 0;
+    if (pe.label != be->label) m |= PE_LABEL;
+    if (pe.ready != be->ready) m |= PE_READY;
+    // the relay's copy is stale from when readyAt took over, or one second old
+    if (pe.ready_at == 0 &&
+        (be->ready_at != 0 || push_left_seconds(pe.left) != push_left_seconds(be->left)))
+        m |= PE_LEFT;
+    if (pe.skillid != be->skillid) m |= PE_SKILLID;
+    if (pe.ready_at != be->ready_at) m |= PE_READY_AT;
+    return m;
+}
+
+static void encode_delta_update(const PushState& ps, const PushState& base, json& payload) {
+    payload["base"] = g_push_acked;
+
+    const uint8_t fm = push_field_mask(ps, base);
+    if (fm & PF_NAME) payload["name"] = ps.name;
+    if (fm & PF_PROF) payload["prof"] = ps.prof;
+    if (fm & PF_SUBGROUP) payload["subgroup"] = ps.subgroup;
+    if (fm & PF_ELITE) payload["elite"] = ps.elite;
+    if (fm & PF_ACCOUNT) payload["account"] = ps.account;
+    if (fm & PF_COUNT) payload["entryCount"] = ps.entries.size();
+    if (fm & PF_CLOCK) {
+        payload["rtt"] = ps.rtt_ms;
+        payload["clockOffset"] = ps.clock_offset_ms;
+    }
+
+    json changed = json::array();
+    for (size_t i = 0; i < ps.entries.size(); ++i) {
+        const PushEntry& pe = ps.entries[i];
+        const uint8_t em = push_entry_mask(pe, i < base.entries.size() ? &base.entries[i] : nullptr);
+        if (!em) continue;
+
+        json row;
+        row["i"] = i;
+        if (em & PE_LABEL) row["label"] = pe.label;
+        if (em & PE_READY) row["ready"] = pe.ready;
+        if (em & PE_LEFT) row["left"] = push_left_json(pe.left);
+        if (em & PE_SKILLID) row["skillid"] = pe.skillid;
+        if (em & PE_READY_AT) row["readyAt"] = push_ready_at_json(pe.ready_at);
+        changed.push_back(std::move(row));
+    }
+    if (!changed.empty())
+        payload["entryDelta"] = std::move(changed);
+}
+
+// Group orders the user changed since the last push: (prof, clientIds).
+using PushOrders = std::vector<std::pair<uint32_t, std::vector<std::string>>>;
+
+static void collect_push_orders_locked(PushOrders& out) {
+    out.clear();
+    for (auto prof : g_group_order_dirty) {
+        auto it = g_group_order.find(prof);
+        if (it == g_group_order.end()) continue;
+        out.emplace_back(prof, it->second);
+    }
+    g_group_order_dirty.clear();
+}
+
+static void encode_orders_json(const PushOrders& orders, json& payload) {
+    if (orders.empty()) return;
+    json jo = json::object();
+    for (auto& po : orders) {
+        json arr = json::array();
+        for (auto& id : po.second) arr.push_back(id);
+        jo[std::to_string(po.first)] = std::move(arr);
+    }
+    payload["groupOrder"] = std::move(jo);
+}
+
+// -------------------- binary wire format --------------------
+//
+// Optional compact encoding of /update payloads and /aggregate responses,
+// selected by content type (WIRE_CONTENT_TYPE on the POST body / in Accept).
+// Integers are LEB128 varints, strings are varint length + bytes, `left` is
+// quantized to WIRE_LEFT_STEP (0 = null), and names/labels/accounts are
+// indices into a string dictionary:
+//
+//  - /update: a per-session dictionary owned by the client. Strings added
+//    since the last acknowledged push are re-sent as definitions until an ack
+//    covers them; a resync starts a new session with an empty dictionary.
+//  - /aggregate: a per-room dictionary owned by the relay. The client asks
+//    with dict=<id>.<count> and only receives strings it has not seen yet; a
+//    new id means the relay restarted or reset it, and the client starts over.
+//
+// Layouts (all fields in order; [v2] marks what version 2 added):
+//   header      u8 'Q', u8 version, u8 kind
+//   defs        varint first_index, varint n, n x str
+//   clock       [v2] varint rtt+1 (0 = not measured), zigzag varint offset
+//   entry       label, u8 ready, left, skillid, [v2] varint readyAt (0 = none)
+//   update      str room, str clientId, varint session, varint seq,
+//               [delta: varint base], defs,
+//               full:  str pluginVer, name, prof, subgroup, elite, account+1,
+//                      [v2] clock, varint n, n x entry
+//               delta: u8 PF_ mask, masked fields (entryCount, then clock
+//                      last), varint n, n x (varint i, u8 PE_ mask, masked
+//                      fields)
+//               orders, [varint sentAt, only when known]
+//   aggregate   varint dict id, defs, str room, varint epoch, varint version,
+//               u8 partial, [partial: varint n, n x str clientId left], orders,
+//               varint n, n x (str clientId, name, account+1, pluginVer+1,
+//                              prof, subgroup, elite, [v2] clock,
+//                              varint m, m x entry)
+//   orders      varint n, n x (varint prof, varint m, m x str clientId)
+//
+// We send version 2 and ask for it with "; v=2" in Accept; a relay that only
+// knows version 1 answers /aggregate in version 1, which still decodes.
+
+static const char* WIRE_CONTENT_TYPE = "application/x-sqcd";
+static const char* WIRE_ACCEPT = "application/x-sqcd; v=2";
+static constexpr uint8_t WIRE_MAGIC = 'Q';
+static constexpr uint8_t WIRE_VERSION = 2;
+static constexpr uint8_t WIRE_UPDATE_FULL = 0;
+static constexpr uint8_t WIRE_UPDATE_DELTA = 1;
+static constexpr uint8_t WIRE_AGGREGATE = 2;
+static constexpr float WIRE_LEFT_STEP = 0.05f;
+static constexpr uint32_t WIRE_TX_DICT_MAX = 1024;   // reset the session past this
+
+static std::atomic<bool> g_wire_rejected{ false };   // relay refused a binary /update
+
+struct WireWriter {
+    std::string& out;
+
+    void u8(uint8_t v) { out.push_back((char)v); }
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((char)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((char)v);
+    }
+    void str(std::string_view s) {
+        varint(s.size());
+        out.append(s.data(), s.size());
+    }
+    void svarint(int64_t v) { varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+    void left(float v) { varint(v < 0.f ? 0 : (uint64_t)std::lround(v / WIRE_LEFT_STEP) + 1); }
+};
+
+struct WireReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint8_t u8() {
+        if (p >= end) { ok = false; return 0; }
+        return *p++;
+    }
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) break;
+            const uint8_t b = *p++;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    std::string_view str() {
+        const uint64_t n = varint();
+        if (!ok || n > (uint64_t)(end - p)) { ok = false; return {}; }
+        std::string_view s((const char*)p, (size_t)n);
+        p += n;
+        return s;
+    }
+    int64_t svarint() {
+        const uint64_t u = varint();
+        return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    }
+    float left() {
+        const uint64_t q = varint();
+        return q == 0 ? -1.f : (float)(q - 1) * WIRE_LEFT_STEP;
+    }
+};
+
+static bool is_wire_response(const HttpResponse& r) {
+    return r.content_type.compare(0, std::strlen(WIRE_CONTENT_TYPE), WIRE_CONTENT_TYPE) == 0;
+}
+
+// ---- /update (client -> relay) ----
+
+// net thread only
+struct WireTxDict {
+    uint32_t session = 0;
+    std::unordered_map<std::string, uint32_t> index;
+    std::vector<std::string> strs;
+    uint32_t acked = 0;      // [0, acked) are known to the relay
+    uint32_t in_flight = 0;  // dictionary size when the pending push was sent
+
+    void restart() {
+        session = (uint32_t)std::chrono::steady_clock::now().time_since_epoch().count() | 1u;
+        index.clear();
+        strs.clear();
+        acked = in_flight = 0;
+    }
+    uint32_t ref(const std::string& s) {
+        auto it = index.find(s);
+        if (it != index.end()) return it->second;
+        const uint32_t id = (uint32_t)strs.size();
+        strs.push_back(s);
+        index.emplace(s, id);
+        return id;
+    }
+};
+
+static WireTxDict g_wire_tx;
+
+static void encode_update_wire(const PushState& ps, const PushState* base,
+    const PushOrders& orders, std::string& out) {
+    if (g_wire_tx.session == 0 || g_wire_tx.strs.size() > WIRE_TX_DICT_MAX)
+        g_wire_tx.restart();
+
+    // assign indices first so the definitions can go in front of the body
+    g_wire_tx.ref(ps.name);
+    g_wire_tx.ref(ps.account);
+    for (auto& pe : ps.entries) g_wire_tx.ref(pe.label);
+
+    out.clear();
+    WireWriter w{ out };
+    w.u8(WIRE_MAGIC);
+    w.u8(WIRE_VERSION);
+    w.u8(base ? WIRE_UPDATE_DELTA : WIRE_UPDATE_FULL);
+    w.str(g_room);
+    w.str(g_client_id);
+    w.varint(g_wire_tx.session);
+    w.varint(g_push_seq);
+    if (base) w.varint(g_push_acked);
+
+    w.varint(g_wire_tx.acked);
+    w.varint(g_wire_tx.strs.size() - g_wire_tx.acked);
+    for (size_t i = g_wire_tx.acked; i < g_wire_tx.strs.size(); ++i) w.str(g_wire_tx.strs[i]);
+    g_wire_tx.in_flight = (uint32_t)g_wire_tx.strs.size();
+
+    auto entry_fields = [&](const PushEntry& pe, uint8_t em) {
+        if (em & PE_LABEL) w.varint(g_wire_tx.ref(pe.label));
+        if (em & PE_READY) w.u8(pe.ready ? 1 : 0);
+        if (em & PE_LEFT) w.left(pe.left);
+        if (em & PE_SKILLID) w.varint(pe.skillid);
+        if (em & PE_READY_AT) w.varint((uint64_t)pe.ready_at);
+        };
+    auto account_ref = [&]() { return ps.account.empty() ? 0 : g_wire_tx.ref(ps.account) + 1; };
+    auto clock_fields = [&]() {
+        w.varint(ps.clock ? (uint64_t)ps.rtt_ms + 1 : 0);
+        w.svarint(ps.clock_offset_ms);
+        };
+
+    if (!base) {
+        w.str(PLUGIN_VER);
+        w.varint(g_wire_tx.ref(ps.name));
+        w.varint(ps.prof);
+        w.varint(ps.subgroup);
+        w.varint(ps.elite);
+        w.varint(account_ref());
+        clock_fields();
+        w.varint(ps.entries.size());
+        for (auto& pe : ps.entries) entry_fields(pe, PE_ALL);
+    }
+    else {
+        const uint8_t fm = push_field_mask(ps, *base);
+        w.u8(fm);
+        if (fm & PF_NAME) w.varint(g_wire_tx.ref(ps.name));
+        if (fm & PF_PROF) w.varint(ps.prof);
+        if (fm & PF_SUBGROUP) w.varint(ps.subgroup);
+        if (fm & PF_ELITE) w.varint(ps.elite);
+        if (fm & PF_ACCOUNT) w.varint(account_ref());
+        if (fm & PF_COUNT) w.varint(ps.entries.size());
+        if (fm & PF_CLOCK) clock_fields();
+
+        size_t n = 0;
+        uint8_t masks[PUSH_ENTRIES_MAX];
+        const size_t rows = std::min(ps.entries.size(), PUSH_ENTRIES_MAX);
+        for (size_t i = 0; i < rows; ++i) {
+            masks[i] = push_entry_mask(ps.entries[i], i < base->entries.size() ? &base->entries[i] : nullptr);
+            if (masks[i]) ++n;
+        }
+        w.varint(n);
+        for (size_t i = 0; i < rows; ++i) {
+            if (!masks[i]) continue;
+            w.varint(i);
+            w.u8(masks[i]);
+            entry_fields(ps.entries[i], masks[i]);
+        }
+    }
+
+    w.varint(orders.size());
+    for (auto& po : orders) {
+        w.varint(po.first);
+        w.varint(po.second.size());
+        for (auto& id : po.second) w.str(id);
+    }
+    // trailing and optional: relays that predate it stop reading before it
+    if (ps.sent_at) w.varint((uint64_t)ps.sent_at);
+}
+
+// ---- /aggregate (relay -> client) ----
+
+// Relay's room dictionary as far as we have received it; wire index -> NameId.
+// net thread only.
+// At most twice the relay's WIRE_ROOM_DICT_MAX; a longer dictionary means the
+// relay misbehaves, and it is dropped like a malformed reply.
+static constexpr size_t WIRE_RX_NAMES_MAX = 8192;
+
+struct WireRxDict {
+    uint64_t id = 0;
+    std::vector<std::string> names;
+};
+
+static WireRxDict g_wire_rx;
+
+// Decodes outside g_mutex; on failure the dictionary is dropped so the next
+// request asks for everything again.
+static bool decode_aggregate_wire(const std::string& body, std::vector<Peer>& peers,
+    PushOrders& orders, bool& has_orders, AggregateMeta& meta) {
+    WireReader r{ (const uint8_t*)body.data(), (const uint8_t*)body.data() + body.size() };
+    if (r.u8() != WIRE_MAGIC) return false;
+    const uint8_t version = r.u8();
+    if (version < 1 || version > WIRE_VERSION || r.u8() != WIRE_AGGREGATE) return false;
+
+    const uint64_t dict_id = r.varint();
+    const uint64_t first = r.varint();
+    const uint64_t ndefs = r.varint();
+    if (!r.ok) return false;
+    if (dict_id != g_wire_rx.id) {
+        g_wire_rx.id = dict_id;
+        g_wire_rx.names.clear();
+    }
+    if (first > g_wire_rx.names.size() || ndefs > WIRE_RX_NAMES_MAX - first) {
+        g_wire_rx = WireRxDict{};
+        return false;
+    }
+    g_wire_rx.names.resize((size_t)first);
+    for (uint64_t i = 0; i < ndefs && r.ok; ++i)
+        g_wire_rx.names.emplace_back(r.str());
+
+    static const std::string none;
+    auto name_ref = [&](uint64_t idx) -> const std::string& {
+        if (idx >= g_wire_rx.names.size()) {
+            r.ok = false;
+            return none;
+        }
+        return g_wire_rx.names[(size_t)idx];
+        };
+    auto opt_ref = [&]() -> const std::string& {
+        const uint64_t v = r.varint();
+        return v == 0 ? none : name_ref(v - 1);
+        };
+
+    r.str();   // room
+    meta.epoch = r.varint();
+    meta.version = r.varint();
+    meta.partial = r.u8() != 0;
+    meta.left.clear();
+    if (meta.partial) {
+        const uint64_t n = r.varint();
+        for (uint64_t i = 0; i < n && r.ok; ++i) meta.left.emplace_back(r.str());
+    }
+
+    const uint64_t norders = r.varint();
+    has_orders = norders > 0;
+    orders.clear();
+    for (uint64_t i = 0; i < norders && r.ok; ++i) {
+        const uint32_t prof = (uint32_t)r.varint();
+        const uint64_t m = r.varint();
+        std::vector<std::string> ids;
+        for (uint64_t k = 0; k < m && r.ok; ++k) ids.emplace_back(r.str());
+        orders.emplace_back(prof, std::move(ids));
+    }
+
+    const uint64_t npeers = r.varint();
+    peers.clear();
+    for (uint64_t i = 0; i < npeers && r.ok; ++i) {
+        Peer p;
+        p.id = r.str();
+        p.name = name_ref(r.varint());
+        p.account = opt_ref();
+        opt_ref();   // pluginVer
+        p.prof = (uint32_t)r.varint();
+        p.subgroup = (uint32_t)r.varint();
+        p.elite = (uint32_t)r.varint();
+        if (version >= 2) {
+            const uint64_t rtt = r.varint();
+            p.clock_offset_ms = (int32_t)r.svarint();
+            p.clock_known = rtt != 0;
+            p.rtt_ms = rtt ? (uint32_t)(rtt - 1) : 0;
+        }
+
+        const uint64_t m = r.varint();
+        for (uint64_t k = 0; k < m && r.ok; ++k) {
+            PeerEntry e;
+            e.label = name_ref(r.varint());
+            e.ready = r.u8() != 0;
+            e.left = r.left();
+            r.varint();   // skillid
+            if (version >= 2) e.ready_at = (int64_t)r.varint();
+            p.entries.push_back(std::move(e));
+        }
+        if (p.name.empty()) p.name = "unknown";
+        if (!p.id.empty()) peers.push_back(std::move(p));
+    }
+
+    if (!r.ok) g_wire_rx = WireRxDict{};
+    return r.ok;
+}
+
+static void apply_group_orders_locked(PushOrders& orders) {
+    g_group_order.clear();
+    for (auto& po : orders) g_group_order[po.first] = std::move(po.second);
+}
+
+// -------------------- /aggregate JSON decoding --------------------
+//
+// JSON room replies (/aggregate without the binary wire, and the room
+// stream's snapshot) go through nlohmann's SAX interface straight into Peer
+// records: no DOM, and the caller's vector is refilled in place, so the id,
+// name and entry storage of the previous reply is reused. Same shapes as
+// ever: "peers" as an array or as an object keyed by clientId, else
+// "clients", a bare array, or "rooms": { <room>: [...] }.
+
+class RoomReplySax {
+public:
+    RoomReplySax(const std::string& room, std::vector<Peer>& peers, PushOrders& orders,
+        bool& has_orders, AggregateMeta& meta)
+        : room_(room), peers_(peers), orders_(orders), has_orders_(has_orders), meta_(meta) {}
+
+    size_t count() const { return n_; }
+    size_t error_at = 0;
+    std::string error;
+
+    bool null() { return true; }
+    bool boolean(bool v) {
+        if (top() == F_ENTRY && key_ == K_READY) peers_[n_].entries.back().ready = v;
+        return true;
+    }
+    bool number_integer(json::number_integer_t v) { return number((double)v); }
+    bool number_unsigned(json::number_unsigned_t v) { return number((double)v); }
+    bool number_float(json::number_float_t v, const json::string_t&) { return number(v); }
+    bool binary(json::binary_t&) { return true; }
+
+    bool string(json::string_t& v) {
+        switch (top()) {
+        case F_PEER: {
+            Peer& p = peers_[n_];
+            if (key_ == K_CLIENT_ID && !id_locked_) {
+                p.id.assign(v);
+                id_locked_ = true;   // clientId wins over the legacy "id"
+            }
+            else if (key_ == K_ID && !id_locked_) p.id.assign(v);
+            else if (key_ == K_NAME) {
+                p.name.assign(v);
+                name_set_ = true;
+            }
+            else if (key_ == K_ACCOUNT) p.account.assign(v);
+            break;
+        }
+        case F_ENTRY:
+            if (key_ == K_LABEL) peers_[n_].entries.back().label.assign(v);
+            break;
+        case F_ORDER: orders_.back().second.emplace_back(v); break;
+        case F_LEFT: meta_.left.emplace_back(v); break;
+        default: break;
+        }
+        return true;
+    }
+
+    bool key(json::string_t& k) {
+        key_ = K_OTHER;
+        switch (top()) {
+        case F_ROOT:
+            if (k == "peers") {
+                key_ = K_PEERS;
+                take(RANK_PEERS);   // even when it isn't a list, as before
+            }
+            else if (k == "clients") key_ = K_CLIENTS;
+            else if (k == "rooms") key_ = K_ROOMS;
+            else if (k == "groupOrder") key_ = K_GROUP_ORDER;
+            else if (k == "left") key_ = K_LEFT;
+            else if (k == "epoch") key_ = K_EPOCH;
+            else if (k == "version") key_ = K_VERSION;
+            else if (k == "since") meta_.partial = true;
+            break;
+        case F_PEER:
+            if (k == "clientId") key_ = K_CLIENT_ID;
+            else if (k == "id") key_ = K_ID;
+            else if (k == "name") key_ = K_NAME;
+            else if (k == "account") key_ = K_ACCOUNT;
+            else if (k == "prof") key_ = K_PROF;
+            else if (k == "elite") key_ = K_ELITE;
+            else if (k == "subgroup") key_ = K_SUBGROUP;
+            else if (k == "rtt") key_ = K_RTT;
+            else if (k == "clockOffset") key_ = K_CLOCK_OFFSET;
+            else if (k == "entries") key_ = K_ENTRIES;
+            break;
+        case F_ENTRY:
+            if (k == "label") key_ = K_LABEL;
+            else if (k == "ready") key_ = K_READY;
+            else if (k == "left") key_ = K_LEFT;
+            else if (k == "readyAt") key_ = K_READY_AT;
+            break;
+        case F_PEER_MAP:
+            map_id_.assign(k);
+            break;
+        case F_ROOMS:
+            if (k == room_) key_ = K_THIS_ROOM;
+            break;
+        case F_ORDERS: {
+            char* end = nullptr;
+            order_prof_ = (uint32_t)std::strtoul(k.c_str(), &end, 10);
+            if (!k.empty() && *end == '\0') key_ = K_PROF;
+            break;
+        }
+        default: break;
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        Frame f = F_SKIP;
+        switch (top()) {
+        case F_NONE: f = F_ROOT; break;
+        case F_ROOT:
+            if (key_ == K_PEERS) f = F_PEER_MAP;
+            else if (key_ == K_ROOMS && take(RANK_ROOMS)) f = F_ROOMS;
+            else if (key_ == K_GROUP_ORDER) {
+                has_orders_ = true;
+                orders_.clear();
+                f = F_ORDERS;
+            }
+            break;
+        case F_PEER_LIST:
+            begin_peer();
+            f = F_PEER;
+            break;
+        case F_PEER_MAP:
+            begin_peer();
+            peers_[n_].id.assign(map_id_);
+            id_locked_ = true;
+            f = F_PEER;
+            break;
+        case F_ENTRIES:
+            peers_[n_].entries.emplace_back();
+            f = F_ENTRY;
+            break;
+        default: break;
+        }
+        stack_.push_back(f);
+        return true;
+    }
+
+    bool end_object() {
+        if (top() == F_PEER) end_peer();
+        stack_.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t) {
+        Frame f = F_SKIP;
+        switch (top()) {
+        case F_NONE:
+            take(RANK_PEERS);
+            f = F_PEER_LIST;
+            break;
+        case F_ROOT:
+            if (key_ == K_PEERS || (key_ == K_CLIENTS && take(RANK_CLIENTS))) f = F_PEER_LIST;
+            else if (key_ == K_LEFT) {
+                meta_.left.clear();
+                f = F_LEFT;
+            }
+            break;
+        case F_ROOMS:
+            if (key_ == K_THIS_ROOM && take(RANK_ROOMS)) f = F_PEER_LIST;
+            break;
+        case F_PEER:
+            if (key_ == K_ENTRIES) {
+                peers_[n_].entries.clear();
+                f = F_ENTRIES;
+            }
+            break;
+        case F_ORDERS:
+            if (key_ == K_PROF) {
+                orders_.emplace_back(order_prof_, std::vector<std::string>{});
+                f = F_ORDER;
+            }
+            break;
+        default: break;
+        }
+        stack_.push_back(f);
+        return true;
     }
 
-    // ---- SQUAD MEMBERSHIP TRACKING ----
-    {
-        std::scoped_lock lk(g_mutex);
-        g_in_map_change = false;
-
-        auto record_member = [&](ag* a) {
-            if (!a || !a->name || !*a->name) return;
-            if (a->team != 0) {
-                g_squad_accounts.insert(a->name);
-            }
-            };
-        record_member(src);
-        record_member(dst);
+    bool end_array() {
+        stack_.pop_back();
+        return true;
     }
 
-    g_last_ev_ms = ev->time;
-    const double now = now_s();
-
-    // ---- DOWN / DEAD / UP TRACKING (for greying + self boon clear) ----
-    if (ev->is_statechange == CBTS_CHANGEDOWN ||
-        ev->is_statechange == CBTS_CHANGEDEAD ||
-        ev->is_statechange == CBTS_CHANGEUP) {
+    bool parse_error(std::size_t pos, const std::string&, const json::exception& e) {
+        error_at = pos;
+        error = e.what();
+        return false;
+    }
 
-        std::scoped_lock lk(g_mutex);
+private:
+    enum Frame : uint8_t {
+        F_NONE, F_SKIP,   // F_SKIP: a value we don't use, and everything in it
+        F_ROOT, F_PEER_LIST, F_PEER_MAP, F_PEER, F_ENTRIES, F_ENTRY,
+        F_ORDERS, F_ORDER, F_LEFT, F_ROOMS,
+    };
+    enum Key : uint8_t {
+        K_OTHER,
+        K_PEERS, K_CLIENTS, K_ROOMS, K_THIS_ROOM, K_GROUP_ORDER, K_EPOCH, K_VERSION,
+        K_CLIENT_ID, K_ID, K_NAME, K_ACCOUNT, K_PROF, K_ELITE, K_SUBGROUP, K_RTT,
+        K_CLOCK_OFFSET, K_ENTRIES, K_LABEL, K_READY, K_LEFT, K_READY_AT,
+    };
+    // where the peer list comes from when a reply has several; higher wins
+    enum Rank : uint8_t { RANK_NONE, RANK_ROOMS, RANK_CLIENTS, RANK_PEERS };
 
-        // Arc usually puts the changing agent in src, but fall back to dst just in case.
-        ag* a = src ? src : dst;
-        if (a && a->name && *a->name) {
-            const std::string key = a->name;
+    Frame top() const { return stack_.empty() ? F_NONE : stack_.back(); }
 
-            if (ev->is_statechange == CBTS_CHANGEDOWN ||
-                ev->is_statechange == CBTS_CHANGEDEAD) {
-                // Mark as down/dead for UI grey-out
-                g_dead_accounts.insert(key);
+    // Starts collecting from a source of rank `r`, dropping what a lower one gave.
+    bool take(Rank r) {
+        if (r < rank_) return false;
+        rank_ = r;
+        n_ = 0;
+        return true;
+    }
 
-                // If it's us, finalize timers under old boon state and clear boons
-                if (a->self) {
-                    advance_all_timers_locked(now);
-                    g_self.has_alacrity = false;
-                    g_self.has_chill = false;
-                    g_alac_until_s = 0.0;
-                    g_chill_until_s = 0.0;
-                }
-            }
-            else if (ev->is_statechange == CBTS_CHANGEUP) {
-                // Back up -> remove from dead set
-                g_dead_accounts.erase(key);
+    bool number(double v) {
+        switch (top()) {
+        case F_PEER: {
+            Peer& p = peers_[n_];
+            if (key_ == K_PROF) p.prof = clamp_number<uint32_t>(v);
+            else if (key_ == K_ELITE) p.elite = clamp_number<uint32_t>(v);
+            else if (key_ == K_SUBGROUP) p.subgroup = clamp_number<uint32_t>(v);
+            else if (key_ == K_RTT) {
+                p.clock_known = true;
+                p.rtt_ms = clamp_number<uint32_t>(v);
             }
+            else if (key_ == K_CLOCK_OFFSET) p.clock_offset_ms = clamp_number<int32_t>(v);
+            break;
+        }
+        case F_ENTRY: {
+            PeerEntry& e = peers_[n_].entries.back();
+            if (key_ == K_LEFT) e.left = clamp_number<float>(v);
+            else if (key_ == K_READY_AT) e.ready_at = clamp_number<int64_t>(v);
+            break;
         }
+        case F_ROOT:
+            if (key_ == K_EPOCH) meta_.epoch = clamp_number<uint64_t>(v);
+            else if (key_ == K_VERSION) meta_.version = clamp_number<uint64_t>(v);
+            break;
+        default: break;
+        }
+        return true;
     }
 
-    // ---- CLEAR ALAC/CHILL ON EXITCOMBAT / LOGEND ----
-    if ((ev->is_statechange == CBTS_EXITCOMBAT ||
-        ev->is_statechange == CBTS_LOGEND) &&
-        dst && dst->self) {
+    // Resets the next slot; a record left over from an earlier reply keeps
+    // its string and entry capacity.
+    void begin_peer() {
+        if (n_ == peers_.size()) peers_.emplace_back();
+        Peer& p = peers_[n_];
+        p.id.clear();
+        p.name.clear();
+        p.account.clear();
+        p.prof = p.elite = p.subgroup = 0;
+        p.entries.clear();
+        p.clock_known = false;
+        p.rtt_ms = 0;
+        p.clock_offset_ms = 0;
+        id_locked_ = false;
+        name_set_ = false;
+    }
 
-        std::scoped_lock lk(g_mutex);
+    void end_peer() {
+        Peer& p = peers_[n_];
+        if (!name_set_) p.name = "unknown";
+        if (!p.id.empty()) ++n_;
+    }
 
-        // Apply old boon state up to 'now'
-        advance_all_timers_locked(now);
+    const std::string& room_;
+    std::vector<Peer>& peers_;
+    PushOrders& orders_;
+    bool& has_orders_;
+    AggregateMeta& meta_;
+
+    std::vector<Frame> stack_;
+    Key key_ = K_OTHER;
+    Rank rank_ = RANK_NONE;
+    size_t n_ = 0;               // peers_[0, n_) are complete
+    bool id_locked_ = false;
+    bool name_set_ = false;
+    std::string map_id_;
+    uint32_t order_prof_ = 0;
+};
 
-        g_self.has_alacrity = false;
-        g_self.has_chill = false;
-        g_alac_until_s = 0.0;
-        g_chill_until_s = 0.0;
+// Decodes outside g_mutex, like decode_aggregate_wire. `room` picks the
+// entry of the legacy "rooms" shape.
+static bool decode_aggregate_json(const std::string& body, const std::string& room,
+    std::vector<Peer>& peers, PushOrders& orders, bool& has_orders, AggregateMeta& meta) {
+    meta.epoch = meta.version = 0;
+    meta.partial = false;
+    meta.left.clear();
+    has_orders = false;
+
+    RoomReplySax sax(room, peers, orders, has_orders, meta);
+    if (!json::sax_parse(body, &sax)) {
+        char buf[256];
+        std::snprintf(buf, sizeof(buf), "[sqcd] room JSON error at byte %zu: %s",
+            sax.error_at, sax.error.c_str());
+        arc_log(buf);
+        return false;
+    }
+    peers.resize(sax.count());
+    if (meta.epoch == 0) meta.version = 0;   // versions mean nothing without an epoch
+    return true;
+}
 
+// Publishes a decoded room reply. A full list becomes the next snapshot as
+// is, and `peers` gets the records of a reclaimed one back for the next
+// decode to refill; a partial one (the relay's incremental /aggregate) is
+// applied on top of a copy of the current list. g_mutex is held only to
+// settle the result, timed into `stats` unless it is null.
+static void apply_room_reply(std::vector<Peer>& peers, PushOrders& orders,
+    bool has_orders, const AggregateMeta& meta, EndpointStats* stats) {
+    std::scoped_lock pk(g_peers_mutex);
+    PeerSnapshot* next = next_peer_snapshot(meta.partial);
+    if (meta.partial) apply_partial_peers(next->peers, peers, meta.left);
+    else next->peers.swap(peers);
+    {
+        std::scoped_lock lk(g_mutex);
+        NetScope held(stats, NP_LOCK);
+        if (has_orders) apply_group_orders_locked(orders);
+        settle_peers_locked(next->peers);
     }
+    publish_peer_snapshot(next);
+}
 
-    // ---- TRACK ALAC / CHILL BUFFS ----
-    if (ev->is_statechange == CBTS_NONE &&
-        dst && dst->self &&
-        (ev->skillid == BUFF_ALACRITY || ev->skillid == BUFF_CHILL)) {
+// ---- decode benchmark ----
+//
+// The net thread keeps a few full JSON replies as they come in (one every
+// DECODE_SAMPLE_EVERY_S, DECODE_SAMPLES at most). "Benchmark" in the options
+// runs them through decode_aggregate_json and through the DOM path it
+// replaced, json::parse plus parse_peer_json per peer, DECODE_BENCH_ROUNDS
+// times each, on a thread of its own so pushes and pulls keep their pace.
+
+static constexpr int DECODE_SAMPLES = 8;
+static constexpr double DECODE_SAMPLE_EVERY_S = 5.0;
+static constexpr int DECODE_BENCH_ROUNDS = 50;
+
+struct DecodeBenchReport {
+    bool running = false;
+    size_t replies = 0;
+    double peers = 0.0;      // per reply
+    double sax_us = 0.0;     // per reply
+    double dom_us = 0.0;
+    size_t mismatches = 0;   // replies the two paths disagreed on
+};
 
-        std::scoped_lock lk(g_mutex);
+static std::thread g_decode_bench_thread;
+static std::mutex g_decode_bench_mutex;
+static DecodeBenchReport g_decode_bench;   // g_decode_bench_mutex
+static std::vector<std::string> g_decode_samples;   // g_decode_bench_mutex
+static std::atomic<uint32_t> g_decode_sample_count{ 0 };
 
-        // First advance using *previous* boon state
-        advance_all_timers_locked(now);
+// net thread only
+static size_t g_decode_sample_next = 0;
+static double g_decode_sample_s = -1e9;
 
-        // Many buff events have duration in ms in ev->value, but not all.
-        double dur_s = 0.0;
-        if (ev->value > 0) {
-            dur_s = (double)ev->value / 1000.0;
+static void keep_decode_sample(const std::string& body) {
+    const double now = now_s();
+    if (now - g_decode_sample_s < DECODE_SAMPLE_EVERY_S) return;
+    g_decode_sample_s = now;
+    std::lock_guard<std::mutex> lk(g_decode_bench_mutex);
+    if (g_decode_samples.size() < DECODE_SAMPLES) g_decode_samples.push_back(body);
+    else g_decode_samples[g_decode_sample_next] = body;
+    g_decode_sample_next = (g_decode_sample_next + 1) % DECODE_SAMPLES;
+    g_decode_sample_count.store((uint32_t)g_decode_samples.size(), std::memory_order_relaxed);
+}
+
+// The old path for the relay's own shapes: "peers" as an array or object.
+static void dom_decode_peers(const std::string& body, std::vector<Peer>& peers) {
+    peers.clear();
+    json jr = json::parse(body);
+    if (!jr.is_object() || !jr.contains("peers")) return;
+    const json& px = jr["peers"];
+    if (px.is_array()) {
+        for (auto& pj : px) {
+            Peer p;
+            if (parse_peer_json(pj, p)) peers.push_back(std::move(p));
+        }
+    }
+    else if (px.is_object()) {
+        for (auto& kv : px.items()) {
+            json pj = kv.value();
+            pj["clientId"] = kv.key();
+            Peer p;
+            if (parse_peer_json(pj, p)) peers.push_back(std::move(p));
         }
+    }
+}
 
-        if (ev->skillid == BUFF_ALACRITY) {
-            if (ev->is_buffremove == 0) {
-                // Alacrity applied / refreshed
-                g_self.has_alacrity = true;
+static bool same_peer(const Peer& a, const Peer& b) {
+    if (a.id != b.id || a.name != b.name || a.account != b.account || a.prof != b.prof ||
+        a.elite != b.elite || a.subgroup != b.subgroup || a.clock_known != b.clock_known ||
+        a.rtt_ms != b.rtt_ms || a.clock_offset_ms != b.clock_offset_ms ||
+        a.entries.size() != b.entries.size())
+        return false;
+    for (size_t k = 0; k < a.entries.size(); ++k) {
+        const PeerEntry& x = a.entries[k];
+        const PeerEntry& y = b.entries[k];
+        if (x.label != y.label || x.ready != y.ready || x.left != y.left || x.ready_at != y.ready_at)
+            return false;
+    }
+    return true;
+}
 
-                // If we got a duration, remember it; otherwise 0 means “unknown”
-                if (dur_s > 0.0) {
-                    g_alac_until_s = now + dur_s;
-                }
-                else {
-                    g_alac_until_s = 0.0; // rely on explicit buffremove/exitcombat/down
-                }
-            }
-            else {
-                // Alacrity removed / strips / full clear
-                g_self.has_alacrity = false;
-                g_alac_until_s = 0.0;
+static void decode_bench_worker(std::string room) {
+    using clock = std::chrono::steady_clock;
+    std::vector<std::string> samples;
+    {
+        std::lock_guard<std::mutex> lk(g_decode_bench_mutex);
+        samples = g_decode_samples;
+    }
+    DecodeBenchReport rep;
+    rep.replies = samples.size();
+    if (rep.replies) {
+        std::vector<Peer> sax_peers, dom_peers;
+        PushOrders orders;
+        bool has_orders = false;
+        AggregateMeta meta;
+        size_t peer_total = 0;
+
+        const auto t0 = clock::now();
+        for (int r = 0; r < DECODE_BENCH_ROUNDS; ++r)
+            for (auto& body : samples) {
+                decode_aggregate_json(body, room, sax_peers, orders, has_orders, meta);
+                peer_total += sax_peers.size();
             }
+        const auto t1 = clock::now();
+        try {
+            for (int r = 0; r < DECODE_BENCH_ROUNDS; ++r)
+                for (auto& body : samples) dom_decode_peers(body, dom_peers);
         }
-        else { // BUFF_CHILL
-            if (ev->is_buffremove == 0) {
-                // Chill applied / refreshed
-                g_self.has_chill = true;
+        catch (const std::exception&) {}
+        const auto t2 = clock::now();
 
-                // Chill is usually short. If the event has no duration, fall back to a
-                // small timeout so it can NEVER get stuck “on”.
-                if (dur_s <= 0.0) {
-                    dur_s = 3.0; // conservative fallback, tweak if you want
-                }
-                g_chill_until_s = now + dur_s;
+        for (auto& body : samples) {
+            decode_aggregate_json(body, room, sax_peers, orders, has_orders, meta);
+            try {
+                dom_decode_peers(body, dom_peers);
             }
-            else {
-                // Chill removed / expired / cleansed
-                g_self.has_chill = false;
-                g_chill_until_s = 0.0;
+            catch (const std::exception&) {
+                dom_peers.clear();
             }
+            bool same = sax_peers.size() == dom_peers.size();
+            for (size_t i = 0; same && i < sax_peers.size(); ++i) same = same_peer(sax_peers[i], dom_peers[i]);
+            if (!same) ++rep.mismatches;
         }
-    }
-
-    // --------------------------------------------------------------------
-    // From here down: your existing self/pick/cooldown logic unchanged
-    // --------------------------------------------------------------------
 
-    const bool is_self = ((src && src->self) || (dst && dst->self));
-    bool picked = false;
+        const double runs = (double)DECODE_BENCH_ROUNDS * (double)rep.replies;
+        rep.peers = peer_total / runs;
+        rep.sax_us = std::chrono::duration<double, std::micro>(t1 - t0).count() / runs;
+        rep.dom_us = std::chrono::duration<double, std::micro>(t2 - t1).count() / runs;
+    }
+    std::lock_guard<std::mutex> lk(g_decode_bench_mutex);
+    g_decode_bench = rep;
+}
 
-    if (is_self) {
-        std::unique_lock<std::mutex> lk(g_mutex);
+static void start_decode_bench() {
+    {
+        std::lock_guard<std::mutex> lk(g_decode_bench_mutex);
+        if (g_decode_bench.running) return;
+        g_decode_bench.running = true;
+    }
+    if (g_decode_bench_thread.joinable()) g_decode_bench_thread.join();   // previous run is done
+    g_decode_bench_thread = std::thread(decode_bench_worker, g_room);
+}
 
-        // Keep subgroup up to date
-        uint32_t team_src = (src ? src->team : 0);
-        uint32_t team_dst = (dst ? dst->team : 0);
-        uint32_t new_team = team_src ? team_src : team_dst;
-        if (new_team != 0) {
-            g_self.subgroup = new_team;
+// -------------------- room push channel --------------------
+
+// The relay streams room changes as Server-Sent Events on GET /events: a
+// "snapshot" (same body as /aggregate) on connect, then "peer", "leave" and
+// "order" events as /update calls arrive, each published as a new peer snapshot. While the channel is live net_loop
+// stops polling /aggregate; when it drops, polling resumes until it is back.
+
+static constexpr int ROOM_STREAM_RETRY_MS = 3000;
+static constexpr int ROOM_STREAM_UNSUPPORTED_RETRY_MS = 60000;  // relay without /events
+
+static std::thread g_stream_thread;
+static std::atomic<bool> g_room_stream_live{ false };
+static std::atomic<uint64_t> g_room_stream_events{ 0 };
+static std::atomic<uint64_t> g_room_stream_connects{ 0 };
+
+// Incremental text/event-stream parser; calls on_event(event, data) once per
+// dispatched event. Comment lines (the relay's keep-alive pings) are skipped.
+struct SseParser {
+    std::string line, event, data;
+
+    template <class F>
+    void feed(const char* p, size_t n, F&& on_event) {
+        for (size_t i = 0; i < n; ++i) {
+            const char ch = p[i];
+            if (ch == '\r') continue;
+            if (ch != '\n') {
+                line.push_back(ch);
+                continue;
+            }
+            if (line.empty()) {
+                if (!data.empty()) on_event(event.empty() ? std::string("message") : event, data);
+                event.clear();
+                data.clear();
+            }
+            else if (line[0] != ':') {
+                const size_t colon = line.find(':');
+                std::string_view field(line.data(), colon == std::string::npos ? line.size() : colon);
+                std::string_view value;
+                if (colon != std::string::npos) {
+                    value = std::string_view(line).substr(colon + 1);
+                    if (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+                }
+                if (field == "event") event.assign(value);
+                else if (field == "data") {
+                    if (!data.empty()) data.push_back('\n');
+                    data.append(value);
+                }
+            }
+            line.clear();
         }
+    }
+};
 
-        // ---- PICK MODE (Add tracked skill) ----
-        if (g_pick_row >= 0 && g_pick_row < (int)g_tracked.size()) {
-            if (now <= g_pick_armed_until_s) {
-                if (ev->skillid != 0 &&
-                    ev->is_buff == 0 &&
-                    ev->time > g_pick_not_before_ms &&
-                    !is_probable_junk_name(skillname)) {
-
-                    auto& row = g_tracked[g_pick_row];
+// Applies one pushed event other than "snapshot". Peer changes publish a new
+// snapshot; an order change only touches the group orders.
+static void apply_room_event(const std::string& event, const json& jd) {
+    PushOrders orders;
+    Peer p;
+    std::string left;
+    if (event == "peer") {
+        if (!parse_peer_json(jd, p)) return;
+        if (jd.contains("sentAt") && jd["sentAt"].is_number_integer())
+            note_fanout(g_fanout_sse, jd["sentAt"].get<int64_t>());
+    }
+    else if (event == "leave") {
+        if (!jd.is_object() || !jd.contains("clientId") || !jd["clientId"].is_string()) return;
+        left = jd["clientId"].get<std::string>();
+    }
+    else if (event == "order") {
+        if (!jd.is_object()) return;
+        for (auto& kv : jd.items()) {
+            if (!kv.value().is_array()) continue;
+            std::vector<std::string> ids;
+            for (auto& v : kv.value())
+                if (v.is_string()) ids.push_back(v.get<std::string>());
+            orders.emplace_back((uint32_t)std::strtoul(kv.key().c_str(), nullptr, 10), std::move(ids));
+        }
+    }
+    else {
+        return;
+    }
 
-                    row.skillid = ev->skillid;
-                    row.label = (skillname && *skillname)
-                        ? std::string(skillname)
-                        : ("skill " + std::to_string(ev->skillid));
+    std::scoped_lock pk(g_peers_mutex);
+    if (event == "order") {
+        const PeerSnapshot* cur = g_peer_snap.load();
+        std::scoped_lock lk(g_mutex);
+        apply_group_orders_locked(orders);
+        if (cur) ensure_group_membership_locked(cur->peers);
+        return;
+    }
 
-                    auto itH = g_hard_override_cd.find(ev->skillid);
-                    if (itH != g_hard_override_cd.end())
-                        row.base_cd = itH->second;
+    PeerSnapshot* next = next_peer_snapshot(true);
+    if (event == "peer") upsert_peer(next->peers, std::move(p));
+    else remove_peer(next->peers, left);
+    {
+        std::scoped_lock lk(g_mutex);
+        settle_peers_locked(next->peers);
+    }
+    publish_peer_snapshot(next);
+}
 
-                    g_pick_row = -1;
-                    g_pick_armed_until_s = 0.0;
-                    picked = true;
-                }
-            }
-            else {
-                g_pick_row = -1;
-                g_pick_armed_until_s = 0.0;
-            }
+static void room_stream_loop() {
+    std::vector<Peer> snap_peers;   // reused by every snapshot
+    PushOrders snap_orders;
+    while (g_net_alive) {
+        if (relay_paused()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
         }
+        const std::string room = g_room;
+        const std::wstring path = L"/events?room=" + std::wstring(room.begin(), room.end());
+        SseParser sse;
+        g_room_stream_connects.fetch_add(1, std::memory_order_relaxed);
+
+        const bool opened = transport_for(g_use_https).stream(
+            g_server_host, g_server_port, g_use_https, path,
+            [&](const char* d, size_t n) {
+                sse.feed(d, n, [&](const std::string& ev, const std::string& data) {
+                    if (ev == "snapshot") {
+                        // same body as /aggregate
+                        bool has_orders = false;
+                        AggregateMeta meta;
+                        if (!decode_aggregate_json(data, room, snap_peers, snap_orders, has_orders, meta))
+                            return;
+                        apply_room_reply(snap_peers, snap_orders, has_orders, meta, nullptr);
+                    }
+                    else {
+                        try {
+                            apply_room_event(ev, json::parse(data));
+                        }
+                        catch (const std::exception& e) {
+                            char buf[256];
+                            std::snprintf(buf, sizeof(buf),
+                                "[sqcd] room event JSON error: %s", e.what());
+                            arc_log(buf);
+                            return;
+                        }
+                    }
+                    if (ev == "snapshot") g_room_stream_live = true;
+                    g_room_stream_events.fetch_add(1, std::memory_order_relaxed);
+                    });
+                return g_net_alive;
+            });
+        g_room_stream_live = false;
 
-        // ---- COOLDOWN LOGIC WITH ACTIVATION GUARD ----
-        if (ev->skillid != 0 &&
-            ev->is_buff == 0 &&
-            !is_probable_junk_name(skillname)) {
+        // polling covers the gap until the next attempt
+        const int wait_ms = opened ? ROOM_STREAM_RETRY_MS : ROOM_STREAM_UNSUPPORTED_RETRY_MS;
+        for (int waited = 0; waited < wait_ms && g_net_alive; waited += 50)
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
 
-            const uint32_t sid = ev->skillid;
+// -------------------- room datagrams --------------------
+//
+// Optional UDP path for the per-tick state (setting "udp"). Each push goes out
+// as one self-contained datagram: the whole PushState with strings inline, no
+// dictionary and no deltas, so any datagram may be lost or arrive late without
+// spoiling the next one. The relay fans each peer change out to the room's UDP
+// members the same way. What has to arrive stays on HTTP: the join (POST
+// /udp/join hands out the token that authenticates our datagrams), group
+// orders, and /aggregate pulls at the idle rate, which pick up leaves and
+// anything lost. The relay only takes the token from the address that
+// joined, and only talks to an address:port that echoed its challenge: our
+// first ping gets a challenge, the confirm we send back makes the socket our
+// address, and pongs and room datagrams follow. It drops datagrams it can't
+// place without answering, so a forgotten token looks like silence:
+// UDP_SILENCE_MS without a datagram sends pushes back to HTTP until the next
+// join.
+//
+// Layouts, after the binary wire header (u8 'Q', u8 version >= 2, u8 kind):
+//   state   varint token, varint seq, str pluginVer, str name, str account,
+//           varint prof, subgroup, elite, clock, varint n, n x entry,
+//           [varint sentAt]
+//   room    varint epoch, varint n, n x (str clientId, varint peer version,
+//           str name, str account, varint prof, subgroup, elite, clock,
+//           varint m, m x entry), [n x varint sentAt (0 = none)]
+//
+// sentAt (relay ms when the state was pushed) trails the rest so either side
+// may leave it out and older readers stop before it.
+//   entry   str label, u8 ready, left, varint skillid, varint readyAt
+//   ping    varint token, varint stamp (us)     pong: varint stamp
+//   challenge  varint cookie        confirm: varint token, varint cookie
+
+static constexpr uint8_t WIRE_DGRAM_STATE = 3;
+static constexpr uint8_t WIRE_DGRAM_ROOM = 4;
+static constexpr uint8_t WIRE_DGRAM_PING = 5;
+static constexpr uint8_t WIRE_DGRAM_PONG = 6;
+static constexpr uint8_t WIRE_DGRAM_CHALLENGE = 8;
+static constexpr uint8_t WIRE_DGRAM_CONFIRM = 9;
+static constexpr size_t UDP_MAX_DATAGRAM = 1200;   // fits any path MTU unfragmented
+static constexpr int UDP_PING_MS = 1000;
+static constexpr int UDP_SILENCE_MS = 5000;
+static constexpr int UDP_RETRY_MS = 5000;
+static constexpr int UDP_UNSUPPORTED_RETRY_MS = 60000;  // relay without /udp/join
+static constexpr int UDP_RECV_TIMEOUT_MS = 100;
+
+static std::thread g_udp_thread;
+static std::mutex g_udp_send_mutex;   // guards the two below for senders
+static sock_t g_udp_sock = BAD_SOCK;
+static uint64_t g_udp_token = 0;
+static std::atomic<bool> g_udp_live{ false };   // joined and the relay answers
+static std::atomic<const char*> g_udp_status{ "off" };
+
+// shown in the options window. The two round trips are a ping echo and a
+// POST /update with its reply; the time a change takes to reach peers is
+// g_fanout_udp / g_fanout_sse
+static std::atomic<uint64_t> g_udp_sent{ 0 };
+static std::atomic<uint64_t> g_udp_received{ 0 };
+static std::atomic<uint64_t> g_udp_dropped{ 0 };   // malformed or stale
+static std::atomic<uint64_t> g_udp_joins{ 0 };
+static std::atomic<double> g_udp_rtt_ms{ 0.0 };     // smoothed ping round trip
+static std::atomic<double> g_udp_rtt_min_ms{ 0.0 };
+static std::atomic<double> g_http_push_ms{ 0.0 };   // smoothed POST /update round trip
+
+static void dgram_header(WireWriter& w, uint8_t kind) {
+    w.u8(WIRE_MAGIC);
+    w.u8(WIRE_VERSION);
+    w.u8(kind);
+}
 
-            switch (ev->is_activation) {
-            case ACTV_START:
-            case ACTV_CANCEL_FIRE:
-                // Real cast -> full cooldown
-            {
-                SlotTimer& st = g_by_skill[sid];
-                st.skillid = sid;
-                st.name = (skillname && *skillname)
-                    ? skillname
-                    : (std::string("skill ") + std::to_string(sid));
-                st.on_cast(now);
-            }
-            break;
+// False when the state doesn't fit in one datagram.
+static bool encode_state_datagram(const PushState& ps, uint64_t token, uint64_t seq, std::string& out) {
+    out.clear();
+    WireWriter w{ out };
+    dgram_header(w, WIRE_DGRAM_STATE);
+    w.varint(token);
+    w.varint(seq);
+    w.str(PLUGIN_VER);
+    w.str(ps.name);
+    w.str(ps.account);
+    w.varint(ps.prof);
+    w.varint(ps.subgroup);
+    w.varint(ps.elite);
+    w.varint(ps.clock ? (uint64_t)ps.rtt_ms + 1 : 0);
+    w.svarint(ps.clock_offset_ms);
+    w.varint(ps.entries.size());
+    for (auto& pe : ps.entries) {
+        w.str(pe.label);
+        w.u8(pe.ready ? 1 : 0);
+        w.left(pe.left);
+        w.varint(pe.skillid);
+        w.varint((uint64_t)pe.ready_at);
+    }
+    if (ps.sent_at) w.varint((uint64_t)ps.sent_at);
+    return out.size() <= UDP_MAX_DATAGRAM;
+}
 
-            case ACTV_CANCEL_CANCEL:
-            case ACTV_RESET:
-                // Cancelled cast -> short fake cooldown
-            {
-                SlotTimer& st = g_by_skill[sid];
-                st.skillid = sid;
-                st.name = (skillname && *skillname)
-                    ? skillname
-                    : (std::string("skill ") + std::to_string(sid));
-                st.start_cancel_cd(now);
-            }
-            break;
+struct DgramPeer {
+    Peer peer;
+    uint64_t version = 0;   // relay room version of this peer's last change
+    int64_t sent_at = 0;    // when its owner pushed it, relay ms (0 = unknown)
+};
 
-            default:
-                // ACTV_NONE or others -> ignore for CD
-                break;
-            }
+// Body of a room datagram (after the header); false if malformed.
+static bool decode_room_datagram(WireReader& r, uint64_t& epoch, std::vector<DgramPeer>& out) {
+    out.clear();
+    epoch = r.varint();
+    const uint64_t n = r.varint();
+    for (uint64_t i = 0; i < n && r.ok; ++i) {
+        DgramPeer dp;
+        Peer& p = dp.peer;
+        p.id = r.str();
+        dp.version = r.varint();
+        p.name = r.str();
+        p.account = r.str();
+        p.prof = (uint32_t)r.varint();
+        p.subgroup = (uint32_t)r.varint();
+        p.elite = (uint32_t)r.varint();
+        const uint64_t rtt = r.varint();
+        p.clock_offset_ms = (int32_t)r.svarint();
+        p.clock_known = rtt != 0;
+        p.rtt_ms = rtt ? (uint32_t)(rtt - 1) : 0;
+
+        const uint64_t m = r.varint();
+        for (uint64_t k = 0; k < m && r.ok; ++k) {
+            PeerEntry e;
+            e.label = r.str();
+            e.ready = r.u8() != 0;
+            e.left = r.left();
+            r.varint();   // skillid
+            e.ready_at = (int64_t)r.varint();
+            p.entries.push_back(std::move(e));
         }
-
-        lk.unlock();
+        if (p.name.empty()) p.name = "unknown";
+        out.push_back(std::move(dp));
     }
-
-    if (picked) {
-        g_settings_dirty.store(true, std::memory_order_relaxed);
+    if (r.ok && r.p < r.end) {
+        for (auto& dp : out) dp.sent_at = (int64_t)r.varint();
     }
+    out.erase(std::remove_if(out.begin(), out.end(), [](const DgramPeer& dp) { return dp.peer.id.empty(); }),
+        out.end());
+    return r.ok;
 }
 
-static std::thread g_net_thread;
-static bool g_net_alive = false;
-static bool g_initialized = false;
+// Sends the push as a state datagram. False when UDP isn't live or the state
+// doesn't fit; the caller then posts it over HTTP.
+static bool udp_send_state(const PushState& ps, uint64_t seq, std::string& buf) {
+    if (!g_udp_live.load(std::memory_order_relaxed)) return false;
+    std::scoped_lock lk(g_udp_send_mutex);
+    if (g_udp_sock == BAD_SOCK) return false;
+    if (!encode_state_datagram(ps, g_udp_token, seq, buf)) return false;
+    if ((int)::send(g_udp_sock, buf.data(), (int)buf.size(), SEND_FLAGS) != (int)buf.size()) return false;
+    g_udp_sent.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
 
-static std::string make_guid() {
-    GUID g;
-    CoCreateGuid(&g);
-    char buf[64];
-    std::snprintf(buf, sizeof(buf),
-        "%08lX-%04hX-%04hX-%02hhX%02hhX-%02hhX%02hhX%02hhX%02hhX%02hhX%02hhX",
-        g.Data1, g.Data2, g.Data3,
-        g.Data4[0], g.Data4[1], g.Data4[2], g.Data4[3],
-        g.Data4[4], g.Data4[5], g.Data4[6], g.Data4[7]);
-    return buf;
+static void udp_send_ping() {
+    std::string buf;
+    WireWriter w{ buf };
+    std::scoped_lock lk(g_udp_send_mutex);
+    if (g_udp_sock == BAD_SOCK) return;
+    dgram_header(w, WIRE_DGRAM_PING);
+    w.varint(g_udp_token);
+    w.varint((uint64_t)(now_s() * 1e6));
+    if ((int)::send(g_udp_sock, buf.data(), (int)buf.size(), SEND_FLAGS) == (int)buf.size())
+        g_udp_sent.fetch_add(1, std::memory_order_relaxed);
 }
 
-static void ensure_group_membership_locked() {
-    std::unordered_map<uint32_t, std::unordered_set<std::string>> have;
-    for (auto& kv : g_group_order) {
-        have[kv.first] = std::unordered_set<std::string>(kv.second.begin(), kv.second.end());
-    }
-    for (auto& p : g_peers) {
-        uint32_t pr = p.prof;
-        if (g_group_order.find(pr) == g_group_order.end())
-            g_group_order[pr] = {};
-        if (!have[pr].count(p.id)) {
-            g_group_order[pr].push_back(p.id);
-            have[pr].insert(p.id);
-        }
+static void udp_send_confirm(uint64_t cookie) {
+    std::string buf;
+    WireWriter w{ buf };
+    std::scoped_lock lk(g_udp_send_mutex);
+    if (g_udp_sock == BAD_SOCK) return;
+    dgram_header(w, WIRE_DGRAM_CONFIRM);
+    w.varint(g_udp_token);
+    w.varint(cookie);
+    if ((int)::send(g_udp_sock, buf.data(), (int)buf.size(), SEND_FLAGS) == (int)buf.size())
+        g_udp_sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+// POST /udp/join. False (with resp.status) when the relay has no UDP.
+static bool udp_join(HttpResponse& resp, uint64_t& token, int& port) {
+    json j;
+    j["room"] = g_room;
+    j["clientId"] = g_client_id;
+    if (!http_post(g_server_host, g_server_port, g_use_https, L"/udp/join", j.dump(),
+        "application/json", resp) || resp.status != 200)
+        return false;
+    try {
+        json jr = json::parse(resp.body);
+        token = jr.value("token", 0ull);
+        port = jr.value("port", 0);
     }
-    std::unordered_set<std::string> all_ids_now;
-    for (auto& p : g_peers) all_ids_now.insert(p.id);
-    for (auto& kv : g_group_order) {
-        auto& vec = kv.second;
-        vec.erase(std::remove_if(vec.begin(), vec.end(), [&](const std::string& id) {
-            return all_ids_now.find(id) == all_ids_now.end();
-            }), vec.end());
+    catch (...) {
+        return false;
     }
+    return token != 0 && port > 0 && port < 65536;
 }
 
-static void parse_peers_from_json_locked(const json& jr) {
-    if (jr.contains("groupOrder") && jr["groupOrder"].is_object()) {
-        g_group_order.clear();
-        for (auto& kv : jr["groupOrder"].items()) {
-            uint32_t prof = (uint32_t)std::stoul(kv.key());
-            std::vector<std::string> order;
-            for (auto& v : kv.value()) order.push_back(v.get<std::string>());
-            g_group_order[prof] = std::move(order);
-        }
+// A UDP socket connected to the relay, so plain send/recv only see it.
+static sock_t udp_open(const std::string& host, int port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0)
+        return BAD_SOCK;
+
+    sock_t s = BAD_SOCK;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        s = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s == BAD_SOCK) continue;
+        if (::connect(s, ai->ai_addr, (int)ai->ai_addrlen) == 0) break;
+        sock_close(s);
+        s = BAD_SOCK;
     }
+    freeaddrinfo(res);
+    if (s != BAD_SOCK) sock_set_timeouts(s, UDP_RECV_TIMEOUT_MS);
+    return s;
+}
 
-    std::vector<Peer> peers;
+static void udp_wait(int ms) {
+    for (int waited = 0; waited < ms && g_net_alive && g_udp_enabled; waited += 50)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
 
-    auto parse_one = [&](const json& pj) {
-        Peer p;
+static void udp_loop() {
+#ifdef _WIN32
+    WSADATA wsa;
+    const bool wsa_ok = WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#endif
+    HttpResponse join_resp;
+    std::vector<DgramPeer> peers;
+    std::unordered_map<std::string, uint64_t> applied;   // clientId -> peer version
+    uint64_t applied_epoch = 0;
+    char buf[2048];
 
-        // ID: clientId preferred, fall back to legacy "id"
-        if (pj.contains("clientId") && pj["clientId"].is_string()) {
-            p.id = pj["clientId"].get<std::string>();
-        }
-        else if (pj.contains("id") && pj["id"].is_string()) {
-            p.id = pj["id"].get<std::string>();
-        }
-        else {
-            p.id.clear();
+    while (g_net_alive) {
+        if (!g_udp_enabled) {
+            g_udp_status = "off";
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            continue;
         }
-        p.elite = pj.value("elite", 0u);
-        p.prof = pj.value("prof", 0u);
-        p.subgroup = pj.value("subgroup", 0u);
 
-        // name may be null / missing
-        if (pj.contains("name") && pj["name"].is_string()) {
-            p.name = pj["name"].get<std::string>();
+        if (relay_paused()) {
+            g_udp_status = "waiting for relay";
+            udp_wait(250);
+            continue;
         }
-        else {
-            p.name = "unknown";
+        g_udp_status = "joining";
+        g_udp_joins.fetch_add(1, std::memory_order_relaxed);
+        uint64_t token = 0;
+        int port = 0;
+        if (!udp_join(join_resp, token, port)) {
+            const bool unsupported = join_resp.status == 404;
+            g_udp_status = unsupported ? "relay has no UDP" : "join failed";
+            udp_wait(unsupported ? UDP_UNSUPPORTED_RETRY_MS : UDP_RETRY_MS);
+            continue;
         }
-
-        // account can be null on old clients
-        if (pj.contains("account") && pj["account"].is_string()) {
-            p.account = pj["account"].get<std::string>();
+        const sock_t s = udp_open(g_server_host, port);
+        if (s == BAD_SOCK) {
+            g_udp_status = "no socket";
+            udp_wait(UDP_RETRY_MS);
+            continue;
         }
-        else {
-            p.account.clear();
+        {
+            std::scoped_lock lk(g_udp_send_mutex);
+            g_udp_sock = s;
+            g_udp_token = token;
         }
 
-        if (pj.contains("entries") && pj["entries"].is_array()) {
-            for (auto& ej : pj["entries"]) {
-                PeerEntry e;
+        const std::string room = g_room;
+        auto last_rx = std::chrono::steady_clock::now();
+        auto last_ping = last_rx - std::chrono::milliseconds(UDP_PING_MS);
+        while (g_net_alive && g_udp_enabled && g_room == room) {
+            const auto now_tp = std::chrono::steady_clock::now();
+            if (now_tp - last_ping >= std::chrono::milliseconds(UDP_PING_MS)) {
+                last_ping = now_tp;
+                udp_send_ping();
+            }
+            if (now_tp - last_rx >= std::chrono::milliseconds(UDP_SILENCE_MS)) {
+                g_udp_status = "relay silent";
+                break;
+            }
 
-                if (ej.contains("label") && ej["label"].is_string()) {
-                    e.label = ej["label"].get<std::string>();
-                }
-                else {
-                    e.label.clear();
-                }
+            const int n = (int)::recv(s, buf, (int)sizeof(buf), 0);
+            if (n <= 0) continue;
+            g_udp_received.fetch_add(1, std::memory_order_relaxed);
 
-                e.ready = ej.value("ready", false);
+            WireReader r{ (const uint8_t*)buf, (const uint8_t*)buf + n };
+            const uint8_t magic = r.u8();
+            const uint8_t version = r.u8();
+            const uint8_t kind = r.u8();
+            if (!r.ok || magic != WIRE_MAGIC || version < 2 || version > WIRE_VERSION) {
+                g_udp_dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
 
-                if (ej.contains("left") && ej["left"].is_number()) {
-                    e.left = (float)ej["left"].get<double>();
+            if (kind == WIRE_DGRAM_CHALLENGE) {
+                const uint64_t cookie = r.varint();
+                if (!r.ok) continue;
+                if (!g_udp_live.load(std::memory_order_relaxed)) g_udp_status = "confirming address";
+                udp_send_confirm(cookie);
+                // the ping it answered gets no pong: send the next one right away
+                last_ping = now_tp - std::chrono::milliseconds(UDP_PING_MS);
+            }
+            else if (kind == WIRE_DGRAM_PONG) {
+                const uint64_t stamp = r.varint();
+                if (!r.ok) continue;
+                const double rtt = (now_s() * 1e6 - (double)stamp) / 1000.0;
+                smooth_ms(g_udp_rtt_ms, rtt);
+                const double lo = g_udp_rtt_min_ms.load(std::memory_order_relaxed);
+                if (lo <= 0.0 || rtt < lo) g_udp_rtt_min_ms.store(rtt, std::memory_order_relaxed);
+                last_rx = now_tp;
+                if (!g_udp_live.exchange(true)) g_udp_status = "live";
+            }
+            else if (kind == WIRE_DGRAM_ROOM) {
+                uint64_t epoch = 0;
+                if (!decode_room_datagram(r, epoch, peers)) {
+                    g_udp_dropped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
                 }
-                else {
-                    e.left = -1.f;
+                last_rx = now_tp;
+                if (epoch != applied_epoch) {
+                    applied.clear();
+                    applied_epoch = epoch;
                 }
 
-                p.entries.push_back(e);
+                std::scoped_lock pk(g_peers_mutex);
+                PeerSnapshot* next = nullptr;
+                for (auto& dp : peers) {
+                    uint64_t& seen = applied[dp.peer.id];
+                    if (dp.version <= seen) {
+                        // overtaken by a later datagram for the same peer
+                        g_udp_dropped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    seen = dp.version;
+                    note_fanout(g_fanout_udp, dp.sent_at);
+                    if (!next) next = next_peer_snapshot(true);
+                    upsert_peer(next->peers, std::move(dp.peer));
+                }
+                if (!next) continue;
+                {
+                    std::scoped_lock lk(g_mutex);
+                    settle_peers_locked(next->peers);
+                }
+                publish_peer_snapshot(next);
             }
         }
 
-        if (!p.id.empty()) {
-            peers.push_back(std::move(p));
-        }
-        };
-
-    if (jr.contains("peers")) {
-        const auto& px = jr["peers"];
-        if (px.is_array()) {
-            for (auto& pj : px) parse_one(pj);
-        }
-        else if (px.is_object()) {
-            for (auto& kv : px.items()) {
-                json pj = kv.value();
-                pj["clientId"] = kv.key();
-                parse_one(pj);
-            }
-        }
-    }
-    else if (jr.contains("clients") && jr["clients"].is_array()) {
-        for (auto& pj : jr["clients"]) parse_one(pj);
-    }
-    else if (jr.is_array()) {
-        for (auto& pj : jr) parse_one(pj);
-    }
-    else if (jr.contains("rooms") && jr["rooms"].is_object()) {
-        auto it = jr["rooms"].find(g_room);
-        if (it != jr["rooms"].end() && it->is_array()) {
-            for (auto& pj : *it) parse_one(pj);
+        g_udp_live = false;
+        {
+            std::scoped_lock lk(g_udp_send_mutex);
+            g_udp_sock = BAD_SOCK;
+            g_udp_token = 0;
         }
+        sock_close(s);
+        applied.clear();
+        udp_wait(UDP_RETRY_MS);
     }
 
-    g_peers.swap(peers);
-    ensure_group_membership_locked();
+#ifdef _WIN32
+    if (wsa_ok) WSACleanup();
+#endif
 }
 
-static void inject_self_if_missing_locked() {
-    const bool have_self =
-        std::any_of(g_peers.begin(), g_peers.end(), [&](const Peer& p) { return p.id == g_client_id; });
-
-    if (have_self) return;
-
-    Peer self;
-    self.id = g_client_id;
-    self.name = !g_self_charname.empty()
-        ? g_self_charname
-        : (g_assigned_name.empty() ? std::string("me") : g_assigned_name);
-    self.prof = g_self_prof;
-    self.subgroup = g_self.subgroup;
-
-    double now = now_s();
-
-    for (auto& e : g_tracked) {
-        if (!e.enabled || e.skillid == 0) continue;
-        float left = compute_left_for_local(e.skillid, e.base_cd, now);
+// ----------------- NET LOOP (patched) -----------------
 
-        PeerEntry pe;
-        pe.label = e.label;
-        pe.ready = (left >= 0.f && left <= 0.5f) || (g_by_skill.find(e.skillid) == g_by_skill.end());
-        pe.left = (left < 0.f ? -1.f : left);
-        self.entries.push_back(pe);
-    }
+// -------------------- net cadence --------------------
+//
+// How often net_loop pushes and pulls follows what the player is doing:
+// fast in combat (and for a while after a tracked cast), a slow heartbeat
+// out of combat, and only a keep-alive push during loading screens and map
+// changes so the relay doesn't prune us. Casts and ready transitions push
+// immediately through request_push_now() whatever the cadence.
+
+struct NetCadence {
+    int push_ms;
+    int pull_ms;          // 0: no pulls
+    const char* reason;
+};
 
-    g_peers.push_back(std::move(self));
-    ensure_group_membership_locked();
+// shown in the options window
+static std::atomic<int> g_cadence_push_ms{ PUSH_INTERVAL_MS };
+static std::atomic<int> g_cadence_pull_ms{ PULL_INTERVAL_MS };
+static std::atomic<const char*> g_cadence_reason{ "starting" };
+static std::atomic<uint32_t> g_pushes_min{ 0 };
+
+static NetCadence pick_net_cadence_locked(double now) {
+    if (g_game_loading.load(std::memory_order_relaxed))
+        return { PUSH_PAUSED_INTERVAL_MS, 0, "loading screen" };
+    if (g_in_map_change)
+        return { PUSH_PAUSED_INTERVAL_MS, 0, "map change" };
+    if (g_self_in_combat)
+        return { PUSH_INTERVAL_MS, PULL_INTERVAL_MS, "in combat" };
+    if (now - g_last_tracked_cast_s < COMBAT_LINGER_S)
+        return { PUSH_INTERVAL_MS, PULL_INTERVAL_MS, "recent cast" };
+    return { PUSH_IDLE_INTERVAL_MS, PULL_IDLE_INTERVAL_MS, "idle" };
 }
 
-// ----------------- NET LOOP (patched) -----------------
-
 static void net_loop() {
     if (g_client_id.empty()) {
         g_client_id = make_guid();
@@ -1282,132 +5927,232 @@ static void net_loop() {
     auto last_push = std::chrono::steady_clock::now();
     auto last_pull = std::chrono::steady_clock::now();
 
+    auto next_clock_sync = std::chrono::steady_clock::now();
+    bool pushed_udp = false;   // the last push went out as a datagram
+
+    // kept across iterations so the receive path reuses their buffers
+    HttpResponse push_resp, pull_resp, clock_resp, probe_resp;
+    std::string push_body;
+    PushState push_state;
+    PushOrders push_orders, pull_orders;
+    std::vector<Peer> pull_peers;
+
+    auto win_start = std::chrono::steady_clock::now();
+    uint64_t win_bytes = 0, win_full_bytes = 0;
+    uint32_t win_pushes = 0;
+
     while (g_net_alive) {
         auto now_tp = std::chrono::steady_clock::now();
 
+        // keep the combat queue and ready wheel moving even while the overlay is hidden
+        NetCadence cadence;
+        {
+            std::scoped_lock lk(g_mutex);
+            pump_combat_locked();
+            cadence = pick_net_cadence_locked(now_s());
+        }
+        flush_capture();
+        play_ready_beep();
+        g_cadence_push_ms.store(cadence.push_ms, std::memory_order_relaxed);
+        g_cadence_pull_ms.store(cadence.pull_ms, std::memory_order_relaxed);
+        g_cadence_reason.store(cadence.reason, std::memory_order_relaxed);
+
+        // ---- RELAY HEALTH (GET /health while the breaker is open) ----
+        if (g_relay_open) relay_probe(probe_resp);
+        const bool relay_ok = !relay_paused();
+
+        // ---- CLOCK SYNC (GET /time) ----
+        if (relay_ok && now_tp >= next_clock_sync) {
+            int wait_ms = CLOCK_SYNC_MS;
+            const bool sampled = sample_relay_clock(clock_resp);
+            relay_note(clock_resp);
+            if (!sampled) {
+                if (clock_resp.status == 404) wait_ms = CLOCK_UNSUPPORTED_MS;
+            }
+            else if (g_clock_sample_count < CLOCK_BURST) {
+                wait_ms = CLOCK_BURST_MS;
+            }
+            next_clock_sync = now_tp + std::chrono::milliseconds(wait_ms);
+        }
+
         // ---- PUSH /update ----
-        if (g_share_enabled &&
-            std::chrono::duration_cast<std::chrono::milliseconds>(now_tp - last_push).count() >= PUSH_INTERVAL_MS) {
+        const bool push_now = g_push_requested.exchange(false, std::memory_order_relaxed);
+        if (relay_ok && g_share_enabled && (push_now ||
+            std::chrono::duration_cast<std::chrono::milliseconds>(now_tp - last_push).count() >= cadence.push_ms)) {
 
             last_push = now_tp;
-            {
-                uint32_t sid;
-                // drain the queue (or you can do just one per loop if you prefer)
-                while (pop_next_cd_request(sid)) {
-                    float cd = fetch_skill_recharge_api(sid);  // blocking is OK here
-                    if (cd > 0.f) {
-                        std::scoped_lock lk(g_mutex);
-                        g_api_cd_cache[sid] = cd;
-                    }
-                }
-            }
 
-            json payload;
-            payload["room"] = g_room;
-            payload["clientId"] = g_client_id;
-            payload["pluginVer"] = PLUGIN_VER;
+            ++g_push_seq;
+            double now = now_s();
 
             {
                 std::scoped_lock lk(g_mutex);
-                payload["name"] = (!g_self_charname.empty() ? g_self_charname : g_assigned_name);
-                payload["prof"] = g_self_prof;
-                payload["subgroup"] = g_self.subgroup;
-
-                payload["elite"] = g_self.elite;
-
+                NetScope held(&g_net_stats[EP_UPDATE], NP_LOCK);
+                collect_push_state_locked(push_state, now);
+                collect_push_orders_locked(push_orders);
+            }
 
-                if (!g_self_accountname.empty()) {
-                    payload["account"] = g_self_accountname;
+            // a push carrying group orders has to arrive, so it always goes over HTTP
+            if (push_orders.empty() && udp_send_state(push_state, g_push_seq, push_body)) {
+                pushed_udp = true;
+                win_bytes += push_body.size();
+                ++win_pushes;
+                win_full_bytes += push_body.size();
+            }
+            else {
+                if (pushed_udp) {
+                    // the relay's record came from datagrams: start HTTP over with a full payload
+                    pushed_udp = false;
+                    g_push_acked = 0;
+                    g_wire_tx.restart();
                 }
 
-                if (!g_group_order_dirty.empty()) {
-                    json orders = json::object();
-                    for (auto prof : g_group_order_dirty) {
-                        auto it = g_group_order.find(prof);
-                        if (it == g_group_order.end()) continue;
-                        json arr = json::array();
-                        for (auto& id : it->second) arr.push_back(id);
-                        orders[std::to_string(prof)] = std::move(arr);
+                const bool full = !g_push_delta_ok || g_push_acked == 0;
+                const bool wire = g_binary_wire && !g_wire_rejected;
+                if (wire) {
+                    encode_update_wire(push_state, full ? nullptr : &g_push_baseline, push_orders, push_body);
+                }
+                else {
+                    json payload;
+                    payload["room"] = g_room;
+                    payload["clientId"] = g_client_id;
+                    payload["seq"] = g_push_seq;
+                    if (push_state.sent_at) payload["sentAt"] = push_state.sent_at;
+                    if (full) {
+                        payload["pluginVer"] = PLUGIN_VER;
+                        encode_full_update(push_state, payload);
+                    }
+                    else {
+                        encode_delta_update(push_state, g_push_baseline, payload);
                     }
-                    if (!orders.empty())
-                        payload["groupOrder"] = std::move(orders);
-                    g_group_order_dirty.clear();
+                    encode_orders_json(push_orders, payload);
+                    push_body = payload.dump();
                 }
-            }
-            payload["entries"] = json::array();
-
-            double now = now_s();
-
-            {
-                std::scoped_lock lk(g_mutex);
-                for (auto& e : g_tracked) {
-                    if (!e.enabled || e.skillid == 0) continue;
-
-                    float left = compute_left_for_shared(e.skillid, e.base_cd, now);
 
-                    const bool ready =
-                        (left >= 0.f && left <= 0.5f) ||
-                        (g_by_skill.find(e.skillid) == g_by_skill.end());
-
-                    json row;
-                    row["label"] = e.label;
-                    row["ready"] = ready;
-                    row["left"] = (left < 0 ? nullptr : json(left));
-                    row["skillid"] = e.skillid;
-                    payload["entries"].push_back(row);
+                if (full) g_push_full_size = push_body.size();
+                win_bytes += push_body.size();
+                ++win_pushes;
+                win_full_bytes += full ? push_body.size() : g_push_full_size;
+
+                const double sent_s = now_s();
+                bool ok = http_post(
+                    g_server_host, g_server_port, g_use_https,
+                    L"/update", push_body, wire ? WIRE_CONTENT_TYPE : "application/json", push_resp
+                );
+                if (ok) smooth_ms(g_http_push_ms, (now_s() - sent_s) * 1000.0);
+                relay_note(push_resp);
+
+                // 400/415 mean the relay could not read the payload; 429 and
+                // 5xx are load or outage, left to relay_note and the breaker
+                const bool refused = push_resp.status == 400 || push_resp.status == 415;
+                if (ok && wire && refused) {
+                    // relay without binary support: JSON from the next push on
+                    g_wire_rejected = true;
+                    g_push_requested = true;
+                    arc_log("[sqcd] relay rejected binary /update, using JSON");
                 }
-            }
-
-            std::string resp;
-            bool ok = http_post_json(
-                g_server_host, g_server_port, g_use_https,
-                L"/update", payload.dump(), &resp
-            );
-
-            if (ok && !resp.empty()) {
-                try {
-                    auto jr = json::parse(resp);
-                    if (jr.contains("assignedName") && jr["assignedName"].is_string()) {
-                        g_assigned_name = jr["assignedName"].get<std::string>();
-                    }
+                else if (ok && !full && refused) {
+                    // relay without delta support: stay on full payloads
+                    g_push_delta_ok = false;
+                    g_push_acked = 0;
                 }
-                catch (const std::exception& e) {
-                    char buf[256];
-                    std::snprintf(buf, sizeof(buf),
-                        "[sqcd] /update JSON error: %s", e.what());
-                    arc_log(buf);
+                else if (ok && !push_resp.body.empty()) {
+                    try {
+                        json jr;
+                        {
+                            NetScope parse(&g_net_stats[EP_UPDATE], NP_PARSE);
+                            jr = json::parse(push_resp.body);
+                        }
+                        if (jr.contains("assignedName") && jr["assignedName"].is_string()) {
+                            g_assigned_name = jr["assignedName"].get<std::string>();
+                        }
+                        if (jr.value("resync", false)) {
+                            g_push_acked = 0;
+                            g_wire_tx.restart();
+                            g_push_resyncs.fetch_add(1, std::memory_order_relaxed);
+                            g_push_requested = true;
+                        }
+                        else if (jr.contains("ack") && jr["ack"].is_number_unsigned() &&
+                            jr["ack"].get<uint64_t>() == g_push_seq) {
+                            g_push_acked = g_push_seq;
+                            g_push_baseline = push_state;
+                            if (wire) g_wire_tx.acked = g_wire_tx.in_flight;
+                            if (full) g_push_delta_ok = true;
+                        }
+                        else if (full) {
+                            g_push_delta_ok = false;
+                        }
+                    }
+                    catch (const std::exception& e) {
+                        char buf[256];
+                        std::snprintf(buf, sizeof(buf),
+                            "[sqcd] /update JSON error: %s", e.what());
+                        arc_log(buf);
+                    }
                 }
             }
         }
 
-        // ---- PULL /aggregate ----
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(now_tp - last_pull).count() >= PULL_INTERVAL_MS) {
+        if (now_tp - win_start >= std::chrono::minutes(1)) {
+            g_push_bytes_min = win_bytes;
+            g_pushes_min = win_pushes;
+            win_pushes = 0;
+            g_push_full_bytes_min = win_full_bytes;
+            win_bytes = win_full_bytes = 0;
+            win_start = now_tp;
+        }
+
+        // ---- PULL /aggregate (fallback while the push channel is down) ----
+        // with datagrams live, pulls only back them up (leaves, orders, losses)
+        const int pull_ms = g_udp_live && cadence.pull_ms > 0
+            ? std::max(cadence.pull_ms, PULL_IDLE_INTERVAL_MS) : cadence.pull_ms;
+        if (relay_ok && !g_room_stream_live && pull_ms > 0 &&
+            std::chrono::duration_cast<std::chrono::milliseconds>(now_tp - last_pull).count() >= pull_ms) {
             last_pull = now_tp;
             std::wstring qp = L"/aggregate?room=" + std::wstring(g_room.begin(), g_room.end());
-            std::string resp;
-            bool ok = http_get(g_server_host, g_server_port, g_use_https, qp, &resp);
-            if (ok && !resp.empty()) {
-                try {
-                    auto jr = json::parse(resp);
-                    {
-                        std::scoped_lock lk(g_mutex);
-                        g_cached_raw = jr;
-                        parse_peers_from_json_locked(jr);
-                        inject_self_if_missing_locked();
-                    }
-
-                    
+            if (g_agg_seen.epoch != 0) {
+                qp += L"&epoch=" + std::to_wstring(g_agg_seen.epoch) +
+                    L"&since=" + std::to_wstring(g_agg_seen.version);
+            }
+            const bool wire = g_binary_wire;
+            if (wire) {
+                qp += L"&dict=" + std::to_wstring(g_wire_rx.id) + L"." +
+                    std::to_wstring(g_wire_rx.names.size());
+            }
+            bool ok = http_get(g_server_host, g_server_port, g_use_https, qp, pull_resp,
+                wire ? WIRE_ACCEPT : nullptr);
+            relay_note(pull_resp);
+            if (ok && pull_resp.status == 304) {
+                // nothing changed since g_agg_seen.version
+            }
+            else if (ok && pull_resp.status == 200 && !pull_resp.body.empty()) {
+                const bool binary = is_wire_response(pull_resp);
+                bool has_orders = false;
+                AggregateMeta meta;
+                bool decoded;
+                {
+                    NetScope parse(&g_net_stats[EP_AGGREGATE], NP_PARSE);
+                    decoded = binary
+                        ? decode_aggregate_wire(pull_resp.body, pull_peers, pull_orders, has_orders, meta)
+                        : decode_aggregate_json(pull_resp.body, g_room, pull_peers, pull_orders, has_orders, meta);
+                }
+                if (decoded) {
+                    if (!binary && !meta.partial) keep_decode_sample(pull_resp.body);
+                    apply_room_reply(pull_peers, pull_orders, has_orders, meta, &g_net_stats[EP_AGGREGATE]);
+                    g_agg_seen = std::move(meta);
                 }
-                catch (const std::exception& e) {
-                    char buf[256];
-                    std::snprintf(buf, sizeof(buf),
-                        "[sqcd] aggregate JSON exception: %s", e.what());
-                    arc_log(buf);
+                else if (binary) {
+                    arc_log("[sqcd] aggregate: malformed binary response");
                 }
             }
         }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        {
+            std::unique_lock<std::mutex> lk(g_net_wake_mutex);
+            g_net_wake_cv.wait_for(lk, std::chrono::milliseconds(NET_TICK_MS), [] {
+                return !g_net_alive || g_push_requested.load(std::memory_order_relaxed);
+            });
+        }
     }
 }
 
@@ -1441,6 +6186,28 @@ static void move_peer_down_in_group(uint32_t prof, const std::string& id) {
 }
 
 
+// ---- ready-transition listeners (called with g_mutex held) ----
+
+static void on_ready_flash(uint32_t sid, double now_s_val) {
+    g_ready_flash_until[sid] = now_s_val + READY_FLASH_S;
+}
+
+static void on_ready_push(uint32_t, double) {
+    request_push_now();
+}
+
+static void on_ready_sound(uint32_t, double) {
+    if (g_ready_sound) g_ready_beep_pending.store(true, std::memory_order_relaxed);
+}
+
+// Interns an edited label into its row and schedules the save.
+static void commit_label_edit_locked(TrackedEntry& row, const char* text) {
+    if (std::strcmp(name_cstr(row.label), text) == 0) return;
+    row.label = intern_name(text);
+    g_label_save_pending = true;
+    g_last_label_edit_s = now_s();
+}
+
 static void draw_tracked_ui() {
     static bool  s_prev_open = false;
     static int   s_prev_row_count = 0;
@@ -1502,6 +6269,11 @@ static void draw_tracked_ui() {
         ImGui::TableSetupColumn("## ");
         ImGui::TableSetupColumn("##Cooldown");
 
+        // row whose label is being typed; dropped if its field went away
+        static int s_label_row = -1;
+        static char s_label_buf[256];
+        if (s_label_row >= (int)g_tracked.size() || !ImGui::IsAnyItemActive()) s_label_row = -1;
+
         for (int i = 0; i < (int)g_tracked.size(); ++i) {
             auto& e = g_tracked[i];
             ImGui::TableNextRow();
@@ -1511,14 +6283,25 @@ static void draw_tracked_ui() {
 
             ImGui::TableSetColumnIndex(1);
             {
+                // typed into s_label_buf; interned once the edit is committed
+                // (Enter or focus loss), not on every keystroke
                 ImGui::PushItemWidth(220.f);
+                const bool editing = s_label_row == i;
                 char buf[256];
-                std::snprintf(buf, sizeof(buf), "%s", e.label.c_str());
-                if (ImGui::InputText(("##lbl" + std::to_string(i)).c_str(), buf, IM_ARRAYSIZE(buf))) {
-                    e.label = buf;
-                    g_label_save_pending = true;
-                    g_last_label_edit_s = now_s();
+                if (!editing) std::snprintf(buf, sizeof(buf), "%s", name_cstr(e.label));
+                ImGui::InputText(("##lbl" + std::to_string(i)).c_str(),
+                    editing ? s_label_buf : buf, sizeof(buf));
+                if (ImGui::IsItemActivated()) {
+                    // clicking or tabbing straight from another label activates
+                    // this one before that one reports its deactivation
+                    if (s_label_row >= 0 && s_label_row != i)
+                        commit_label_edit_locked(g_tracked[s_label_row], s_label_buf);
+                    s_label_row = i;
+                    std::memcpy(s_label_buf, buf, sizeof(buf));
                 }
+                if (ImGui::IsItemDeactivatedAfterEdit() && editing)
+                    commit_label_edit_locked(e, s_label_buf);
+                if (ImGui::IsItemDeactivated()) s_label_row = -1;
                 ImGui::PopItemWidth();
             }
 
@@ -1530,7 +6313,8 @@ static void draw_tracked_ui() {
             ImGui::TableSetColumnIndex(3);
             {
                 float left = -1.f;
-                if (e.skillid) left = compute_left_for_local(e.skillid, e.base_cd, now);
+                bool ready = false;
+                if (e.skillid) left = compute_left_for_local(e.skillid, e.base_cd, now, ready);
 
                 if (e.skillid == 0) {
                     ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "no skill");
@@ -1538,8 +6322,12 @@ static void draw_tracked_ui() {
                 else if (g_by_skill.find(e.skillid) == g_by_skill.end()) {
                     ImGui::TextDisabled("");
                 }
-                else if (left <= 0.5f && left >= 0.f) {
-                    ImGui::TextColored(ImVec4(0.5f, 1.0f, 0.5f, 1.0f), "READY");
+                else if (ready) {
+                    auto fl = g_ready_flash_until.find(e.skillid);
+                    const bool flash = fl != g_ready_flash_until.end() && now < fl->second;
+                    ImGui::TextColored(flash
+                        ? ImVec4(1.0f, 1.0f, 0.4f, 1.0f)
+                        : ImVec4(0.5f, 1.0f, 0.5f, 1.0f), "READY");
                 }
                 else if (left >= 0.f) {
                     if (left < 10.0f) {
@@ -1557,10 +6345,10 @@ static void draw_tracked_ui() {
 
         if (erase >= 0) {
             g_tracked.erase(g_tracked.begin() + erase);
+            rebuild_tracked_filter_locked();
 
             if (g_pick_row == erase) {
-                g_pick_row = -1;
-                g_pick_armed_until_s = 0.0;
+                disarm_pick_locked();
             }
             else if (g_pick_row > erase) {
                 --g_pick_row;
@@ -1573,10 +6361,9 @@ static void draw_tracked_ui() {
     }
 
     if (ImGui::Button("Add tracked skill")) {
-        g_tracked.push_back(TrackedEntry{ true, 0, 0.f, "Label" });
+        g_tracked.push_back(TrackedEntry{});
         int newIndex = (int)g_tracked.size() - 1;
-        g_pick_row = newIndex;
-        g_pick_armed_until_s = now_s() + 6.0;
+        arm_pick_locked(newIndex, now_s() + 6.0);
         g_pick_not_before_ms = g_last_ev_ms;
         save_settings_all();
     }
@@ -1608,29 +6395,22 @@ static void draw_tracked_ui() {
 
 static const ImVec4 SEP_COLOR(0.8f, 0.8f, 0.8f, 0.8f);
 
-static void draw_group_table(uint32_t prof, const std::vector<Peer>& peers_snapshot) {
+static void draw_group_table(uint32_t prof, const std::vector<const Peer*>& visible,
+    const std::unordered_set<std::string>& dead_accounts) {
     std::vector<const Peer*> peers;
-    peers.reserve(peers_snapshot.size());
-    for (const auto& p : peers_snapshot) {
-        if (prof == 0) {
-            if (p.prof == 0) peers.push_back(&p);
-        }
-        else {
-            if (p.prof == prof) peers.push_back(&p);
-        }
+    peers.reserve(visible.size());
+    for (const Peer* p : visible) {
+        if (p->prof == prof) peers.push_back(p);
     }
     if (peers.empty())
         return;
 
     std::vector<std::string> order;
-    std::unordered_set<std::string> dead_accounts_snapshot;
     {
         std::scoped_lock lk(g_mutex);
         auto it = g_group_order.find(prof);
         if (it != g_group_order.end())
             order = it->second;
-
-        dead_accounts_snapshot = g_dead_accounts;
     }
 
     std::unordered_map<std::string, const Peer*> by_id;
@@ -1680,6 +6460,7 @@ static void draw_group_table(uint32_t prof, const std::vector<Peer>& peers_snaps
         ImGui::TableSetupColumn("Skills", ImGuiTableColumnFlags_WidthStretch);
         ImGui::TableSetupColumn("Re", ImGuiTableColumnFlags_WidthFixed, 60.0f);
 
+        const double relay_now = relay_now_ms();
         int row = 0;
         for (const Peer* p : ordered) {
             ImGui::TableNextRow();
@@ -1690,9 +6471,9 @@ static void draw_group_table(uint32_t prof, const std::vector<Peer>& peers_snaps
 
             // Determine dead/down state ONCE per peer
             bool is_dead = false;
-            if (!p->account.empty() && dead_accounts_snapshot.count(p->account))
+            if (!p->account.empty() && dead_accounts.count(p->account))
                 is_dead = true;
-            else if (!p->name.empty() && dead_accounts_snapshot.count(p->name))
+            else if (!p->name.empty() && dead_accounts.count(p->name))
                 is_dead = true;
 
             // Column 1: name (already greyed when dead)
@@ -1705,6 +6486,10 @@ static void draw_group_table(uint32_t prof, const std::vector<Peer>& peers_snaps
 
                 const std::string& display_name = !p->name.empty() ? p->name : p->id;
                 ImGui::TextColored(name_color, "%s", display_name.c_str());
+                if (p->clock_known && ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("rtt %u ms, clock %+d ms vs relay",
+                        p->rtt_ms, p->clock_offset_ms);
+                }
             }
 
             // Column 2: skills / timers (NEW: grey out when dead)
@@ -1720,6 +6505,8 @@ static void draw_group_table(uint32_t prof, const std::vector<Peer>& peers_snaps
             else {
                 for (size_t i = 0; i < p->entries.size(); ++i) {
                     const PeerEntry& e = p->entries[i];
+                    bool e_ready;
+                    const float e_left = peer_entry_left(e, relay_now, e_ready);
 
                     if (i) {
                         ImGui::SameLine(0.0f, 4.0f);
@@ -1727,28 +6514,28 @@ static void draw_group_table(uint32_t prof, const std::vector<Peer>& peers_snaps
                         ImGui::SameLine(0.0f, 4.0f);
                     }
 
-                    if (e.ready) {
+                    if (e_ready) {
                         ImVec4 col = is_dead
                             ? disabled_color
                             : ImVec4(0.60f, 1.00f, 0.60f, 1.00f);
                         ImGui::TextColored(col, "%s", e.label.c_str());
                     }
-                    else if (e.left >= 0.f) {
-                        if (e.left < 10.0f) {
+                    else if (e_left >= 0.f) {
+                        if (e_left < 10.0f) {
                             ImVec4 col = is_dead
                                 ? disabled_color
                                 : ImVec4(1.00f, 0.80f, 0.40f, 1.00f);
                             ImGui::TextColored(
                                 col,
-                                "%s %.0fs", e.label.c_str(), e.left
+                                "%s %.0fs", e.label.c_str(), e_left
                             );
                         }
                         else {
                             if (is_dead) {
-                                ImGui::TextColored(disabled_color, "%s %.0fs", e.label.c_str(), e.left);
+                                ImGui::TextColored(disabled_color, "%s %.0fs", e.label.c_str(), e_left);
                             }
                             else {
-                                ImGui::Text("%s %.0fs", e.label.c_str(), e.left);
+                                ImGui::Text("%s %.0fs", e.label.c_str(), e_left);
                             }
                         }
                     }
@@ -1782,33 +6569,38 @@ static void draw_group_table(uint32_t prof, const std::vector<Peer>& peers_snaps
 
 
 static void draw_squad_ui() {
-    std::vector<Peer> peers_snapshot;
+    // only touched from the render thread; refreshed when the roster changes
+    static RosterView s_roster;
+
+    // drawn in place; the pin keeps writers from reclaiming it meanwhile
+    PeerSnapshotPin pin;
     uint32_t my_subgroup = 0;
-    std::unordered_set<std::string> squad_accounts;
     std::string my_account;
 
     {
         std::scoped_lock lk(g_mutex);
-        peers_snapshot = g_peers;
         my_subgroup = g_self.subgroup;
-        squad_accounts = g_squad_accounts;
+        refresh_roster_view_locked(s_roster);
         my_account = g_self_accountname;
     }
 
-    if (peers_snapshot.empty()) {
+    const std::unordered_set<std::string>& squad_accounts = s_roster.squad;
+
+    if (!pin.snap || pin.snap->peers.empty()) {
         ImGui::TextDisabled("No peers yet. Others must run the addon and enable sharing.");
         return;
     }
+    const std::vector<Peer>& all_peers = pin.snap->peers;
 
-    std::vector<Peer> filtered;
-    filtered.reserve(peers_snapshot.size());
+    std::vector<const Peer*> visible;
+    visible.reserve(all_peers.size());
 
     const bool have_squad_accounts = !squad_accounts.empty();
 
     if (have_squad_accounts) {
-        for (auto& p : peers_snapshot) {
+        for (auto& p : all_peers) {
             if (p.id == g_client_id) {
-                filtered.push_back(p);
+                visible.push_back(&p);
                 continue;
             }
 
@@ -1827,27 +6619,25 @@ static void draw_squad_ui() {
             }
 
             if (in_squad)
-                filtered.push_back(p);
+                visible.push_back(&p);
         }
     }
     else if (my_subgroup != 0) {
-        for (auto& p : peers_snapshot) {
+        for (auto& p : all_peers) {
             if (p.subgroup != 0)
-                filtered.push_back(p);
+                visible.push_back(&p);
         }
     }
     else {
-        for (auto& p : peers_snapshot) {
+        for (auto& p : all_peers) {
             if (p.id == g_client_id) {
-                filtered.push_back(p);
+                visible.push_back(&p);
                 break;
             }
         }
     }
 
-    peers_snapshot.swap(filtered);
-
-    if (peers_snapshot.empty()) {
+    if (visible.empty()) {
         if (my_subgroup != 0)
             ImGui::TextDisabled("No peers in your squad.");
         else
@@ -1871,15 +6661,23 @@ static void draw_squad_ui() {
     };
 
     for (size_t i = 0; i < sizeof(PROF_ORDER) / sizeof(PROF_ORDER[0]); ++i) {
-        draw_group_table(PROF_ORDER[i], peers_snapshot);
+        draw_group_table(PROF_ORDER[i], visible, s_roster.dead);
     }
 
     // Unknown / prof=0 at the bottom
-    draw_group_table(0, peers_snapshot);
+    draw_group_table(0, visible, s_roster.dead);
 }
 
 
 static void __cdecl on_imgui(uint32_t not_charsel_or_loading, uint32_t) {
+    {
+        std::scoped_lock lk(g_mutex);
+        pump_combat_locked();
+    }
+    flush_capture();
+    play_ready_beep();
+
+    g_game_loading.store(!not_charsel_or_loading, std::memory_order_relaxed);
     if (!not_charsel_or_loading)
         return;
 
@@ -1991,6 +6789,429 @@ static uintptr_t __cdecl options_windows(const char* windowname) {
 
         ImGui::NextColumn();
 
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.85f, 0.80f, 0.60f, 1.0f));
+        ImGui::TextUnformatted("Sound on ready");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        bool sound = g_ready_sound;
+        ImVec4 soundColor = sound
+            ? ImVec4(0.60f, 1.00f, 0.60f, 1.00f)
+            : ImVec4(0.80f, 0.80f, 0.80f, 1.00f);
+
+        ImGui::PushStyleColor(ImGuiCol_Text, soundColor);
+        if (ImGui::Checkbox("Beep", &sound)) {
+            g_ready_sound = sound;
+            save_settings_all();
+        }
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Transport");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        bool raw = g_use_socket_transport.load();
+        if (ImGui::Checkbox("Raw sockets (http only)", &raw)) {
+            g_use_socket_transport = raw;
+            save_settings_all();
+        }
+        ImGui::SameLine();
+        bool wire = g_binary_wire.load();
+        if (ImGui::Checkbox("Binary wire format", &wire)) {
+            g_binary_wire = wire;
+            g_wire_rejected = false;
+            save_settings_all();
+        }
+        if (wire && g_wire_rejected) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(relay only speaks JSON)");
+        }
+        ImGui::SameLine();
+        bool compress = g_http_compress.load();
+        if (ImGui::Checkbox("Compression", &compress)) {
+            g_http_compress = compress;
+            save_settings_all();
+        }
+        ImGui::SameLine();
+        bool udp = g_udp_enabled.load();
+        if (ImGui::Checkbox("UDP datagrams", &udp)) {
+            g_udp_enabled = udp;
+            save_settings_all();
+        }
+        {
+            HttpTransport& tr = transport_for(g_use_https);
+            ImGui::TextDisabled("%s  requests %llu  connects %llu  retries %llu  failed %llu",
+                tr.name(),
+                (unsigned long long)tr.requests.load(std::memory_order_relaxed),
+                (unsigned long long)tr.connects.load(std::memory_order_relaxed),
+                (unsigned long long)tr.retries.load(std::memory_order_relaxed),
+                (unsigned long long)tr.failures.load(std::memory_order_relaxed));
+
+            const uint64_t rw = g_gzip_recv_wire.load(std::memory_order_relaxed);
+            const uint64_t sw = g_gzip_sent_wire.load(std::memory_order_relaxed);
+            ImGui::TextDisabled("gzip in %.1f KB -> %.1f KB  out %.1f KB -> %.1f KB  errors %llu",
+                rw / 1024.0, g_gzip_recv_raw.load(std::memory_order_relaxed) / 1024.0,
+                g_gzip_sent_raw.load(std::memory_order_relaxed) / 1024.0, sw / 1024.0,
+                (unsigned long long)g_gzip_errors.load(std::memory_order_relaxed));
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Room updates");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        ImGui::TextDisabled("%s  events %llu  connects %llu",
+            g_room_stream_live ? "push" : "polling",
+            (unsigned long long)g_room_stream_events.load(std::memory_order_relaxed),
+            (unsigned long long)g_room_stream_connects.load(std::memory_order_relaxed));
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Datagrams");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        ImGui::TextDisabled("%s  sent %llu  received %llu  dropped %llu  joins %llu",
+            g_udp_status.load(std::memory_order_relaxed),
+            (unsigned long long)g_udp_sent.load(std::memory_order_relaxed),
+            (unsigned long long)g_udp_received.load(std::memory_order_relaxed),
+            (unsigned long long)g_udp_dropped.load(std::memory_order_relaxed),
+            (unsigned long long)g_udp_joins.load(std::memory_order_relaxed));
+        if (g_udp_rtt_ms.load(std::memory_order_relaxed) > 0.0) {
+            ImGui::TextDisabled("UDP ping %.1f ms (best %.1f)  HTTP /update round trip %.1f ms",
+                g_udp_rtt_ms.load(std::memory_order_relaxed),
+                g_udp_rtt_min_ms.load(std::memory_order_relaxed),
+                g_http_push_ms.load(std::memory_order_relaxed));
+        }
+        // peer changes, pushed to arrived here, on the relay clock
+        for (auto& path : { std::make_pair("datagrams", &g_fanout_udp), std::make_pair("stream", &g_fanout_sse) }) {
+            const uint64_t n = path.second->samples.load(std::memory_order_relaxed);
+            if (!n) continue;
+            ImGui::TextDisabled("Peer changes by %s: %.1f ms (best %.1f, %llu seen)", path.first,
+                path.second->avg_ms.load(std::memory_order_relaxed),
+                path.second->min_ms.load(std::memory_order_relaxed), (unsigned long long)n);
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Relay health");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        {
+            const double now = now_s();
+            const double hold = g_relay_hold_until_s.load(std::memory_order_relaxed) - now;
+            if (g_relay_open.load(std::memory_order_relaxed)) {
+                ImGui::TextColored(ImVec4(1.0f, 0.55f, 0.35f, 1.0f),
+                    "unreachable for %.0f s, probe %u in %.1f s",
+                    now - g_relay_down_since_s.load(std::memory_order_relaxed),
+                    g_relay_probes.load(std::memory_order_relaxed) + 1,
+                    std::max(0.0, g_relay_next_probe_s.load(std::memory_order_relaxed) - now));
+            }
+            else if (hold > 0.0) {
+                ImGui::TextDisabled("relay asked us to wait, %.1f s left", hold);
+            }
+            else {
+                ImGui::TextDisabled("ok");
+            }
+            const uint64_t outages = g_relay_outages.load(std::memory_order_relaxed);
+            if (outages || g_relay_throttled.load(std::memory_order_relaxed)) {
+                ImGui::TextDisabled("outages %llu (last %.1f s, %u probes)  throttled %llu",
+                    (unsigned long long)outages,
+                    g_relay_last_outage_s.load(std::memory_order_relaxed),
+                    g_relay_probes.load(std::memory_order_relaxed),
+                    (unsigned long long)g_relay_throttled.load(std::memory_order_relaxed));
+            }
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Relay clock");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        if (g_relay_clock_synced.load(std::memory_order_relaxed)) {
+            ImGui::TextDisabled("rtt %u ms, clock %+d ms vs relay",
+                g_relay_rtt_ms.load(std::memory_order_relaxed),
+                g_relay_wall_offset_ms.load(std::memory_order_relaxed));
+        }
+        else {
+            ImGui::TextDisabled("not synced (peers' own countdowns are shown)");
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Update rate");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        {
+            const int pull_ms = g_cadence_pull_ms.load(std::memory_order_relaxed);
+            char pull[32];
+            if (g_room_stream_live) std::snprintf(pull, sizeof(pull), "pushed");
+            else if (pull_ms > 0) std::snprintf(pull, sizeof(pull), "%d ms", pull_ms);
+            else std::snprintf(pull, sizeof(pull), "paused");
+            ImGui::TextDisabled("%s: push every %d ms, pull %s  (%u pushes last min)",
+                g_cadence_reason.load(std::memory_order_relaxed),
+                g_cadence_push_ms.load(std::memory_order_relaxed), pull,
+                g_pushes_min.load(std::memory_order_relaxed));
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Network");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        {
+            static bool s_exported = false;
+            bool any = false;
+            for (int i = 0; i < EP_COUNT; ++i) {
+                const EndpointStats& s = g_net_stats[i];
+                const uint64_t ok = s.ok.load(std::memory_order_relaxed);
+                const uint64_t rejected = s.rejected.load(std::memory_order_relaxed);
+                const uint64_t failed = s.failed.load(std::memory_order_relaxed);
+                const uint64_t n = ok + rejected + failed;
+                if (!n) continue;
+                any = true;
+
+                const uint64_t fresh = s.fresh.load(std::memory_order_relaxed);
+                const uint64_t parses = s.parses.load(std::memory_order_relaxed);
+                const uint64_t locks = s.locks.load(std::memory_order_relaxed);
+                ImGui::TextDisabled("%-10s %llu ok  %llu 4xx  %llu failed   avg %.1f  p50 %.0f  p90 %.0f  p99 %.0f  max %.0f ms",
+                    NET_ENDPOINT_NAMES[i], (unsigned long long)ok, (unsigned long long)rejected,
+                    (unsigned long long)failed,
+                    s.latency_us.load(std::memory_order_relaxed) / 1000.0 / (double)n,
+                    net_percentile_ms(s, 0.50), net_percentile_ms(s, 0.90), net_percentile_ms(s, 0.99),
+                    s.latency_max_us.load(std::memory_order_relaxed) / 1000.0);
+
+                float bars[NET_HIST_BUCKETS];
+                for (int b = 0; b < NET_HIST_BUCKETS; ++b)
+                    bars[b] = (float)s.hist[b].load(std::memory_order_relaxed);
+                ImGui::PlotHistogram(("##sqcd_lat" + std::to_string(i)).c_str(), bars, NET_HIST_BUCKETS,
+                    0, nullptr, 0.f, 3.4e38f, ImVec2(120.f, 24.f));
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("latency buckets: <=1 2 5 10 20 50 100 200 500 1000 2000 >2000 ms");
+                ImGui::SameLine();
+                ImGui::TextDisabled("in %.1f KB  out %.1f KB  new conn %llu (avg %.1f ms)  parse %.0f us  g_mutex %.0f us",
+                    s.bytes_in.load(std::memory_order_relaxed) / 1024.0,
+                    s.bytes_out.load(std::memory_order_relaxed) / 1024.0,
+                    (unsigned long long)fresh,
+                    fresh ? s.fresh_us.load(std::memory_order_relaxed) / 1000.0 / (double)fresh : 0.0,
+                    parses ? (double)s.parse_us.load(std::memory_order_relaxed) / (double)parses : 0.0,
+                    locks ? (double)s.lock_us.load(std::memory_order_relaxed) / (double)locks : 0.0);
+
+                const double fail_s = s.last_fail_s.load(std::memory_order_relaxed);
+                if (fail_s > 0.0) {
+                    const int st = s.last_fail_status.load(std::memory_order_relaxed);
+                    if (st) ImGui::TextDisabled("           last failure: HTTP %d, %.0f s ago", st, now_s() - fail_s);
+                    else ImGui::TextDisabled("           last failure: no response, %.0f s ago", now_s() - fail_s);
+                }
+            }
+            if (!any) ImGui::TextDisabled("no requests yet");
+
+            if (ImGui::Button("Export##sqcd_netexp")) {
+                export_net_stats();
+                s_exported = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset##sqcd_netreset")) {
+                reset_net_stats();
+                s_exported = false;
+            }
+            if (s_exported) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("wrote arcdps_cooldowns_netstats.json");
+            }
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Room decoding");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        {
+            const uint32_t samples = g_decode_sample_count.load(std::memory_order_relaxed);
+            DecodeBenchReport rep;
+            {
+                std::lock_guard<std::mutex> lk(g_decode_bench_mutex);
+                rep = g_decode_bench;
+            }
+            if (!samples) {
+                ImGui::TextDisabled("no full JSON replies recorded yet");
+            }
+            else {
+                ImGui::TextDisabled("%u recorded replies", samples);
+                ImGui::SameLine();
+                if (ImGui::Button("Benchmark##sqcd_decbench") && !rep.running) start_decode_bench();
+            }
+            if (rep.running) {
+                ImGui::TextDisabled("running...");
+            }
+            else if (rep.replies) {
+                ImGui::TextDisabled("streaming %.1f us, DOM %.1f us per reply (%.1fx), %.0f peers avg%s",
+                    rep.sax_us, rep.dom_us, rep.sax_us > 0.0 ? rep.dom_us / rep.sax_us : 0.0, rep.peers,
+                    rep.mismatches ? "  RESULTS DIFFER" : "");
+            }
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Update traffic");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        ImGui::TextDisabled("%s  %.1f KB/min  (full payloads ~%.1f KB/min)  resyncs %llu",
+            g_push_delta_ok ? "delta" : "full",
+            g_push_bytes_min.load(std::memory_order_relaxed) / 1024.0,
+            g_push_full_bytes_min.load(std::memory_order_relaxed) / 1024.0,
+            (unsigned long long)g_push_resyncs.load(std::memory_order_relaxed));
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Skill metadata");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        {
+            const uint64_t batches = g_skill_batches.load(std::memory_order_relaxed);
+            ImGui::TextDisabled("cached %u (%u refreshing)  queued %u  in flight %u  "
+                "batches %llu  failed %llu  latency %u ms (avg %llu, max %u)",
+                g_skill_cache_loaded.load(std::memory_order_relaxed),
+                g_skill_cache_refreshed.load(std::memory_order_relaxed),
+                g_cd_queue_depth.load(std::memory_order_relaxed),
+                g_skill_batches_inflight.load(std::memory_order_relaxed),
+                (unsigned long long)batches,
+                (unsigned long long)g_skill_batch_failures.load(std::memory_order_relaxed),
+                g_skill_latency_last_ms.load(std::memory_order_relaxed),
+                (unsigned long long)(batches ? g_skill_latency_sum_ms.load(std::memory_order_relaxed) / batches : 0),
+                g_skill_latency_max_ms.load(std::memory_order_relaxed));
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Combat queue");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        ImGui::TextDisabled("depth %u / %u  peak %u  dropped %llu",
+            g_combat_queue.depth(), COMBAT_QUEUE_CAP,
+            g_combat_queue.peak.load(std::memory_order_relaxed),
+            (unsigned long long)g_combat_queue.dropped.load(std::memory_order_relaxed));
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Skill class cache");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        ImGui::TextDisabled("hits %llu  misses %llu",
+            (unsigned long long)g_skill_class_hits.load(std::memory_order_relaxed),
+            (unsigned long long)g_skill_class_misses.load(std::memory_order_relaxed));
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Event clock");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        {
+            ClockMap cm;
+            {
+                std::scoped_lock lk(g_mutex);
+                cm = g_clock_map;
+            }
+            if (cm.valid) {
+                ImGui::TextDisabled("offset %.3fs  drift %+.0fppm  delay %.1fms (jitter %.1fms)",
+                    cm.a, cm.drift * 1e6,
+                    cm.delay_mean * 1000.0, std::sqrt(cm.delay_var) * 1000.0);
+            }
+            else {
+                ImGui::TextDisabled("no events yet");
+            }
+        }
+
+        ImGui::NextColumn();
+
+        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.70f, 0.70f, 0.70f, 1.0f));
+        ImGui::TextUnformatted("Combat capture");
+        ImGui::PopStyleColor();
+
+        ImGui::NextColumn();
+
+        {
+            bool capture = g_capture_enabled.load(std::memory_order_relaxed);
+            uint64_t captured = 0;
+            if (ImGui::Checkbox("Capture##sqcd_cap", &capture)) {
+                set_capture(capture);
+            }
+            {
+                std::scoped_lock lk(g_mutex);
+                captured = g_capture_count;
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled("%llu events", (unsigned long long)captured);
+
+            ImGui::PushItemWidth(120.f);
+            ImGui::SliderFloat("speed (0 = max)##sqcd_rs", &g_replay_speed, 0.f, 8.f, "%.1fx");
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            if (ImGui::Button("Replay##sqcd_replay")) {
+                start_replay(g_replay_speed);
+            }
+
+            ReplayReport rep;
+            {
+                std::lock_guard<std::mutex> lk(g_replay_mutex);
+                rep = g_replay_report;
+            }
+            if (rep.running) {
+                ImGui::TextDisabled("replaying...");
+            }
+            else if (!rep.error.empty()) {
+                ImGui::TextDisabled("replay: %s", rep.error.c_str());
+            }
+            else if (rep.events) {
+                ImGui::TextDisabled("%llu ev in %.2fs (%.0f ev/s), %zu timers",
+                    (unsigned long long)rep.events, rep.wall_s, rep.events_per_s, rep.timers);
+                ImGui::TextDisabled("enqueue to timer p50 %.1fus p90 %.1fus p99 %.1fus max %.1fus",
+                    rep.p50_us, rep.p90_us, rep.p99_us, rep.max_us);
+            }
+        }
+
+        ImGui::NextColumn();
+
         ImGui::Columns(1);
     }
 
@@ -2023,8 +7244,19 @@ static arcdps_exports* mod_init() {
     g_exp.wnd_filter = nullptr;
     g_exp.options_windows = (void*)&options_windows;
 
+    if (g_ready_listeners.empty()) {
+        subscribe_ready_transitions(&on_ready_flash);
+        subscribe_ready_transitions(&on_ready_push);
+        subscribe_ready_transitions(&on_ready_sound);
+    }
+
     g_net_alive = true;
+    g_replay_stop = false;
+    reset_net_stats();
+    start_skill_workers();
     g_net_thread = std::thread(net_loop);
+    g_stream_thread = std::thread(room_stream_loop);
+    g_udp_thread = std::thread(udp_loop);
 
     return &g_exp;
 }
@@ -2035,14 +7267,45 @@ static void mod_release() {
     }
     g_initialized = false;
 
+    // Everything below is bounded: the threads wait in short slices or on
+    // condition variables, and cancelling the transports fails whatever
+    // request or stream is in flight right away instead of at its deadline.
+    const auto stop_t0 = std::chrono::steady_clock::now();
     g_net_alive = false;
+    g_replay_stop = true;
+    g_net_wake_cv.notify_all();
+    for (HttpTransport* t : g_transports) t->cancel_stream();
+    for (HttpTransport* t : g_transports) t->cancel_requests();
     if (g_net_thread.joinable()) {
         g_net_thread.join();
     }
+    if (g_stream_thread.joinable()) {
+        g_stream_thread.join();
+    }
+    if (g_udp_thread.joinable()) {
+        g_udp_thread.join();
+    }
+    stop_skill_workers();
+    if (g_replay_thread.joinable()) {
+        g_replay_thread.join();
+    }
+    if (g_decode_bench_thread.joinable()) {
+        g_decode_bench_thread.join();
+    }
+    free_peer_snapshots();
+    {
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "[sqcd] background threads stopped in %.0f ms",
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stop_t0).count());
+        arc_log(buf);
+    }
+    set_capture(false);
+    for (HttpTransport* t : g_transports) t->reset();
 
     save_settings_all();
 }
 
+#ifdef _WIN32
 extern "C" __declspec(dllexport)
 void* impl_get_init_addr(char* arcversion, void* imguictx, void* id3dptr,
     HINSTANCE arcdll, void* mallocfn, void* freefn, uint32_t d3dver) {
@@ -2060,3 +7323,4 @@ extern "C" __declspec(dllexport)
 void* impl_get_release_addr() {
     return (void*)&mod_release;
 }
+#endif
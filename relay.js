@@ -10,29 +10,93 @@
 //      pluginVer,        // string, e.g. "0.90"
 //      subgroup,         // squad subgroup index (int, 0 if none)
 //      entries: [        // cooldown entries
-//        { label, ready, left, skillid }
+//        { label, ready, left, skillid, readyAt? }
 //      ],
+//      rtt?, clockOffset?,   // the client's measured /time round trip and
+//                            // clock offset vs the relay (ms), if synced
 //      groupOrder: {     // optional, per-profession order
 //        "1": ["clientA", "clientB"],
 //        "7": ["clientX", "clientY"]
-//      }
+//      },
+//      seq,              // optional; when present the reply carries { ack: seq }
+//      sentAt?           // when the client sent it, in ms on this relay's clock
 //    }
 //
-//  GET /aggregate?room=bags
+//    Delta form, once a full payload was acknowledged:
+//    {
+//      room, clientId, seq, sentAt?,
+//      base,             // seq of the last acknowledged payload
+//      name?, prof?, subgroup?, elite?, account?,   // only fields that changed
+//      rtt?, clockOffset?,
+//      entryCount?,      // new number of entries, if it changed
+//      entryDelta?: [{ i, label?, ready?, left?, skillid?, readyAt? }]
+//    }
+//    -> { ok, assignedName, ack } or { ok, resync: true } when `base` does not
+//       match the stored state; the client then sends a full payload.
+//
+//  GET /aggregate?room=bags[&epoch=E&since=V]
 //    {
 //      room,
+//      epoch, version,   // relay process id and room version of this reply
 //      peers: [{
 //        clientId,
 //        name,
 //        prof,
 //        pluginVer,
 //        subgroup,
-//        entries: [{ label, ready, left, skillid }]
+//        rtt, clockOffset,   // null when the peer has not synced its clock
+//        entries: [{ label, ready, left, skillid, readyAt }]
 //      }],
 //      groupOrder?: { "1": [...], ... }
 //    }
+//    With epoch/since from an earlier reply: 304 if the room is unchanged,
+//    otherwise only changed peers plus `since` and `left: [clientId...]`
+//    (groupOrder only if it changed). Unknown epoch or a since older than the
+//    kept tombstones gets the full room.
+//
+//  readyAt is when the entry comes off cooldown, in ms on this relay's clock
+//  (Date.now()); viewers synced to the relay count down from it instead of
+//  trusting `left`, which was computed before the network delay. Entries
+//  without it (older clients, unsynced clocks) carry null.
+//
+//  Binary wire format: /update bodies sent as application/x-sqcd and
+//  /aggregate requests with "Accept: application/x-sqcd" (plus
+//  &dict=<id>.<count>) use the compact encoding described below instead of
+//  JSON. Replies to /update stay JSON. Version 2 adds the clock fields and
+//  readyAt; /aggregate answers in version 2 only when Accept carries "v=2".
+//
+//  Compression: /update bodies may be sent with "Content-Encoding: gzip" (the
+//  body parsers inflate them). /aggregate replies of GZIP_MIN_BYTES or more
+//  are gzipped for clients sending "Accept-Encoding: gzip".
+//
+//  GET /events?room=bags
+//    Server-Sent Events stream for the room:
+//      event: snapshot   data: same body as /aggregate (sent on connect)
+//      event: peer       data: one peer object, sent on every /update that
+//                              changes it, plus the update's sentAt if it had one
+//      event: leave      data: { clientId } when a peer is pruned
+//      event: order      data: groupOrder, when a client changes it
+//    Comment pings keep the stream alive; clients fall back to /aggregate
+//    polling whenever it drops.
 //
-//  GET /health -> { ok: true }
+//  POST /udp/join { room, clientId } -> { ok, token, port }
+//    Registers the client for the UDP path (404 when the relay runs without
+//    it). The client then sends its state as datagrams to `port` carrying
+//    `token`, and receives the room's peer changes as datagrams. See "room
+//    datagrams" below; everything else stays on HTTP.
+//
+//    The UDP path is off unless UDP_PORT is set. Datagrams don't go through
+//    the reverse proxy, so the socket binds to UDP_HOST (default 0.0.0.0,
+//    not HOST) and UDP_PORT has to be reachable from the internet.
+//
+//  GET /time -> { now }   relay clock in ms, sampled by clients to measure
+//                         round trip and offset
+//
+//  GET /health -> { ok: true }   never rate limited; clients probe it while
+//                               the relay looks down
+//
+//  Rate limiting: the routes above (except /health) answer 429 with
+//  Retry-After (seconds) to an address over RATE_LIMIT_RPS / RATE_LIMIT_BURST.
 //
 //  GET /download/arcdps_cooldowns.dll
 //    - downloads local DLL file
@@ -42,16 +106,81 @@
 
 const express = require('express');
 const path = require('path');
+const zlib = require('zlib');
+const dgram = require('dgram');
+const crypto = require('crypto');
 
 const app = express();
+// behind the local reverse proxy, req.ip is the client from X-Forwarded-For
+app.set('trust proxy', 'loopback');
+
+// ---- rate limiting ----
+//
+// Token bucket per client address over the API routes: RATE_LIMIT_RPS
+// requests a second sustained, RATE_LIMIT_BURST at once (RATE_LIMIT_RPS=0
+// turns it off). Over the limit a request gets 429 with Retry-After in
+// seconds; the plugin then holds all its relay traffic that long. /health
+// stays unlimited so clients backing off can always probe it.
+const RATE_LIMIT_RPS = Number(process.env.RATE_LIMIT_RPS || 100);
+const RATE_LIMIT_BURST = Number(process.env.RATE_LIMIT_BURST || 200);
+const RATE_LIMITED = new Set(['/update', '/aggregate', '/events', '/time', '/udp/join']);
+const RATE_BUCKET_IDLE_MS = 60000;
+
+// address -> { tokens, ts }
+const rateBuckets = new Map();
+
+app.use((req, res, next) => {
+  if (!RATE_LIMIT_RPS || !RATE_LIMITED.has(req.path)) return next();
+  const key = req.ip || req.socket.remoteAddress;
+  const now = Date.now();
+  let b = rateBuckets.get(key);
+  if (!b) {
+    b = { tokens: RATE_LIMIT_BURST, ts: now };
+    rateBuckets.set(key, b);
+  }
+  b.tokens = Math.min(RATE_LIMIT_BURST, b.tokens + (now - b.ts) * RATE_LIMIT_RPS / 1000);
+  b.ts = now;
+  if (b.tokens >= 1) {
+    b.tokens -= 1;
+    return next();
+  }
+  res.set('Retry-After', String(Math.max(1, Math.ceil((1 - b.tokens) / RATE_LIMIT_RPS))));
+  res.status(429).json({ ok: false, err: 'rate limited' });
+});
+
 app.use(express.json({ limit: '64kb' }));
 
+// optional compact binary encoding, see "binary wire format" below
+const WIRE_TYPE = 'application/x-sqcd';
+app.use(express.raw({ type: WIRE_TYPE, limit: '64kb' }));
+
 // roomName -> Map(clientId -> { name, prof, pluginVer, subgroup, entries, ts })
 const rooms = new Map();
 
 // roomName -> { [prof]: [clientId, ...] }
 const roomOrders = new Map();
 
+// roomName -> Set(res) of open /events streams
+const roomStreams = new Map();
+
+// Room versions for incremental /aggregate. Every change to a room (peer
+// updated, peer left, order changed) takes the next version; each peer
+// record remembers the version of its last change in `ver`, departures are
+// kept as tombstones. RELAY_EPOCH changes on restart so clients never mix
+// versions from two relay processes.
+// roomName -> { version, orderVersion, left: Map(clientId -> version), horizon }
+const roomVersions = new Map();
+const RELAY_EPOCH = 1 + Math.floor(Math.random() * 0x7ffffffe);
+const LEFT_KEEP = 256;  // tombstones per room; older `since` values get a full reply
+const STREAM_PING_MS = 5000;
+
+// Encoded /aggregate replies for the current version of each room, so a
+// version is serialized (and gzipped) once however many clients poll it.
+// roomName -> { version, replies: Map(key -> { type, raw, gz }) }
+const aggregateCache = new Map();
+const AGGREGATE_CACHE_KEYS = 64;  // distinct since/format/dict combinations per version
+const GZIP_MIN_BYTES = 1024;      // smaller replies go out as they are
+
 // optional: assign default names like "spirit 1", "spirit 2"
 function assignName(room, provided) {
   if (provided && provided.trim().length) return provided;
@@ -72,90 +201,925 @@ function getRoom(room) {
   return rooms.get(room);
 }
 
+function roomState(room) {
+  let st = roomVersions.get(room);
+  if (!st) {
+    st = { version: 0, orderVersion: 0, left: new Map(), horizon: 0 };
+    roomVersions.set(room, st);
+  }
+  return st;
+}
+
+function touchPeer(room, clientId, v) {
+  const st = roomState(room);
+  st.left.delete(clientId);
+  v.ver = ++st.version;
+}
+
+function touchOrder(room) {
+  const st = roomState(room);
+  st.orderVersion = ++st.version;
+}
+
+function markLeft(room, clientId) {
+  const st = roomState(room);
+  st.left.delete(clientId);
+  st.left.set(clientId, ++st.version);
+  if (st.left.size > LEFT_KEEP) {
+    const [oldest, ver] = st.left.entries().next().value;
+    st.left.delete(oldest);
+    st.horizon = ver;
+  }
+}
+
+// `left` of a running cooldown changes on every push. Viewers count down from
+// readyAt when an entry has one, so `left` doesn't count as a change then, and
+// otherwise only in whole seconds (the plugin diffs its deltas the same way).
+function leftSeconds(e) {
+  return e.readyAt == null && typeof e.left === 'number' ? Math.ceil(e.left) : null;
+}
+
+function sameEntry(a, b) {
+  return a.label === b.label && a.ready === b.ready && a.skillid === b.skillid &&
+    a.readyAt === b.readyAt && leftSeconds(a) === leftSeconds(b);
+}
+
+function samePeer(a, b) {
+  return a.name === b.name && a.prof === b.prof && a.pluginVer === b.pluginVer &&
+    a.subgroup === b.subgroup && a.elite === b.elite && a.account === b.account &&
+    a.rtt === b.rtt && a.clockOffset === b.clockOffset &&
+    a.entries.length === b.entries.length && a.entries.every((e, i) => sameEntry(e, b.entries[i]));
+}
+
+// A change as fanned out: the peer plus when its owner sent it, so receivers
+// can time publish to arrival.
+function peerEvent(clientId, v) {
+  const p = peerView(clientId, v);
+  if (v.sentAt != null) p.sentAt = v.sentAt;
+  return p;
+}
+
+function peerView(clientId, v) {
+  return {
+    clientId,
+    name: v.name || 'unknown',
+    prof: v.prof || 0,
+    pluginVer: v.pluginVer || null,
+    subgroup: v.subgroup || 0,
+    account: v.account || null,  // NEW
+    entries: v.entries || [],
+    elite: v.elite || 0,
+    rtt: v.rtt ?? null,
+    clockOffset: v.clockOffset ?? null
+  };
+}
+
+// Full room, or with `since` (a version of this room in this epoch) only the
+// peers that changed after it, the ids that left after it, and the order if
+// it changed; such replies carry `since`. Returns null when nothing changed.
+function roomSnapshot(room, since) {
+  const m = getRoom(room);
+  const st = roomState(room);
+  since = partialSince(room, since);
+  const partial = since !== undefined;
+  if (partial && since === st.version) return null;
+
+  const peers = [];
+  for (const [clientId, v] of m.entries()) {
+    if (!partial || v.ver > since) peers.push(peerView(clientId, v));
+  }
+
+  const body = { room, epoch: RELAY_EPOCH, version: st.version, peers };
+  if (partial) {
+    body.since = since;
+    const left = [];
+    for (const [clientId, ver] of st.left) {
+      if (ver > since) left.push(clientId);
+    }
+    if (left.length) body.left = left;
+  }
+
+  const order = roomOrders.get(room);
+  if (order && (!partial || st.orderVersion > since)) {
+    body.groupOrder = order;
+  }
+  return body;
+}
+
+// `since` if a partial reply can be built from it, otherwise undefined.
+function partialSince(room, since) {
+  const st = roomState(room);
+  return Number.isInteger(since) && since >= st.horizon && since <= st.version ? since : undefined;
+}
+
+// The cached reply for `key` at the room's current version, built on a miss.
+function cachedAggregate(room, key, build) {
+  const version = roomState(room).version;
+  let c = aggregateCache.get(room);
+  if (!c || c.version !== version) {
+    c = { version, replies: new Map() };
+    aggregateCache.set(room, c);
+  }
+  let reply = c.replies.get(key);
+  if (!reply) {
+    if (c.replies.size >= AGGREGATE_CACHE_KEYS) c.replies.clear();
+    reply = build();
+    c.replies.set(key, reply);
+  }
+  return reply;
+}
+
+// `since` from the query, if it belongs to this relay process.
+function sinceParam(query) {
+  if (Number(query.epoch) !== RELAY_EPOCH) return undefined;
+  const since = Number(query.since);
+  return Number.isInteger(since) ? since : undefined;
+}
+
+function broadcast(room, event, data) {
+  const streams = roomStreams.get(room);
+  if (!streams || !streams.size) return;
+  const msg = `event: ${event}\ndata: ${JSON.stringify(data)}\n\n`;
+  for (const res of streams) res.write(msg);
+}
+
 // prune clients not updated in 15s
 function prune() {
   const cutoff = Date.now() - 15000;
-  for (const m of rooms.values()) {
+  for (const [room, m] of rooms.entries()) {
     for (const [cid, v] of m.entries()) {
-      if (v.ts < cutoff) m.delete(cid);
+      if (v.ts < cutoff) {
+        m.delete(cid);
+        markLeft(room, cid);
+        broadcast(room, 'leave', { clientId: cid });
+      }
+    }
+    if (!m.size) aggregateCache.delete(room);
+  }
+  const udpCutoff = Date.now() - UDP_IDLE_MS;
+  for (const [token, member] of udpMembers) {
+    if (member.ts < udpCutoff) dropUdpMember(token, member);
+  }
+  const bucketCutoff = Date.now() - RATE_BUCKET_IDLE_MS;
+  for (const [key, b] of rateBuckets) {
+    if (b.ts < bucketCutoff) rateBuckets.delete(key);
+  }
+}
+
+// ---- binary wire format ----
+//
+// Mirrors the "binary wire format" section of arcdps_cooldowns.cpp: LEB128
+// varints, varint-length strings, `left` quantized to WIRE_LEFT_STEP (0 = null)
+// and string dictionaries for names/labels/accounts. /update uses the client's
+// per-session dictionary (stored on the client record); /aggregate uses a
+// per-room dictionary and only sends strings the client has not seen.
+// Version 2 adds the clock (varint rtt+1, zigzag offset) after account in
+// full updates and per aggregate peer, PF_CLOCK (last) in deltas, and a
+// varint readyAt (0 = none) at the end of every entry.
+
+const WIRE_MAGIC = 0x51;   // 'Q'
+const WIRE_VERSION = 2;   // highest version we read and write
+const WIRE_UPDATE_FULL = 0;
+const WIRE_UPDATE_DELTA = 1;
+const WIRE_AGGREGATE = 2;
+const WIRE_LEFT_STEP = 0.05;
+const WIRE_ROOM_DICT_MAX = 4096;
+// Entries per client. The plugin shares at most this many rows (its delta
+// encoder keeps one mask byte per row, PUSH_ENTRIES_MAX); more is refused.
+const ENTRIES_MAX = 256;
+
+const PF_NAME = 1, PF_PROF = 2, PF_SUBGROUP = 4, PF_ELITE = 8, PF_ACCOUNT = 16, PF_COUNT = 32,
+  PF_CLOCK = 64;
+const PE_LABEL = 1, PE_READY = 2, PE_LEFT = 4, PE_SKILLID = 8, PE_READY_AT = 16;
+
+class WireReader {
+  constructor(buf) { this.buf = buf; this.pos = 0; }
+  u8() {
+    if (this.pos >= this.buf.length) throw new Error('truncated');
+    return this.buf[this.pos++];
+  }
+  varint() {
+    let v = 0, mul = 1;
+    for (let i = 0; i < 8; i++) {
+      const b = this.u8();
+      v += (b & 0x7f) * mul;
+      if (!(b & 0x80)) return v;
+      mul *= 128;
+    }
+    throw new Error('bad varint');
+  }
+  svarint() {
+    const z = this.varint();
+    return z % 2 ? -(z + 1) / 2 : z / 2;
+  }
+  str() {
+    const n = this.varint();
+    if (this.pos + n > this.buf.length) throw new Error('truncated');
+    const s = this.buf.toString('utf8', this.pos, this.pos + n);
+    this.pos += n;
+    return s;
+  }
+  left() {
+    const q = this.varint();
+    return q === 0 ? null : Math.round((q - 1) * WIRE_LEFT_STEP * 1000) / 1000;
+  }
+}
+
+class WireWriter {
+  constructor() { this.buf = Buffer.allocUnsafe(1024); this.pos = 0; }
+  reserve(n) {
+    if (this.pos + n <= this.buf.length) return;
+    const next = Buffer.allocUnsafe(Math.max(this.buf.length * 2, this.pos + n));
+    this.buf.copy(next, 0, 0, this.pos);
+    this.buf = next;
+  }
+  u8(v) { this.reserve(1); this.buf[this.pos++] = v; }
+  varint(v) {
+    v = Math.max(0, Math.floor(v)) || 0;
+    this.reserve(10);
+    while (v >= 0x80) {
+      this.buf[this.pos++] = (v % 128) | 0x80;
+      v = Math.floor(v / 128);
+    }
+    this.buf[this.pos++] = v;
+  }
+  svarint(v) { v = Math.trunc(v) || 0; this.varint(v < 0 ? -2 * v - 1 : 2 * v); }
+  str(s) {
+    const n = Buffer.byteLength(s, 'utf8');
+    this.varint(n);
+    this.reserve(n);
+    this.buf.write(s, this.pos, n, 'utf8');
+    this.pos += n;
+  }
+  left(v) { this.varint(typeof v === 'number' && v >= 0 ? Math.round(v / WIRE_LEFT_STEP) + 1 : 0); }
+  done() { return this.buf.subarray(0, this.pos); }
+}
+
+function wireResync() {
+  const e = new Error('unknown dictionary entry');
+  e.resync = true;
+  return e;
+}
+
+// Decodes a binary /update into the same object shape as the JSON payload.
+// Returns { body, wire } where `wire` is the client's dictionary to keep on
+// its record; throws with .resync when the dictionary is out of step. The
+// stored dictionary is never modified here: new definitions go into a copy
+// the caller keeps only once the whole update has been accepted.
+function decodeUpdate(buf) {
+  const r = new WireReader(buf);
+  if (r.u8() !== WIRE_MAGIC) throw new Error('bad header');
+  const version = r.u8();
+  if (version < 1 || version > WIRE_VERSION) throw new Error('bad header');
+  const kind = r.u8();
+  if (kind !== WIRE_UPDATE_FULL && kind !== WIRE_UPDATE_DELTA) throw new Error('bad kind');
+
+  const body = { room: r.str(), clientId: r.str() };
+  const session = r.varint();
+  body.seq = r.varint();
+  if (kind === WIRE_UPDATE_DELTA) body.base = r.varint();
+
+  const stored = rooms.get(body.room)?.get(body.clientId);
+  const known = stored && stored.wire && stored.wire.session === session ? stored.wire.strs : [];
+  const first = r.varint();
+  if (first > known.length) throw wireResync();
+  const ndefs = r.varint();
+  let strs = known;
+  if (ndefs > 0 || first < known.length) {
+    strs = known.slice(0, first);
+    for (let n = ndefs; n > 0; n--) strs.push(r.str());
+  }
+
+  const ref = () => {
+    const i = r.varint();
+    if (i >= strs.length) throw wireResync();
+    return strs[i];
+  };
+  const optRef = () => {
+    const i = r.varint();
+    if (i === 0) return null;
+    if (i - 1 >= strs.length) throw wireResync();
+    return strs[i - 1];
+  };
+  const entry = (mask, e) => {
+    if (mask & PE_LABEL) e.label = ref();
+    if (mask & PE_READY) e.ready = r.u8() !== 0;
+    if (mask & PE_LEFT) e.left = r.left();
+    if (mask & PE_SKILLID) e.skillid = r.varint();
+    if (mask & PE_READY_AT) e.readyAt = r.varint() || null;
+    return e;
+  };
+  const clock = () => {
+    const rtt = r.varint();
+    const offset = r.svarint();
+    body.rtt = rtt ? rtt - 1 : null;
+    body.clockOffset = rtt ? offset : null;
+  };
+  const ALL = PE_LABEL | PE_READY | PE_LEFT | PE_SKILLID | (version >= 2 ? PE_READY_AT : 0);
+
+  if (kind === WIRE_UPDATE_FULL) {
+    body.pluginVer = r.str();
+    body.name = ref();
+    body.prof = r.varint();
+    body.subgroup = r.varint();
+    body.elite = r.varint();
+    body.account = optRef();
+    if (version >= 2) clock();
+    const count = r.varint();
+    if (count > ENTRIES_MAX) throw new Error('too many entries');
+    body.entries = [];
+    for (let n = count; n > 0; n--) {
+      body.entries.push(entry(ALL, {}));
+    }
+  } else {
+    const fm = r.u8();
+    if (fm & PF_NAME) body.name = ref();
+    if (fm & PF_PROF) body.prof = r.varint();
+    if (fm & PF_SUBGROUP) body.subgroup = r.varint();
+    if (fm & PF_ELITE) body.elite = r.varint();
+    if (fm & PF_ACCOUNT) body.account = optRef() || '';
+    if (fm & PF_COUNT) body.entryCount = r.varint();
+    if (fm & PF_CLOCK) clock();
+    const count = r.varint();
+    if (count > ENTRIES_MAX) throw new Error('too many entries');
+    const delta = [];
+    for (let n = count; n > 0; n--) {
+      const i = r.varint();
+      if (i >= ENTRIES_MAX) throw new Error('bad entry');
+      delta.push(entry(r.u8() & ALL, { i }));
+    }
+    if (delta.length) body.entryDelta = delta;
+  }
+
+  const norders = r.varint();
+  if (norders > 0) {
+    body.groupOrder = {};
+    for (let n = norders; n > 0; n--) {
+      const prof = r.varint();
+      const ids = [];
+      for (let k = r.varint(); k > 0; k--) ids.push(r.str());
+      body.groupOrder[prof] = ids;
+    }
+  }
+  if (r.pos < buf.length) body.sentAt = r.varint();
+
+  return { body, wire: { session, strs } };
+}
+
+// roomName -> { id, strs, index }
+const roomDicts = new Map();
+
+function roomDict(room) {
+  let d = roomDicts.get(room);
+  if (!d || d.strs.length > WIRE_ROOM_DICT_MAX) {
+    // a new id tells clients to drop what they have and start over
+    d = { id: 1 + Math.floor(Math.random() * 0x7ffffffe), strs: [], index: new Map() };
+    roomDicts.set(room, d);
+  }
+  return d;
+}
+
+function dictRef(d, s) {
+  let i = d.index.get(s);
+  if (i === undefined) {
+    i = d.strs.length;
+    d.strs.push(s);
+    d.index.set(s, i);
+  }
+  return i;
+}
+
+// `known` is the client's "dict=<id>.<count>" query value; `snap` comes from
+// roomSnapshot() and may be partial; `version` is 1 or 2 (see wireVersion).
+function encodeAggregate(room, known, snap, version) {
+  const d = roomDict(room);
+
+  // intern everything first so the new definitions go in front of the body
+  const refs = snap.peers.map(p => ({
+    name: dictRef(d, p.name),
+    account: p.account ? dictRef(d, p.account) + 1 : 0,
+    pluginVer: p.pluginVer ? dictRef(d, p.pluginVer) + 1 : 0,
+    labels: p.entries.map(e => dictRef(d, e.label))
+  }));
+
+  let first = 0;
+  if (typeof known === 'string') {
+    const [kid, kcount] = known.split('.').map(Number);
+    if (kid === d.id && Number.isInteger(kcount) && kcount <= d.strs.length) first = kcount;
+  }
+
+  const w = new WireWriter();
+  w.u8(WIRE_MAGIC);
+  w.u8(version);
+  w.u8(WIRE_AGGREGATE);
+  w.varint(d.id);
+  w.varint(first);
+  w.varint(d.strs.length - first);
+  for (let i = first; i < d.strs.length; i++) w.str(d.strs[i]);
+  w.str(room);
+  w.varint(snap.epoch);
+  w.varint(snap.version);
+  w.u8(snap.since !== undefined ? 1 : 0);
+  if (snap.since !== undefined) {
+    const left = snap.left || [];
+    w.varint(left.length);
+    for (const id of left) w.str(id);
+  }
+
+  const order = snap.groupOrder || {};
+  const profs = Object.keys(order).filter(k => Array.isArray(order[k]));
+  w.varint(profs.length);
+  for (const k of profs) {
+    w.varint(Number(k) || 0);
+    w.varint(order[k].length);
+    for (const id of order[k]) w.str(String(id));
+  }
+
+  w.varint(snap.peers.length);
+  snap.peers.forEach((p, pi) => {
+    const pr = refs[pi];
+    w.str(p.clientId);
+    w.varint(pr.name);
+    w.varint(pr.account);
+    w.varint(pr.pluginVer);
+    w.varint(p.prof);
+    w.varint(p.subgroup);
+    w.varint(p.elite);
+    if (version >= 2) {
+      w.varint(p.rtt != null ? p.rtt + 1 : 0);
+      w.svarint(p.clockOffset || 0);
+    }
+    w.varint(p.entries.length);
+    p.entries.forEach((e, ei) => {
+      w.varint(pr.labels[ei]);
+      w.u8(e.ready ? 1 : 0);
+      w.left(e.left);
+      w.varint(e.skillid);
+      if (version >= 2) w.varint(e.readyAt || 0);
+    });
+  });
+  return w.done();
+}
+
+// Binary /aggregate version for a request: clients that read version 2 say
+// so with "v=2" in Accept, everyone else gets version 1.
+function wireVersion(accept) {
+  return /;\s*v=2\b/.test(accept) ? 2 : 1;
+}
+
+// readyAt and sentAt: ms on this relay's clock
+function cleanRelayMs(v) {
+  return typeof v === 'number' && Number.isFinite(v) && v > 0 ? Math.round(v) : null;
+}
+
+function cleanClock(v) {
+  return typeof v === 'number' && Number.isFinite(v) ? Math.round(v) : null;
+}
+
+function cleanEntry(e) {
+  return {
+    label: String(e.label || ''),
+    ready: !!e.ready,
+    left: typeof e.left === 'number' ? e.left : null,
+    skillid: typeof e.skillid === 'number' ? e.skillid : 0,
+    readyAt: cleanRelayMs(e.readyAt)
+  };
+}
+
+// Replaces the client's record with a full payload (entries already checked to
+// be an array); returns { v, changed }.
+function storeFull(room, clientId, body) {
+  const { name, entries, prof, pluginVer, subgroup, elite, account, rtt, clockOffset, seq, sentAt } = body;
+  const m = getRoom(room);
+  const prev = m.get(clientId);
+  const v = {
+    name: assignName(room, name),
+    prof: Number.isInteger(prof) ? prof : 0,
+    pluginVer: typeof pluginVer === 'string' ? pluginVer : null,
+    subgroup: Number.isInteger(subgroup) ? subgroup : 0,
+    elite: Number.isInteger(elite) ? elite : 0,
+    account: typeof account === 'string' ? account : null, // NEW
+    rtt: cleanClock(rtt),
+    clockOffset: cleanClock(clockOffset),
+    entries: entries.map(cleanEntry),
+    seq: Number.isInteger(seq) ? seq : null,  // null: client without delta support
+    sentAt: cleanRelayMs(sentAt),   // of this update; not part of the peer's state
+    ts: Date.now()
+  };
+  // full payloads from clients without deltas repeat unchanged state every tick
+  const changed = !prev || !samePeer(prev, v);
+  if (prev) v.ver = prev.ver;
+  m.set(clientId, v);
+  return { v, changed };
+}
+
+// Applies a delta payload to the stored client; returns true if anything changed.
+function applyDelta(room, v, d) {
+  let changed = false;
+
+  if (typeof d.name === 'string') { v.name = assignName(room, d.name); changed = true; }
+  if (Number.isInteger(d.prof)) { v.prof = d.prof; changed = true; }
+  if (Number.isInteger(d.subgroup)) { v.subgroup = d.subgroup; changed = true; }
+  if (Number.isInteger(d.elite)) { v.elite = d.elite; changed = true; }
+  if ('account' in d) { v.account = typeof d.account === 'string' && d.account ? d.account : null; changed = true; }
+  if ('rtt' in d) { v.rtt = cleanClock(d.rtt); changed = true; }
+  if ('clockOffset' in d) { v.clockOffset = cleanClock(d.clockOffset); changed = true; }
+
+  if (Number.isInteger(d.entryCount) && d.entryCount >= 0 && d.entryCount <= ENTRIES_MAX) {
+    while (v.entries.length < d.entryCount) v.entries.push(cleanEntry({}));
+    v.entries.length = d.entryCount;
+    changed = true;
+  }
+
+  if (Array.isArray(d.entryDelta)) {
+    for (const ed of d.entryDelta) {
+      const e = ed && Number.isInteger(ed.i) ? v.entries[ed.i] : undefined;
+      if (!e) continue;
+      const before = { ...e };
+      if ('label' in ed) e.label = String(ed.label || '');
+      if ('ready' in ed) e.ready = !!ed.ready;
+      if ('left' in ed) e.left = typeof ed.left === 'number' ? ed.left : null;
+      if ('skillid' in ed) e.skillid = typeof ed.skillid === 'number' ? ed.skillid : 0;
+      if ('readyAt' in ed) e.readyAt = cleanRelayMs(ed.readyAt);
+      if (!sameEntry(before, e)) changed = true;
     }
   }
+
+  return changed;
 }
 
 app.post('/update', (req, res) => {
+  let body = req.body || {};
+  let wire = null;
+  if (Buffer.isBuffer(body)) {
+    try {
+      ({ body, wire } = decodeUpdate(body));
+    } catch (e) {
+      if (e.resync) return res.json({ ok: true, resync: true });
+      return res.status(400).json({ ok: false, err: 'bad payload' });
+    }
+  }
+
   const {
     room = 'bags',
     clientId,
-    name,
     entries,
-    prof,
-    pluginVer,
-    subgroup,
     groupOrder,
-    account
-  } = req.body || {};
+    seq,
+    base
+  } = body;
 
-  if (!clientId || !Array.isArray(entries)) {
+  if (!clientId) {
     return res.status(400).json({ ok: false, err: 'bad payload' });
   }
 
   const m = getRoom(room);
-  const fixedName = assignName(room, name);
-
-  m.set(clientId, {
-    name: fixedName,
-    prof: Number.isInteger(prof) ? prof : 0,
-    pluginVer: typeof pluginVer === 'string' ? pluginVer : null,
-    subgroup: Number.isInteger(subgroup) ? subgroup : 0,
-    account: typeof account === 'string' ? account : null, // NEW
-    entries: entries.map(e => ({
-      label: String(e.label || ''),
-      ready: !!e.ready,
-      left: typeof e.left === 'number' ? e.left : null,
-      skillid: typeof e.skillid === 'number' ? e.skillid : 0
-    })),
-    ts: Date.now()
-  });
+  let v;
+  let changed;
+
+  if (base !== undefined) {
+    // delta against the state we acknowledged at `base`; anything else
+    // (restart, prune, a lost ack) makes the client send a full payload
+    v = m.get(clientId);
+    if (!v || v.seq == null || v.seq !== base || !Number.isInteger(seq)) {
+      return res.json({ ok: true, resync: true });
+    }
+    changed = applyDelta(room, v, body);
+    v.seq = seq;
+    v.sentAt = cleanRelayMs(body.sentAt);
+    v.ts = Date.now();
+  } else {
+    if (!Array.isArray(entries) || entries.length > ENTRIES_MAX) {
+      return res.status(400).json({ ok: false, err: 'bad payload' });
+    }
+
+    ({ v, changed } = storeFull(room, clientId, body));
+  }
+  if (wire) v.wire = wire;
+  if (changed) touchPeer(room, clientId, v);
 
   // If this payload includes a groupOrder, treat it as the shared order for this room
   if (groupOrder && typeof groupOrder === 'object') {
     roomOrders.set(room, groupOrder);
+    touchOrder(room);
+    broadcast(room, 'order', groupOrder);
   }
 
+  // unchanged deltas are heartbeats: nothing to tell the room
+  if (changed) {
+    broadcast(room, 'peer', peerEvent(clientId, v));
+    udpFanout(room, clientId, v);
+  }
   prune();
-  res.json({ ok: true, assignedName: fixedName });
+
+  const reply = { ok: true, assignedName: v.name };
+  if (v.seq != null) reply.ack = v.seq;
+  res.json(reply);
 });
 
 app.get('/aggregate', (req, res) => {
   const room = req.query.room || 'bags';
-  const m = getRoom(room);
   prune();
+  const since = partialSince(room, sinceParam(req.query));
+  if (since !== undefined && since === roomState(room).version) {
+    return res.status(304).end();
+  }
 
-  const peers = [];
-  for (const [clientId, v] of m.entries()) {
-    peers.push({
-      clientId,
-      name: v.name || 'unknown',
-      prof: v.prof || 0,
-      pluginVer: v.pluginVer || null,
-      subgroup: v.subgroup || 0,
-      account: v.account || null,  // NEW
-      entries: v.entries || [],
-      elite: v.elite || 0
+  const accept = req.get('accept') || '';
+  const wire = accept.includes(WIRE_TYPE);
+  const wv = wire ? wireVersion(accept) : 0;
+  const key = wire ? `w${wv}:${since}:${roomDict(room).id}:${req.query.dict || ''}` : `j:${since}`;
+  const reply = cachedAggregate(room, key, () => {
+    const snap = roomSnapshot(room, since);
+    return wire
+      ? { type: WIRE_TYPE, raw: encodeAggregate(room, req.query.dict, snap, wv) }
+      : { type: 'application/json', raw: Buffer.from(JSON.stringify(snap)) };
+  });
+
+  res.set('Vary', 'Accept-Encoding');
+  res.type(reply.type);
+  if (reply.raw.length >= GZIP_MIN_BYTES && /\bgzip\b/.test(req.get('accept-encoding') || '')) {
+    if (!reply.gz) reply.gz = zlib.gzipSync(reply.raw);
+    res.set('Content-Encoding', 'gzip');
+    return res.send(reply.gz);
+  }
+  res.send(reply.raw);
+});
+
+app.get('/events', (req, res) => {
+  const room = req.query.room || 'bags';
+  prune();
+
+  res.writeHead(200, {
+    'Content-Type': 'text/event-stream',
+    'Cache-Control': 'no-cache',
+    'Connection': 'keep-alive',
+    'X-Accel-Buffering': 'no'   // don't let a reverse proxy hold events back
+  });
+  res.write(`event: snapshot\ndata: ${JSON.stringify(roomSnapshot(room))}\n\n`);
+
+  if (!roomStreams.has(room)) roomStreams.set(room, new Set());
+  const streams = roomStreams.get(room);
+  streams.add(res);
+
+  req.on('close', () => {
+    streams.delete(res);
+    if (!streams.size) roomStreams.delete(room);
+  });
+});
+
+// keep idle streams open through proxies and let clients detect dead links;
+// also prunes rooms nobody is posting to, so "leave" events still go out
+const streamPing = setInterval(() => {
+  prune();
+  for (const streams of roomStreams.values()) {
+    for (const res of streams) res.write(': ping\n\n');
+  }
+}, STREAM_PING_MS);
+
+// ---- room datagrams (UDP) ----
+//
+// Mirrors the "room datagrams" section of arcdps_cooldowns.cpp. POST
+// /udp/join gives a client a token; its state datagrams (self-contained full
+// state, sequence-numbered, strings inline) then replace its record like a
+// full /update, and every peer change, from either path, goes out to the
+// room's other UDP members as a room datagram. Orders, leaves and resyncs
+// stay on HTTP; a record written from a datagram has no `seq`, so the
+// client's next HTTP delta gets a resync.
+//
+// A token only counts from the address that joined with it (req.ip, the
+// client as seen through the proxy), and the relay never sends anything to
+// an address:port it hasn't checked: the first datagram from a new one gets
+// a challenge carrying a fresh cookie, and only a confirm echoing that
+// cookie from the same address:port makes it the member's address. Until
+// then the member's datagrams are dropped and it gets no fan-out. Datagrams
+// with an unknown token, or from another address, are dropped without a
+// reply; a client whose token the relay forgot just goes silent and joins
+// again over HTTP. A challenge is smaller than the ping that triggers it.
+
+const WIRE_DGRAM_STATE = 3;
+const WIRE_DGRAM_ROOM = 4;
+const WIRE_DGRAM_PING = 5;
+const WIRE_DGRAM_PONG = 6;
+const WIRE_DGRAM_CHALLENGE = 8;
+const WIRE_DGRAM_CONFIRM = 9;
+const UDP_MAX_DATAGRAM = 1200;
+const UDP_IDLE_MS = 15000;   // members not heard from (clients ping every second)
+const UDP_CHALLENGE_MS = 1000;   // at most one challenge per member and interval
+// opt-in: unset or "off" runs without the UDP path
+const UDP_PORT = process.env.UDP_PORT && process.env.UDP_PORT !== 'off'
+  ? Number(process.env.UDP_PORT) : 0;
+const UDP_HOST = process.env.UDP_HOST || '0.0.0.0';
+
+// token -> { room, clientId, ip, address, port, cookie, cookieAddress,
+//            cookiePort, challengeTs, seq, ts }
+// ip is where the join came from; address:port is set once confirmed
+const udpMembers = new Map();
+// roomName -> Map(token -> member), for fan-out
+const udpRooms = new Map();
+// `${room}\n${clientId}` -> token, so joining again retires the old token
+const udpTokens = new Map();
+
+const udp = UDP_PORT ? dgram.createSocket('udp4') : null;
+let udpBound = false;
+
+function dropUdpMember(token, member) {
+  udpMembers.delete(token);
+  const key = `${member.room}\n${member.clientId}`;
+  if (udpTokens.get(key) === token) udpTokens.delete(key);
+  const members = udpRooms.get(member.room);
+  if (members) {
+    members.delete(token);
+    if (!members.size) udpRooms.delete(member.room);
+  }
+}
+
+function dgramHeader(kind) {
+  const w = new WireWriter();
+  w.u8(WIRE_MAGIC);
+  w.u8(WIRE_VERSION);
+  w.u8(kind);
+  return w;
+}
+
+// the udp4 socket reports plain IPv4, express may report it IPv4-mapped
+function plainAddress(a) {
+  return typeof a === 'string' && a.startsWith('::ffff:') ? a.slice(7) : a;
+}
+
+function udpChallenge(member, rinfo) {
+  const now = Date.now();
+  if (now - member.challengeTs < UDP_CHALLENGE_MS) return;
+  member.challengeTs = now;
+  member.cookie = crypto.randomInt(1, 2 ** 47);
+  member.cookieAddress = rinfo.address;
+  member.cookiePort = rinfo.port;
+  const w = dgramHeader(WIRE_DGRAM_CHALLENGE);
+  w.varint(member.cookie);
+  udp.send(w.done(), rinfo.port, rinfo.address);
+}
+
+function encodeRoomDatagram(clientId, v) {
+  const p = peerView(clientId, v);
+  const w = dgramHeader(WIRE_DGRAM_ROOM);
+  w.varint(RELAY_EPOCH);
+  w.varint(1);
+  w.str(clientId);
+  w.varint(v.ver);
+  w.str(p.name);
+  w.str(p.account || '');
+  w.varint(p.prof);
+  w.varint(p.subgroup);
+  w.varint(p.elite);
+  w.varint(p.rtt != null ? p.rtt + 1 : 0);
+  w.svarint(p.clockOffset || 0);
+  w.varint(p.entries.length);
+  for (const e of p.entries) {
+    w.str(e.label);
+    w.u8(e.ready ? 1 : 0);
+    w.left(e.left);
+    w.varint(e.skillid);
+    w.varint(e.readyAt || 0);
+  }
+  w.varint(v.sentAt || 0);
+  return w.done();
+}
+
+// Sends a changed peer to every other UDP member of the room.
+function udpFanout(room, clientId, v) {
+  const members = udpRooms.get(room);
+  if (!members) return;
+  let buf = null;
+  for (const member of members.values()) {
+    if (member.clientId === clientId || !member.address) continue;
+    if (!buf) {
+      buf = encodeRoomDatagram(clientId, v);
+      if (buf.length > UDP_MAX_DATAGRAM) return;  // too big for one datagram: HTTP pulls carry it
+    }
+    udp.send(buf, member.port, member.address);
+  }
+}
+
+function decodeStateDatagram(r) {
+  const body = {
+    pluginVer: r.str(),
+    name: r.str(),
+    account: r.str() || null,
+    prof: r.varint(),
+    subgroup: r.varint(),
+    elite: r.varint()
+  };
+  const rtt = r.varint();
+  const offset = r.svarint();
+  body.rtt = rtt ? rtt - 1 : null;
+  body.clockOffset = rtt ? offset : null;
+  const count = r.varint();
+  if (count > ENTRIES_MAX) throw new Error('too many entries');
+  body.entries = [];
+  for (let n = count; n > 0; n--) {
+    body.entries.push({
+      label: r.str(),
+      ready: r.u8() !== 0,
+      left: r.left(),
+      skillid: r.varint(),
+      readyAt: r.varint() || null
     });
   }
+  if (r.pos < r.buf.length) body.sentAt = r.varint();
+  return body;
+}
 
-  const body = { room, peers };
-  const order = roomOrders.get(room);
-  if (order) {
-    body.groupOrder = order;
+function onDatagram(msg, rinfo) {
+  const r = new WireReader(msg);
+  if (r.u8() !== WIRE_MAGIC || r.u8() < 2) return;
+  const kind = r.u8();
+  if (kind !== WIRE_DGRAM_STATE && kind !== WIRE_DGRAM_PING && kind !== WIRE_DGRAM_CONFIRM) return;
+
+  const token = r.varint();
+  const member = udpMembers.get(token);
+  if (!member || rinfo.address !== member.ip) return;
+
+  if (kind === WIRE_DGRAM_CONFIRM) {
+    const cookie = r.varint();
+    if (!member.cookie || cookie !== member.cookie ||
+        rinfo.address !== member.cookieAddress || rinfo.port !== member.cookiePort) return;
+    member.cookie = 0;
+    member.address = rinfo.address;
+    member.port = rinfo.port;
+    member.ts = Date.now();
+    return;
+  }
+  if (rinfo.address !== member.address || rinfo.port !== member.port) {
+    udpChallenge(member, rinfo);
+    return;
+  }
+  member.ts = Date.now();
+
+  if (kind === WIRE_DGRAM_PING) {
+    const w = dgramHeader(WIRE_DGRAM_PONG);
+    w.varint(r.varint());
+    udp.send(w.done(), rinfo.port, rinfo.address);
+    return;
+  }
+
+  const seq = r.varint();
+  if (seq <= member.seq) return;  // late or duplicated
+  const body = decodeStateDatagram(r);
+  member.seq = seq;
+
+  const { room, clientId } = member;
+  const { v, changed } = storeFull(room, clientId, body);
+  if (changed) {
+    touchPeer(room, clientId, v);
+    broadcast(room, 'peer', peerEvent(clientId, v));
+    udpFanout(room, clientId, v);
+  }
+}
+
+if (udp) {
+  udp.on('message', (msg, rinfo) => {
+    try {
+      onDatagram(msg, rinfo);
+    } catch (e) {
+      // malformed datagram: drop it
+    }
+  });
+  udp.on('error', err => {
+    console.error('udp socket error:', err);
+    udpBound = false;
+  });
+}
+
+app.post('/udp/join', (req, res) => {
+  if (!udpBound) return res.status(404).json({ ok: false, err: 'udp disabled' });
+  const { room = 'bags', clientId } = req.body || {};
+  if (typeof clientId !== 'string' || !clientId || typeof room !== 'string') {
+    return res.status(400).json({ ok: false, err: 'bad payload' });
   }
 
-  res.json(body);
+  const key = `${room}\n${clientId}`;
+  const old = udpTokens.get(key);
+  if (old !== undefined) dropUdpMember(old, udpMembers.get(old));
+
+  const token = crypto.randomInt(1, 2 ** 47);
+  const member = {
+    room, clientId, ip: plainAddress(req.ip), address: null, port: 0,
+    cookie: 0, cookieAddress: null, cookiePort: 0, challengeTs: 0, seq: 0, ts: Date.now()
+  };
+  udpMembers.set(token, member);
+  udpTokens.set(key, token);
+  if (!udpRooms.has(room)) udpRooms.set(room, new Map());
+  udpRooms.get(room).set(token, member);
+  res.json({ ok: true, token, port: UDP_PORT });
 });
 
 app.get('/health', (_req, res) => res.json({ ok: true }));
 
+app.get('/time', (_req, res) => {
+  res.set('Cache-Control', 'no-store');
+  res.json({ now: Date.now() });
+});
+
 // download local arcdps_cooldowns.dll
 app.get('/download/arcdps_cooldowns.dll', (req, res) => {
   const filePath = path.join(__dirname, 'arcdps_cooldowns.dll');
@@ -1256,6 +2220,23 @@ a:link, a:visited, a:hover, a:active
 
 const PORT = process.env.PORT || 3456;
 const HOST = process.env.HOST || '127.0.0.1'; // keep local; reverse proxy terminates TLS
-app.listen(PORT, HOST, () => {
-  console.log(`relay listening on http://${HOST}:${PORT}`);
-});
+
+// tests/wire_test.js loads this file for the codecs without starting anything
+if (require.main === module) {
+  app.listen(PORT, HOST, () => {
+    console.log(`relay listening on http://${HOST}:${PORT}`);
+  });
+  if (udp) {
+    udp.bind(UDP_PORT, UDP_HOST, () => {
+      udpBound = true;
+      console.log(`relay datagrams on udp://${UDP_HOST}:${UDP_PORT}`);
+    });
+  }
+} else {
+  clearInterval(streamPing);
+}
+
+module.exports = {
+  WireReader, WireWriter, decodeUpdate, encodeAggregate, storeFull, applyDelta, getRoom,
+  roomSnapshot, sameEntry, samePeer
+};
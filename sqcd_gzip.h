@@ -0,0 +1,344 @@
+#pragma once
+
+// Just enough of RFC 1951/1952 for Content-Encoding: gzip between the plugin
+// and the relay, without pulling zlib into the build. The compressor is LZ77
+// (hash chains over a 32 KB window) with the fixed Huffman code, which is most
+// of the win on our repetitive JSON; the decompressor handles every block
+// type. tests/gzip_test.cpp round-trips it and feeds it corrupt input.
+
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static constexpr size_t GZIP_MAX_OUTPUT = 16u << 20;  // refuse anything inflating past this
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t n) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    while (n--) crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static const uint16_t DEFLATE_LEN_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t DEFLATE_LEN_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DEFLATE_DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DEFLATE_DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// ---- compress ----
+
+struct DeflateBits {
+    std::string& out;
+    uint32_t acc = 0;
+    int n = 0;
+
+    void put(uint32_t v, int bits) {  // LSB first
+        acc |= v << n;
+        n += bits;
+        while (n >= 8) {
+            out.push_back((char)(acc & 0xFF));
+            acc >>= 8;
+            n -= 8;
+        }
+    }
+    void put_code(uint32_t code, int bits) {  // Huffman codes go MSB first
+        uint32_t r = 0;
+        for (int i = 0; i < bits; ++i) r |= ((code >> i) & 1u) << (bits - 1 - i);
+        put(r, bits);
+    }
+    void flush() {
+        if (n > 0) out.push_back((char)(acc & 0xFF));
+        acc = 0;
+        n = 0;
+    }
+};
+
+static void deflate_fixed_symbol(DeflateBits& bw, int sym) {
+    if (sym < 144)      bw.put_code(0x30 + sym, 8);
+    else if (sym < 256) bw.put_code(0x190 + (sym - 144), 9);
+    else if (sym < 280) bw.put_code(sym - 256, 7);
+    else                bw.put_code(0xC0 + (sym - 280), 8);
+}
+
+static void deflate_fixed_match(DeflateBits& bw, int len, int dist) {
+    int li = 28;
+    while (DEFLATE_LEN_BASE[li] > len) --li;
+    deflate_fixed_symbol(bw, 257 + li);
+    bw.put((uint32_t)(len - DEFLATE_LEN_BASE[li]), DEFLATE_LEN_EXTRA[li]);
+    int di = 29;
+    while (DEFLATE_DIST_BASE[di] > dist) --di;
+    bw.put_code((uint32_t)di, 5);
+    bw.put((uint32_t)(dist - DEFLATE_DIST_BASE[di]), DEFLATE_DIST_EXTRA[di]);
+}
+
+// Appends a gzip member holding `data` to `out`.
+static void gzip_compress(const uint8_t* data, size_t n, std::string& out) {
+    static constexpr int WINDOW = 32768, HASH_BITS = 13, MAX_CHAIN = 32, MAX_MATCH = 258;
+    static const uint8_t header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+    out.append((const char*)header, sizeof(header));
+
+    DeflateBits bw{ out };
+    bw.put(1, 1);  // BFINAL
+    bw.put(1, 2);  // fixed Huffman
+
+    std::vector<int32_t> head((size_t)1 << HASH_BITS, -1);
+    std::vector<int32_t> prev(std::min<size_t>(n, WINDOW) + 1, -1);
+    auto hash3 = [&](size_t i) {
+        return ((uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2]) *
+            2654435761u >> (32 - HASH_BITS);
+    };
+    auto insert = [&](size_t i) {
+        if (i + 2 >= n) return;
+        const uint32_t h = hash3(i);
+        prev[i % prev.size()] = head[h];
+        head[h] = (int32_t)i;
+    };
+
+    size_t i = 0;
+    while (i < n) {
+        int best_len = 0, best_dist = 0;
+        if (i + 2 < n) {
+            int32_t cand = head[hash3(i)];
+            const size_t max_len = std::min<size_t>(MAX_MATCH, n - i);
+            for (int chain = 0; cand >= 0 && chain < MAX_CHAIN; ++chain) {
+                const size_t dist = i - (size_t)cand;
+                if (dist > WINDOW || dist == 0) break;
+                size_t l = 0;
+                while (l < max_len && data[cand + l] == data[i + l]) ++l;
+                if ((int)l > best_len) {
+                    best_len = (int)l;
+                    best_dist = (int)dist;
+                    if (l == max_len) break;
+                }
+                const int32_t next = prev[(size_t)cand % prev.size()];
+                if (next >= cand) break;  // slot was reused by a newer position
+                cand = next;
+            }
+        }
+        if (best_len >= 3) {
+            deflate_fixed_match(bw, best_len, best_dist);
+            for (int k = 0; k < best_len; ++k) insert(i + k);
+            i += (size_t)best_len;
+        }
+        else {
+            deflate_fixed_symbol(bw, data[i]);
+            insert(i);
+            ++i;
+        }
+    }
+    deflate_fixed_symbol(bw, 256);
+    bw.flush();
+
+    const uint32_t crc = crc32_update(0, data, n);
+    const uint32_t isize = (uint32_t)n;
+    for (int k = 0; k < 4; ++k) out.push_back((char)((crc >> (8 * k)) & 0xFF));
+    for (int k = 0; k < 4; ++k) out.push_back((char)((isize >> (8 * k)) & 0xFF));
+}
+
+// ---- decompress ----
+
+struct InflateHuff {
+    uint16_t count[16];
+    uint16_t symbol[288];
+};
+
+// Canonical code from code lengths; false if over-subscribed.
+static bool inflate_build(InflateHuff& h, const uint8_t* lengths, int n) {
+    std::memset(h.count, 0, sizeof(h.count));
+    for (int s = 0; s < n; ++s) h.count[lengths[s]]++;
+    if (h.count[0] == n) return true;  // no codes: only fine if never used
+    int left = 1;
+    for (int len = 1; len < 16; ++len) {
+        left <<= 1;
+        left -= h.count[len];
+        if (left < 0) return false;
+    }
+    uint16_t offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; ++len) offs[len + 1] = offs[len] + h.count[len];
+    for (int s = 0; s < n; ++s) {
+        if (lengths[s]) h.symbol[offs[lengths[s]]++] = (uint16_t)s;
+    }
+    return true;
+}
+
+struct InflateState {
+    const uint8_t* in;
+    size_t n;
+    size_t pos = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    bool bad = false;
+
+    uint32_t get(int need) {
+        while (bits < need) {
+            if (pos >= n) { bad = true; return 0; }
+            acc |= (uint32_t)in[pos++] << bits;
+            bits += 8;
+        }
+        const uint32_t v = acc & ((1u << need) - 1);
+        acc >>= need;
+        bits -= need;
+        return v;
+    }
+    int decode(const InflateHuff& h) {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; ++len) {
+            code |= (int)get(1);
+            if (bad) return -1;
+            const int count = h.count[len];
+            if (code - count < first) return h.symbol[index + (code - first)];
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        bad = true;
+        return -1;
+    }
+};
+
+static bool inflate_codes(InflateState& s, const InflateHuff& lit, const InflateHuff& dist,
+    std::string& out) {
+    for (;;) {
+        const int sym = s.decode(lit);
+        if (sym < 0) return false;
+        if (sym < 256) {
+            out.push_back((char)sym);
+        }
+        else if (sym == 256) {
+            return true;
+        }
+        else {
+            const int li = sym - 257;
+            if (li >= 29) return false;
+            const size_t len = DEFLATE_LEN_BASE[li] + s.get(DEFLATE_LEN_EXTRA[li]);
+            const int di = s.decode(dist);
+            if (di < 0 || di >= 30) return false;
+            const size_t d = DEFLATE_DIST_BASE[di] + s.get(DEFLATE_DIST_EXTRA[di]);
+            if (s.bad || d > out.size()) return false;
+            for (size_t k = 0; k < len; ++k) out.push_back(out[out.size() - d]);
+        }
+        if (out.size() > GZIP_MAX_OUTPUT) return false;
+    }
+}
+
+static bool inflate_raw(InflateState& s, std::string& out) {
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    InflateHuff lit, dist;
+    uint8_t lengths[320];
+
+    for (bool last = false; !last;) {
+        last = s.get(1) != 0;
+        const uint32_t type = s.get(2);
+        if (s.bad) return false;
+
+        if (type == 0) {  // stored
+            s.acc = 0;
+            s.bits = 0;
+            if (s.pos + 4 > s.n) return false;
+            const uint32_t len = s.in[s.pos] | (uint32_t)s.in[s.pos + 1] << 8;
+            const uint32_t nlen = s.in[s.pos + 2] | (uint32_t)s.in[s.pos + 3] << 8;
+            s.pos += 4;
+            if (len != (~nlen & 0xFFFF) || s.pos + len > s.n) return false;
+            out.append((const char*)s.in + s.pos, len);
+            s.pos += len;
+            if (out.size() > GZIP_MAX_OUTPUT) return false;
+            continue;
+        }
+
+        if (type == 1) {  // fixed Huffman
+            int k = 0;
+            for (; k < 144; ++k) lengths[k] = 8;
+            for (; k < 256; ++k) lengths[k] = 9;
+            for (; k < 280; ++k) lengths[k] = 7;
+            for (; k < 288; ++k) lengths[k] = 8;
+            inflate_build(lit, lengths, 288);
+            for (k = 0; k < 30; ++k) lengths[k] = 5;
+            inflate_build(dist, lengths, 30);
+        }
+        else if (type == 2) {  // dynamic Huffman
+            const int nlen = (int)s.get(5) + 257;
+            const int ndist = (int)s.get(5) + 1;
+            const int ncode = (int)s.get(4) + 4;
+            if (s.bad || nlen > 286 || ndist > 30) return false;
+            std::memset(lengths, 0, 19);
+            for (int k = 0; k < ncode; ++k) lengths[order[k]] = (uint8_t)s.get(3);
+            InflateHuff lencode;
+            if (!inflate_build(lencode, lengths, 19)) return false;
+
+            for (int k = 0; k < nlen + ndist;) {
+                int sym = s.decode(lencode);
+                if (sym < 0) return false;
+                if (sym < 16) {
+                    lengths[k++] = (uint8_t)sym;
+                    continue;
+                }
+                uint8_t v = 0;
+                int rep;
+                if (sym == 16) {
+                    if (k == 0) return false;
+                    v = lengths[k - 1];
+                    rep = 3 + (int)s.get(2);
+                }
+                else if (sym == 17) rep = 3 + (int)s.get(3);
+                else rep = 11 + (int)s.get(7);
+                if (s.bad || k + rep > nlen + ndist) return false;
+                while (rep--) lengths[k++] = v;
+            }
+            if (lengths[256] == 0) return false;
+            if (!inflate_build(lit, lengths, nlen) || !inflate_build(dist, lengths + nlen, ndist))
+                return false;
+        }
+        else {
+            return false;
+        }
+
+        if (!inflate_codes(s, lit, dist, out)) return false;
+    }
+    return true;
+}
+
+// Replaces `out` with the contents of the gzip member in [data, data+n).
+static bool gzip_decompress(const uint8_t* data, size_t n, std::string& out) {
+    out.clear();
+    if (n < 18 || data[0] != 0x1F || data[1] != 0x8B || data[2] != 8) return false;
+    const uint8_t flags = data[3];
+    size_t p = 10;
+    if (flags & 4) {  // FEXTRA
+        if (p + 2 > n) return false;
+        p += 2 + (data[p] | (size_t)data[p + 1] << 8);
+    }
+    if (flags & 8)  { while (p < n && data[p]) ++p; ++p; }  // FNAME
+    if (flags & 16) { while (p < n && data[p]) ++p; ++p; }  // FCOMMENT
+    if (flags & 2) p += 2;                                  // FHCRC
+    if (p + 8 > n) return false;
+
+    InflateState s{ data + p, n - 8 - p };
+    if (!inflate_raw(s, out)) return false;
+
+    const uint8_t* t = data + p + s.pos;
+    if (t + 8 > data + n) return false;
+    const uint32_t crc = t[0] | (uint32_t)t[1] << 8 | (uint32_t)t[2] << 16 | (uint32_t)t[3] << 24;
+    const uint32_t isize = t[4] | (uint32_t)t[5] << 8 | (uint32_t)t[6] << 16 | (uint32_t)t[7] << 24;
+    return isize == (uint32_t)out.size() &&
+        crc == crc32_update(0, (const uint8_t*)out.data(), out.size());
+}
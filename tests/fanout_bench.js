@@ -0,0 +1,316 @@
+// Publish-to-arrival latency of peer changes through a relay, for each way in
+// and out: one sender posts changes to /update, another sends them as state
+// datagrams, both stamped with sentAt on the relay clock like the plugin does;
+// a receiver takes every change off its /events stream and as room datagrams
+// and times it against its own reading of the relay clock (best of a few
+// /time samples, as in the plugin). sentAt is whole milliseconds, so single
+// samples are only good to about a millisecond; the means are not biased.
+//
+//   node tests/fanout_bench.js [changes]          starts relay.js on free ports
+//   RELAY=http://host:port node tests/fanout_bench.js [changes]
+//
+// Needs express (exit code 77, "skipped", without it), for the spawned relay
+// and for the wire codec borrowed from relay.js.
+
+'use strict';
+
+const http = require('http');
+const dgram = require('dgram');
+const net = require('net');
+const path = require('path');
+const { spawn } = require('child_process');
+const { performance } = require('perf_hooks');
+
+let relay;
+try {
+  relay = require('../relay.js');
+} catch (e) {
+  if (e.code === 'MODULE_NOT_FOUND' && /'express'/.test(e.message)) {
+    console.log('fanout_bench.js: express is not installed, skipped');
+    process.exit(77);
+  }
+  throw e;
+}
+const { WireReader, WireWriter } = relay;
+
+// see "room datagrams" in relay.js
+const WIRE_MAGIC = 0x51;
+const WIRE_VERSION = 2;
+const DGRAM_STATE = 3, DGRAM_ROOM = 4, DGRAM_PING = 5, DGRAM_PONG = 6, DGRAM_CHALLENGE = 8,
+  DGRAM_CONFIRM = 9;
+
+const CHANGES = Number(process.argv[2]) || 200;   // per sender
+const INTERVAL_MS = 10;                            // between changes, alternating senders
+const SETTLE_MS = 500;                             // for the last arrivals
+const ROOM = `bench-${process.pid}`;
+const SENDERS = { 'bench-http': 'http', 'bench-udp': 'udp' };
+
+const agent = new http.Agent({ keepAlive: true });
+const nowMs = () => performance.timeOrigin + performance.now();
+let relayOffsetMs = 0;
+const relayNow = () => nowMs() + relayOffsetMs;
+
+function request(base, method, route, body) {
+  return new Promise((resolve, reject) => {
+    const data = body ? JSON.stringify(body) : null;
+    const req = http.request(new URL(route, base), {
+      method, agent,
+      headers: data ? { 'Content-Type': 'application/json', 'Content-Length': Buffer.byteLength(data) } : {}
+    }, res => {
+      const chunks = [];
+      res.on('data', c => chunks.push(c));
+      res.on('end', () => {
+        const text = Buffer.concat(chunks).toString();
+        try {
+          resolve({ status: res.statusCode, body: text ? JSON.parse(text) : null });
+        } catch (e) {
+          resolve({ status: res.statusCode, body: null });
+        }
+      });
+    });
+    req.on('error', reject);
+    if (data) req.write(data);
+    req.end();
+  });
+}
+
+function freePort(kind) {
+  return new Promise((resolve, reject) => {
+    if (kind === 'udp') {
+      const s = dgram.createSocket('udp4');
+      s.on('error', reject);
+      s.bind(0, '127.0.0.1', () => { const { port } = s.address(); s.close(() => resolve(port)); });
+    } else {
+      const s = net.createServer();
+      s.on('error', reject);
+      s.listen(0, '127.0.0.1', () => { const { port } = s.address(); s.close(() => resolve(port)); });
+    }
+  });
+}
+
+// relay.js on free ports, resolved once both its sockets are up.
+async function startRelay() {
+  const port = await freePort('tcp');
+  const udpPort = await freePort('udp');
+  const child = spawn(process.execPath, [path.join(__dirname, '..', 'relay.js')], {
+    env: { ...process.env, HOST: '127.0.0.1', PORT: String(port), UDP_HOST: '127.0.0.1',
+      UDP_PORT: String(udpPort), RATE_LIMIT_RPS: '0' },
+    stdio: ['ignore', 'pipe', 'inherit']
+  });
+  await new Promise((resolve, reject) => {
+    let out = '';
+    child.stdout.on('data', d => {
+      out += d;
+      if (out.includes('relay listening') && out.includes('relay datagrams')) resolve();
+    });
+    child.on('exit', code => reject(new Error(`relay.js exited with ${code}`)));
+  });
+  return { base: `http://127.0.0.1:${port}`, child };
+}
+
+async function syncClock(base) {
+  let best = null;
+  for (let i = 0; i < 8; i++) {
+    const t0 = nowMs();
+    const r = await request(base, 'GET', '/time');
+    const t3 = nowMs();
+    if (r.status !== 200 || typeof r.body?.now !== 'number') throw new Error('relay has no /time');
+    if (!best || t3 - t0 < best.rtt) best = { rtt: t3 - t0, offset: r.body.now - (t0 + t3) / 2 };
+  }
+  relayOffsetMs = best.offset;
+  return best;
+}
+
+function dgramHeader(kind) {
+  const w = new WireWriter();
+  w.u8(WIRE_MAGIC);
+  w.u8(WIRE_VERSION);
+  w.u8(kind);
+  return w;
+}
+
+// A UDP member of ROOM, through the join, challenge and confirm the plugin
+// goes through; `onRoom(reader)` gets the body of every room datagram.
+async function udpMember(base, clientId, onRoom) {
+  const join = await request(base, 'POST', '/udp/join', { room: ROOM, clientId });
+  if (join.status !== 200 || !join.body?.ok) throw new Error(`relay has no UDP (${join.status})`);
+  const { token } = join.body;
+  const sock = dgram.createSocket('udp4');
+  await new Promise(resolve => sock.connect(join.body.port, new URL(base).hostname, resolve));
+
+  const ping = () => {
+    const w = dgramHeader(DGRAM_PING);
+    w.varint(token);
+    w.varint(Math.round(nowMs() * 1000));
+    sock.send(w.done());
+  };
+  const live = new Promise((resolve, reject) => {
+    const timer = setTimeout(() => reject(new Error(`${clientId}: no pong`)), 3000);
+    sock.on('message', msg => {
+      const r = new WireReader(msg);
+      if (r.u8() !== WIRE_MAGIC || r.u8() < 2) return;
+      const kind = r.u8();
+      if (kind === DGRAM_CHALLENGE) {
+        const w = dgramHeader(DGRAM_CONFIRM);
+        w.varint(token);
+        w.varint(r.varint());
+        sock.send(w.done());
+        ping();
+      } else if (kind === DGRAM_PONG) {
+        clearTimeout(timer);
+        resolve();
+      } else if (kind === DGRAM_ROOM) {
+        onRoom(r);
+      }
+    });
+  });
+  ping();
+  await live;
+  const keepAlive = setInterval(ping, 1000);
+  return { sock, token, close: () => { clearInterval(keepAlive); sock.close(); } };
+}
+
+// One changed state: the skill id moves with every change, so the relay
+// always fans it out.
+function benchState(i) {
+  return {
+    name: 'Bench', prof: 1, subgroup: 1, elite: 0,
+    entries: [{ label: 'Bench', ready: false, left: 5, skillid: 1000 + i, readyAt: null }]
+  };
+}
+
+function stateDatagram(token, seq, st, sentAt) {
+  const w = dgramHeader(DGRAM_STATE);
+  w.varint(token);
+  w.varint(seq);
+  w.str('bench');
+  w.str(st.name);
+  w.str('');
+  w.varint(st.prof);
+  w.varint(st.subgroup);
+  w.varint(st.elite);
+  w.varint(0);   // clock not reported
+  w.svarint(0);
+  w.varint(st.entries.length);
+  for (const e of st.entries) {
+    w.str(e.label);
+    w.u8(e.ready ? 1 : 0);
+    w.left(e.left);
+    w.varint(e.skillid);
+    w.varint(e.readyAt || 0);
+  }
+  w.varint(sentAt);
+  return w.done();
+}
+
+// room datagram body (after the header) -> [{ clientId, sentAt }]
+function readRoomDatagram(r) {
+  r.varint();   // epoch
+  const n = r.varint();
+  const peers = [];
+  for (let i = 0; i < n; i++) {
+    const clientId = r.str();
+    r.varint(); r.str(); r.str(); r.varint(); r.varint(); r.varint(); r.varint(); r.svarint();
+    for (let m = r.varint(); m > 0; m--) { r.str(); r.u8(); r.varint(); r.varint(); r.varint(); }
+    peers.push({ clientId, sentAt: 0 });
+  }
+  if (r.pos < r.buf.length) for (const p of peers) p.sentAt = r.varint();
+  return peers;
+}
+
+function openStream(base, onPeer) {
+  return new Promise((resolve, reject) => {
+    const req = http.get(new URL(`/events?room=${ROOM}`, base), res => {
+      if (res.statusCode !== 200) return reject(new Error(`/events answered ${res.statusCode}`));
+      let buf = '';
+      res.setEncoding('utf8');
+      res.on('data', chunk => {
+        buf += chunk;
+        let end;
+        while ((end = buf.indexOf('\n\n')) >= 0) {
+          const block = buf.slice(0, end);
+          buf = buf.slice(end + 2);
+          const event = /^event: (.*)$/m.exec(block)?.[1];
+          const data = /^data: (.*)$/m.exec(block)?.[1];
+          if (event === 'snapshot') resolve(req);
+          else if (event === 'peer' && data) onPeer(JSON.parse(data));
+        }
+      });
+    });
+    req.on('error', reject);
+  });
+}
+
+function percentile(sorted, q) {
+  return sorted[Math.min(sorted.length - 1, Math.ceil(q * sorted.length) - 1)];
+}
+
+async function main() {
+  let base = process.env.RELAY;
+  let child = null;
+  if (!base) ({ base, child } = await startRelay());
+
+  try {
+    const clock = await syncClock(base);
+    console.log(`relay ${base}, /time round trip ${clock.rtt.toFixed(2)} ms, ` +
+      `${CHANGES} changes per sender, one every ${INTERVAL_MS * 2} ms`);
+
+    // "<published> -> <arrived>" -> ms samples
+    const samples = {};
+    const note = (clientId, sentAt, arrived) => {
+      const via = SENDERS[clientId];
+      if (!via || !sentAt) return;
+      const key = `${via} -> ${arrived}`;
+      (samples[key] ||= []).push(relayNow() - sentAt);
+    };
+
+    const stream = await openStream(base, p => note(p.clientId, p.sentAt, 'stream'));
+    const receiver = await udpMember(base, 'bench-receiver', r => {
+      for (const p of readRoomDatagram(r)) note(p.clientId, p.sentAt, 'datagram');
+    });
+    const udpSender = await udpMember(base, 'bench-udp', () => {});
+
+    for (let i = 1; i <= CHANGES; i++) {
+      const st = benchState(i);
+      await request(base, 'POST', '/update', {
+        room: ROOM, clientId: 'bench-http', pluginVer: 'bench', seq: i, sentAt: Math.round(relayNow()), ...st
+      });
+      await new Promise(r => setTimeout(r, INTERVAL_MS));
+      udpSender.sock.send(stateDatagram(udpSender.token, i, st, Math.round(relayNow())));
+      await new Promise(r => setTimeout(r, INTERVAL_MS));
+    }
+    await new Promise(r => setTimeout(r, SETTLE_MS));
+
+    stream.destroy();
+    receiver.close();
+    udpSender.close();
+
+    let ok = true;
+    console.log('\npublished -> arrived     n   lost   mean    p50    p90    p99    max  (ms)');
+    for (const via of ['http', 'udp']) {
+      for (const arrived of ['stream', 'datagram']) {
+        const key = `${via} -> ${arrived}`;
+        const s = (samples[key] || []).slice().sort((a, b) => a - b);
+        if (!s.length) {
+          ok = false;
+          console.log(`${key.padEnd(20)} ${'0'.padStart(5)}`);
+          continue;
+        }
+        const mean = s.reduce((a, b) => a + b, 0) / s.length;
+        const cols = [mean, percentile(s, 0.5), percentile(s, 0.9), percentile(s, 0.99), s[s.length - 1]]
+          .map(v => v.toFixed(2).padStart(6));
+        console.log(`${key.padEnd(20)} ${String(s.length).padStart(5)} ${String(CHANGES - s.length).padStart(6)} ` +
+          cols.join(' '));
+      }
+    }
+    return ok ? 0 : 1;
+  } finally {
+    agent.destroy();
+    if (child) child.kill();
+  }
+}
+
+main().then(code => process.exit(code), e => {
+  console.log(`fanout_bench.js: ${e.message}`);
+  process.exit(1);
+});
@@ -0,0 +1,155 @@
+// Round-trip and corrupt-input checks for sqcd_gzip.h. The reference members
+// below are what Python's gzip module writes for the same inputs (dynamic
+// Huffman, stored, and a member with FNAME set); our compressor only emits
+// fixed-Huffman blocks, so they are what covers the other decoder paths.
+//
+//   cmake -S tests -B build && cmake --build build && ctest --test-dir build
+
+#include "../sqcd_gzip.h"
+
+#include <cstdio>
+#include <random>
+
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } \
+} while (0)
+
+static std::string gzip(const std::string& s) {
+    std::string out;
+    gzip_compress((const uint8_t*)s.data(), s.size(), out);
+    return out;
+}
+
+static bool gunzip(const std::string& z, std::string& out) {
+    return gzip_decompress((const uint8_t*)z.data(), z.size(), out);
+}
+
+static std::string member(const uint8_t* p, size_t n) {
+    return std::string((const char*)p, n);
+}
+
+// The same shape as a full /update body.
+static std::string peer_json() {
+    std::string s = "{\"room\":\"bags\",\"clientId\":\"c1\",\"entries\":[";
+    for (int i = 0; i < 8; ++i) {
+        char row[96];
+        std::snprintf(row, sizeof(row), "%s{\"label\":\"Well of Action %d\",\"ready\":false,\"left\":%d.5}",
+            i ? "," : "", i, i * 3);
+        s += row;
+    }
+    return s + "]}";
+}
+
+static const uint8_t REF_DYNAMIC[] = {   // gzip.compress(peer_json(), 9, mtime=0)
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7D, 0xCB, 0x4B, 0x0E, 0xC2, 0x20,
+    0x10, 0x06, 0xE0, 0xAB, 0x90, 0x59, 0x13, 0x53, 0xA8, 0x54, 0x65, 0xE7, 0xD2, 0x13, 0xB8, 0x30,
+    0x2E, 0x28, 0x1D, 0x4C, 0x93, 0xB1, 0x24, 0xC0, 0xC6, 0x34, 0xBD, 0xBB, 0x5C, 0x60, 0x66, 0xF9,
+    0x3F, 0xBE, 0x1D, 0x4A, 0xCE, 0x5F, 0xF0, 0x30, 0x87, 0x4F, 0x05, 0x0D, 0x91, 0x56, 0xDC, 0xDA,
+    0x63, 0xE9, 0x4D, 0x34, 0x3D, 0xF7, 0x50, 0x56, 0xAC, 0xE0, 0x5F, 0x3B, 0x50, 0x98, 0x91, 0xFA,
+    0xF0, 0x44, 0x22, 0x95, 0x93, 0xBA, 0xC7, 0xB6, 0xE6, 0x4D, 0x0D, 0xFD, 0x56, 0x30, 0x2C, 0x3F,
+    0xF0, 0x29, 0x50, 0x45, 0x0D, 0x84, 0xA9, 0x81, 0x1F, 0x4E, 0xEE, 0xD0, 0xAC, 0x32, 0x8C, 0x1A,
+    0x45, 0x65, 0x19, 0x35, 0x89, 0x6A, 0x64, 0xD4, 0x4D, 0x54, 0x67, 0x46, 0x19, 0x2B, 0x32, 0xC7,
+    0x31, 0x27, 0xB2, 0x89, 0x63, 0x57, 0x91, 0x5D, 0x18, 0x66, 0x4D, 0x67, 0xEF, 0xE3, 0x0F, 0x1E,
+    0xE8, 0xAC, 0x0F, 0xDF, 0x01, 0x00, 0x00
+};
+static const uint8_t REF_STORED[] = {    // gzip.compress(b"stored block, no compression", 0, mtime=0)
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x03, 0x01, 0x1C, 0x00, 0xE3, 0xFF, 0x73,
+    0x74, 0x6F, 0x72, 0x65, 0x64, 0x20, 0x62, 0x6C, 0x6F, 0x63, 0x6B, 0x2C, 0x20, 0x6E, 0x6F, 0x20,
+    0x63, 0x6F, 0x6D, 0x70, 0x72, 0x65, 0x73, 0x73, 0x69, 0x6F, 0x6E, 0xDE, 0xCB, 0x27, 0x8C, 0x1C,
+    0x00, 0x00, 0x00
+};
+static const uint8_t REF_FNAME[] = {     // GzipFile(filename="peers.json") holding b"named member"
+    0x1F, 0x8B, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0xFF, 0x70, 0x65, 0x65, 0x72, 0x73, 0x2E,
+    0x6A, 0x73, 0x6F, 0x6E, 0x00, 0xCB, 0x4B, 0xCC, 0x4D, 0x4D, 0x51, 0xC8, 0x4D, 0xCD, 0x4D, 0x4A,
+    0x2D, 0x02, 0x00, 0xAC, 0xB7, 0x3B, 0x43, 0x0C, 0x00, 0x00, 0x00
+};
+
+static void round_trip(const std::string& in) {
+    std::string out;
+    CHECK(gunzip(gzip(in), out));
+    CHECK(out == in);
+}
+
+static void test_round_trip() {
+    std::mt19937 rng(7);
+    round_trip("");
+    round_trip("a");
+    round_trip("abc");
+    round_trip(peer_json());
+    round_trip(std::string(1000, 'x'));   // back-to-back longest matches
+
+    std::string noise(70000, '\0');
+    for (auto& c : noise) c = (char)rng();
+    round_trip(noise);                    // literals only, longer than the window
+
+    std::string far = noise.substr(0, 20000) + std::string(12000, 'y') + noise.substr(0, 20000);
+    round_trip(far);                      // distances close to 32 KB
+
+    std::string json;
+    while (json.size() < 200000) json += peer_json();
+    round_trip(json);
+    CHECK(gzip(json).size() < json.size() / 4);
+}
+
+static void test_reference_members() {
+    std::string out;
+    CHECK(gunzip(member(REF_DYNAMIC, sizeof(REF_DYNAMIC)), out));
+    CHECK(out == peer_json());
+    CHECK(gunzip(member(REF_STORED, sizeof(REF_STORED)), out));
+    CHECK(out == "stored block, no compression");
+    CHECK(gunzip(member(REF_FNAME, sizeof(REF_FNAME)), out));
+    CHECK(out == "named member");
+}
+
+static void test_corrupt_input() {
+    const std::string members[] = {
+        gzip(peer_json()),
+        member(REF_DYNAMIC, sizeof(REF_DYNAMIC)),
+        member(REF_STORED, sizeof(REF_STORED)),
+        member(REF_FNAME, sizeof(REF_FNAME)),
+    };
+    std::string out;
+    for (const std::string& z : members) {
+        std::string want;
+        CHECK(gunzip(z, want));
+
+        // every truncation fails
+        for (size_t n = 0; n < z.size(); ++n) CHECK(!gunzip(z.substr(0, n), out));
+
+        // every single-bit flip fails, or (in header fields nobody reads)
+        // still yields the original
+        for (size_t i = 0; i < z.size(); ++i) {
+            for (int b = 0; b < 8; ++b) {
+                std::string bad = z;
+                bad[i] = (char)(bad[i] ^ (1 << b));
+                if (gunzip(bad, out)) CHECK(out == want);
+            }
+        }
+    }
+
+    // random bodies behind a valid header must not crash or run away
+    std::mt19937 rng(11);
+    for (int k = 0; k < 20000; ++k) {
+        std::string bad = members[0].substr(0, 10);
+        bad.resize(10 + rng() % 64);
+        for (size_t i = 10; i < bad.size(); ++i) bad[i] = (char)rng();
+        if (gunzip(bad, out)) CHECK(out.size() <= GZIP_MAX_OUTPUT);
+    }
+
+    // a member that inflates past GZIP_MAX_OUTPUT is refused
+    CHECK(!gunzip(gzip(std::string(GZIP_MAX_OUTPUT + 1, '\0')), out));
+}
+
+int main() {
+    test_round_trip();
+    test_reference_members();
+    test_corrupt_input();
+    if (g_failures) {
+        std::printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("gzip: all checks passed\n");
+    return 0;
+}
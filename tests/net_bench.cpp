@@ -0,0 +1,343 @@
+// Relay outage bench: the plugin's own net threads (net_loop, the room
+// stream, SocketTransport and the relay breaker), started with mod_init,
+// against a relay stand-in in this process that can be paused two ways:
+//
+//   hang  stops answering, as a stopped or wedged relay does: connections
+//         still queue in the listen backlog and requests sit unread
+//   down  closes the listener and every connection (refused / reset)
+//
+// For each it reports when the breaker opened, how many /health probes went
+// out while the stand-in stayed paused for another outage_s, and after it
+// resumes how long until the breaker closed and the first /update was
+// acknowledged again. Then it times mod_release with requests hanging on the
+// paused stand-in, and on a healthy one.
+//
+//   cmake -S tests -B build && cmake --build build && build/net_bench [outage_s]
+
+#include "../arcdps_cooldowns.cpp"
+
+#include <poll.h>
+
+#include <cstdio>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double since_s(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now() - t0).count();
+}
+
+// Minimal HTTP/1.1 relay: /health, /time, /update (acks seq), /aggregate (an
+// empty room), /events (snapshot, then a ping a second). Keep-alive, one
+// thread per connection.
+class StandIn {
+public:
+    enum Mode { UP, HANG, DOWN };
+
+    bool start() {
+        if (!listen_on(0)) return false;
+        acceptor_ = std::thread([this] { accept_loop(); });
+        return true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+            close_all_locked();
+        }
+        cv_.notify_all();
+        if (acceptor_.joinable()) acceptor_.join();
+        for (auto& t : workers_) t.join();
+    }
+
+    void set_mode(Mode mode) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (mode == DOWN) close_all_locked();
+            if (mode_ == DOWN && mode != DOWN) listen_on(port_);
+            mode_ = mode;
+        }
+        cv_.notify_all();
+    }
+
+    int port() const { return port_; }
+    uint64_t updates() const { return updates_.load(); }
+
+private:
+    bool listen_on(int port) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = htons((uint16_t)port);
+        socklen_t len = sizeof(a);
+        if (bind(fd, (sockaddr*)&a, sizeof(a)) != 0 || listen(fd, 64) != 0 ||
+            getsockname(fd, (sockaddr*)&a, &len) != 0) {
+            ::close(fd);
+            return false;
+        }
+        port_ = ntohs(a.sin_port);
+        listen_fd_ = fd;
+        return true;
+    }
+
+    // m_ held.
+    void close_all_locked() {
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        listen_fd_ = -1;
+        for (int fd : conns_) ::shutdown(fd, SHUT_RDWR);
+    }
+
+    // Blocks while hung; false once the connection should go away.
+    bool wait_up(int fd) {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [&] { return stop_ || mode_ != HANG; });
+        return !stop_ && mode_ == UP && std::find(conns_.begin(), conns_.end(), fd) != conns_.end();
+    }
+
+    void accept_loop() {
+        for (;;) {
+            int lfd;
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                cv_.wait(lk, [&] { return stop_ || mode_ == UP; });
+                if (stop_) return;
+                lfd = listen_fd_;
+            }
+            pollfd p{ lfd, POLLIN, 0 };
+            if (poll(&p, 1, 50) <= 0) continue;
+            int fd = ::accept(lfd, nullptr, nullptr);
+            if (fd < 0) continue;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            std::lock_guard<std::mutex> lk(m_);
+            conns_.push_back(fd);
+            workers_.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+    void serve(int fd) {
+        std::string in;
+        char buf[4096];
+        for (;;) {
+            size_t head_end;
+            while ((head_end = in.find("\r\n\r\n")) == std::string::npos) {
+                const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+                if (n <= 0) return finish(fd);
+                in.append(buf, (size_t)n);
+            }
+            size_t body_len = 0;
+            const size_t cl = in.find("Content-Length: ");
+            if (cl != std::string::npos && cl < head_end) body_len = std::strtoul(in.c_str() + cl + 16, nullptr, 10);
+            while (in.size() < head_end + 4 + body_len) {
+                const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+                if (n <= 0) return finish(fd);
+                in.append(buf, (size_t)n);
+            }
+            const std::string line = in.substr(0, in.find("\r\n"));
+            const std::string body = in.substr(head_end + 4, body_len);
+            in.erase(0, head_end + 4 + body_len);
+
+            if (!wait_up(fd)) return finish(fd);
+            if (line.compare(0, 12, "GET /events?") == 0) return stream(fd);
+            if (!send_all(fd, answer(line, body))) return finish(fd);
+        }
+    }
+
+    std::string answer(const std::string& line, const std::string& body) {
+        std::string json_body = "{\"ok\":true}";
+        int status = 200;
+        if (line.compare(0, 10, "GET /time ") == 0) {
+            json_body = "{\"now\":" + std::to_string((long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()) + "}";
+        }
+        else if (line.compare(0, 12, "POST /update") == 0) {
+            const json j = json::parse(body, nullptr, false);
+            json reply = { { "ok", true }, { "assignedName", "bench" } };
+            if (j.is_object() && j.contains("seq")) reply["ack"] = j["seq"];
+            json_body = reply.dump();
+            updates_.fetch_add(1);
+        }
+        else if (line.compare(0, 14, "GET /aggregate") == 0) {
+            json_body = "{\"room\":\"bags\",\"epoch\":1,\"version\":1,\"peers\":[]}";
+        }
+        else if (line.compare(0, 12, "GET /health ") != 0) {
+            status = 404;
+            json_body = "{\"ok\":false}";
+        }
+        return "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : " Not Found") +
+            "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(json_body.size()) +
+            "\r\nConnection: keep-alive\r\n\r\n" + json_body;
+    }
+
+    void stream(int fd) {
+        std::string out = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n"
+            "event: snapshot\ndata: {\"room\":\"bags\",\"epoch\":1,\"version\":1,\"peers\":[]}\n\n";
+        while (send_all(fd, out)) {
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                cv_.wait_for(lk, std::chrono::seconds(1), [&] { return stop_; });
+            }
+            if (!wait_up(fd)) break;
+            out = ": ping\n\n";
+        }
+        finish(fd);
+    }
+
+    static bool send_all(int fd, const std::string& s) {
+        size_t off = 0;
+        while (off < s.size()) {
+            const ssize_t n = ::send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            off += (size_t)n;
+        }
+        return true;
+    }
+
+    void finish(int fd) {
+        std::lock_guard<std::mutex> lk(m_);
+        conns_.erase(std::remove(conns_.begin(), conns_.end(), fd), conns_.end());
+        ::close(fd);
+    }
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    Mode mode_ = UP;
+    bool stop_ = false;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::vector<int> conns_;
+    std::vector<std::thread> workers_;
+    std::thread acceptor_;
+    std::atomic<uint64_t> updates_{ 0 };
+};
+
+clock_type::time_point g_t0;
+
+void __cdecl log_line(char* s) {
+    std::printf("  %7.3f  %s\n", since_s(g_t0), s);
+}
+
+template <class Pred>
+double wait_for(Pred pred, double limit_s) {
+    const auto t0 = clock_type::now();
+    while (!pred()) {
+        if (since_s(t0) > limit_s) return -1.0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return since_s(t0);
+}
+
+uint64_t update_acks() { return g_net_stats[EP_UPDATE].ok.load(); }
+
+uint64_t failed_requests() {
+    uint64_t n = 0;
+    for (auto& s : g_net_stats) n += s.failed.load();
+    return n;
+}
+
+void write_settings(int port) {
+    json j;
+    j["server_host"] = "127.0.0.1";
+    j["server_port"] = port;
+    j["use_https"] = false;
+    j["socket_transport"] = true;
+    j["compress"] = false;
+    j["udp"] = false;
+    j["skill_api_host"] = "127.0.0.1";
+    j["skill_api_port"] = port;
+    j["skill_api_https"] = false;
+    j["tracked"] = json::array();
+    write_file_utf8(settings_path(), j.dump(2));
+}
+
+struct Outage {
+    double open_s = -1.0;      // pause -> breaker open
+    uint32_t probes = 0;       // while open, for outage_s
+    uint64_t failures = 0;
+    double closed_s = -1.0;    // resume -> breaker closed
+    double push_s = -1.0;      // resume -> first acknowledged /update
+};
+
+Outage run_outage(StandIn& relay, StandIn::Mode mode, double outage_s) {
+    Outage o;
+    const uint64_t failed0 = failed_requests();
+    relay.set_mode(mode);
+    o.open_s = wait_for([] { return g_relay_open.load(); }, 30.0);
+    std::this_thread::sleep_for(std::chrono::duration<double>(outage_s));
+    o.probes = g_relay_probes.load();
+    o.failures = failed_requests() - failed0;
+
+    const uint64_t acks0 = update_acks();
+    const auto t1 = clock_type::now();
+    relay.set_mode(StandIn::UP);
+    o.closed_s = wait_for([] { return !g_relay_open.load(); }, 30.0);
+    const double pushed = wait_for([&] { return update_acks() > acks0; }, 30.0);
+    o.push_s = pushed < 0 ? -1.0 : since_s(t1);
+    return o;
+}
+
+double timed_release() {
+    const auto t0 = clock_type::now();
+    mod_release();
+    return since_s(t0) * 1000.0;
+}
+
+}   // namespace
+
+int main(int argc, char** argv) {
+    const double outage_s = argc > 1 ? std::atof(argv[1]) : 6.0;
+    g_t0 = clock_type::now();
+    arc_e3 = log_line;
+
+    StandIn relay;
+    if (!relay.start()) {
+        std::printf("net_bench: could not start the stand-in\n");
+        return 1;
+    }
+    write_settings(relay.port());
+    std::printf("stand-in on 127.0.0.1:%d, paused %.1f s past the breaker opening\n", relay.port(), outage_s);
+
+    mod_init();
+    const double first = wait_for([] { return update_acks() > 0; }, 10.0);
+    std::printf("first /update acknowledged after %.0f ms\n", first * 1000.0);
+
+    const Outage hang = run_outage(relay, StandIn::HANG, outage_s);
+    const Outage down = run_outage(relay, StandIn::DOWN, outage_s);
+
+    // requests in flight against a hung relay when the game unloads
+    relay.set_mode(StandIn::HANG);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    const double release_hung_ms = timed_release();
+    relay.set_mode(StandIn::UP);
+
+    mod_init();
+    wait_for([] { return update_acks() > 0; }, 10.0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const double release_up_ms = timed_release();
+    relay.stop();
+
+    std::printf("\n%-6s %10s %8s %10s %12s %12s\n", "outage", "open (s)", "probes", "failures",
+        "closed (s)", "pushing (s)");
+    for (auto& row : { std::make_pair("hang", hang), std::make_pair("down", down) })
+        std::printf("%-6s %10.2f %8u %10llu %12.2f %12.2f\n", row.first, row.second.open_s, row.second.probes,
+            (unsigned long long)row.second.failures, row.second.closed_s, row.second.push_s);
+    std::printf("mod_release: %.1f ms with requests hanging, %.1f ms with the relay up\n",
+        release_hung_ms, release_up_ms);
+
+    // Generous bounds: a hung exchange is cut by cancel_requests, and a
+    // resumed relay is found by the next probe, at most RELAY_BACKOFF_MAX_MS
+    // plus a probe deadline away.
+    const double recover_max_s = (RELAY_BACKOFF_MAX_MS + RELAY_PROBE_DEADLINE_MS) / 1000.0 + 2.0;
+    bool ok = first >= 0;
+    for (const Outage* o : { &hang, &down })
+        ok = ok && o->open_s >= 0 && o->closed_s >= 0 && o->push_s >= 0 && o->push_s < recover_max_s;
+    ok = ok && release_hung_ms < 1000.0 && release_up_ms < 1000.0;
+    if (!ok) std::printf("net_bench: outside the expected bounds\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+// Headless combat replay: runs a capture through the plugin's own
+// enqueue_combat -> drain -> apply path (replay_worker, unpaced) and prints
+// throughput, enqueue-to-apply latency percentiles and the timer dump.
+//
+//   replay [capture.bin]
+//
+// Run it from a folder holding arcdps_cooldowns.json to replay with that
+// tracked list. Without an argument it records a synthetic capture first,
+// through the same capture writer the game uses, and replays that; this is
+// what ctest runs. ImGui and arcdps are the no-op stubs in tests/stubs, and
+// the plugin builds its non-Windows paths.
+//
+//   cmake -S tests -B build && cmake --build build && build/replay capture.bin
+
+#include "../arcdps_cooldowns.cpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr int SQUAD = 9;
+constexpr int EVENTS = 100000;
+constexpr uint32_t TRACKED[] = { 12569, 62965, 10545 };   // resolved by g_hard_override_cd
+const char* const TRACKED_NAMES[] = { "Test Skill A", "Test Skill B", "Test Skill C" };
+
+struct Agent {
+    std::string name;
+    ag a{};
+    Agent(uintptr_t id, std::string n, uint32_t prof, uint32_t self, uint16_t team) : name(std::move(n)) {
+        a.id = id;
+        a.prof = prof;
+        a.elite = 1;
+        a.self = self;
+        a.team = team;
+    }
+    ag* get() { a.name = name.data(); return &a; }
+};
+
+void pump_live() {
+    {
+        std::scoped_lock lk(g_mutex);
+        drain_combat_queue_locked();
+    }
+    flush_capture();
+}
+
+bool enqueue(uint64_t ms, cbtevent* ev, ag* src, ag* dst, const char* name) {
+    if (ev) ev->time = ms;
+    bool ok = enqueue_combat(g_combat_queue, ev, src, dst, name, ms / 1000.0);
+    if (g_combat_queue.depth() >= COMBAT_QUEUE_CAP / 2) pump_live();
+    return ok;
+}
+
+// A squad fight: roster notifications, then self casts of the tracked skills,
+// alacrity on self, squad hits, and traffic between agents outside the squad
+// (which only the capture keeps).
+bool write_synthetic_capture() {
+    {
+        std::scoped_lock lk(g_mutex);
+        g_tracked.clear();
+        for (size_t i = 0; i < std::size(TRACKED); ++i) {
+            TrackedEntry e;
+            e.skillid = TRACKED[i];
+            e.label = intern_name(TRACKED_NAMES[i]);
+            g_tracked.push_back(e);
+        }
+        rebuild_tracked_filter_locked();
+    }
+    set_capture(true);
+    if (!g_capture_enabled.load()) return false;
+
+    std::mt19937 rng(7);
+    Agent self(1, "Self Character", 1, 1, 1);
+    Agent self_acct(1, ":Self.1234", 1, 1, 1);
+    std::vector<Agent> squad, squad_acct;
+    for (int i = 0; i < SQUAD; ++i) {
+        squad.emplace_back(2 + i, "Player " + std::to_string(i), 1 + i % 9, 0, (uint16_t)(1 + i / 5));
+        squad_acct.emplace_back(2 + i, ":Account." + std::to_string(1000 + i), 1 + i % 9, 0, (uint16_t)(1 + i / 5));
+    }
+    Agent foe(500, "Training Golem", 0, 0, 0);
+    Agent stranger(600, "Passer By", 3, 0, 0);
+
+    uint64_t ms = 1000;
+    enqueue(ms, nullptr, nullptr, nullptr, nullptr);   // log start / map change
+
+    // agent notifications: elite 0 on src, account and subgroup on dst
+    self.a.elite = 0;
+    enqueue(ms, nullptr, self.get(), self_acct.get(), nullptr);
+    self.a.elite = 1;
+    for (int i = 0; i < SQUAD; ++i) {
+        squad[i].a.elite = 0;
+        enqueue(ms, nullptr, squad[i].get(), squad_acct[i].get(), nullptr);
+        squad[i].a.elite = 1;
+    }
+
+    cbtevent ev{};
+    ev.is_statechange = CBTS_ENTERCOMBAT;
+    enqueue(ms, &ev, self.get(), nullptr, nullptr);
+
+    for (int i = 0; i < EVENTS; ++i) {
+        ms += 5;
+        ev = cbtevent{};
+        if (i % 400 == 0) {
+            const size_t k = (size_t)(i / 400) % std::size(TRACKED);
+            ev.skillid = TRACKED[k];
+            ev.is_activation = ACTV_START;
+            enqueue(ms, &ev, self.get(), foe.get(), TRACKED_NAMES[k]);
+        }
+        else if (i % 97 == 0) {
+            ev.skillid = BUFF_ALACRITY;
+            ev.is_buff = 1;
+            ev.value = 3000;
+            enqueue(ms, &ev, squad[i % SQUAD].get(), self.get(), "Alacrity");
+        }
+        else if (i % 3 == 0) {
+            ev.skillid = 5000 + rng() % 200;
+            ev.value = (int32_t)(rng() % 5000);
+            enqueue(ms, &ev, squad[rng() % SQUAD].get(), foe.get(), "Strike");
+        }
+        else {
+            ev.skillid = 9000 + rng() % 50;
+            ev.value = (int32_t)(rng() % 500);
+            enqueue(ms, &ev, stranger.get(), foe.get(), "Ambient");
+        }
+    }
+
+    ev = cbtevent{};
+    ev.is_statechange = CBTS_EXITCOMBAT;
+    enqueue(ms, &ev, self.get(), nullptr, nullptr);
+    pump_live();
+    set_capture(false);
+    return true;
+}
+
+std::string read_all(const std::wstring& path) {
+    std::ifstream in(std::string(path.begin(), path.end()), std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+}   // namespace
+
+int main(int argc, char** argv) {
+    std::wstring path;
+    if (argc > 1) {
+        const std::string a = argv[1];
+        path.assign(a.begin(), a.end());
+        load_settings_all();
+    }
+    else {
+        if (!write_synthetic_capture()) {
+            std::printf("replay: could not write the synthetic capture\n");
+            return 1;
+        }
+        path = capture_path();
+    }
+
+    replay_worker(0.f, path);
+
+    ReplayReport rep;
+    {
+        std::lock_guard<std::mutex> lk(g_replay_mutex);
+        rep = g_replay_report;
+    }
+    if (!rep.error.empty()) {
+        std::printf("replay: %s\n", rep.error.c_str());
+        return 1;
+    }
+
+    std::printf("events      %llu in %.3f s (%.0f events/s)\n",
+        (unsigned long long)rep.events, rep.wall_s, rep.events_per_s);
+    std::printf("latency us  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+        rep.p50_us, rep.p90_us, rep.p99_us, rep.max_us);
+    std::printf("timers      %zu\n", rep.timers);
+    std::fputs(read_all(dll_file(L"arcdps_cooldowns_replay.txt")).c_str(), stdout);
+
+    // the synthetic fight casts every tracked skill
+    if (argc <= 1 && rep.timers != std::size(TRACKED)) {
+        std::printf("replay: expected %zu timers\n", std::size(TRACKED));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+// The arcdps callback structs, as arcdps_cooldowns.cpp reads them.
+#pragma once
+#include <cstdint>
+
+typedef struct cbtevent {
+    uint64_t time;
+    uint64_t src_agent;
+    uint64_t dst_agent;
+    int32_t value;
+    int32_t buff_dmg;
+    uint32_t overstack_value;
+    uint32_t skillid;
+    uint16_t src_instid;
+    uint16_t dst_instid;
+    uint16_t src_master_instid;
+    uint16_t dst_master_instid;
+    uint8_t iff;
+    uint8_t is_buff;
+    uint8_t result;
+    uint8_t is_activation;
+    uint8_t is_buffremove;
+    uint8_t is_ninety;
+    uint8_t is_fifty;
+    uint8_t is_moving;
+    uint8_t is_statechange;
+    uint8_t is_flanking;
+    uint8_t is_shields;
+    uint8_t is_offcycle;
+    uint8_t pad61;
+    uint8_t pad62;
+    uint8_t pad63;
+    uint8_t pad64;
+} cbtevent;
+
+typedef struct ag {
+    char* name;
+    uintptr_t id;
+    uint32_t prof;
+    uint32_t elite;
+    uint32_t self;
+    uint16_t team;
+} ag;
+
+typedef struct arcdps_exports {
+    uintptr_t size;
+    uint32_t sig;
+    uint32_t imguivers;
+    const char* out_name;
+    const char* out_build;
+    void* wnd_nofilter;
+    void* combat;
+    void* imgui;
+    void* options_tab;
+    void* combat_local;
+    void* wnd_filter;
+    void* options_windows;
+} arcdps_exports;
+
+enum cbtstatechange { CBTS_NONE = 0 };
@@ -0,0 +1,84 @@
+// No-op Dear ImGui for the headless test targets: just the types, enums and
+// calls arcdps_cooldowns.cpp uses. Nothing is drawn; widgets report no input.
+#pragma once
+#include <cstddef>
+
+#define IMGUI_VERSION_NUM 18000
+#define IM_ARRAYSIZE(a) ((int)(sizeof(a) / sizeof(*(a))))
+
+struct ImVec2 { float x = 0, y = 0; ImVec2() {} ImVec2(float a, float b) : x(a), y(b) {} };
+struct ImVec4 {
+    float x = 0, y = 0, z = 0, w = 0;
+    ImVec4() {}
+    ImVec4(float a, float b, float c, float d) : x(a), y(b), z(c), w(d) {}
+};
+struct ImGuiContext;
+
+enum { ImGuiCol_Text, ImGuiCol_TextDisabled, ImGuiCol_COUNT };
+struct ImGuiStyle { ImVec2 CellPadding; ImVec2 ItemSpacing; ImVec4 Colors[ImGuiCol_COUNT]; };
+
+typedef int ImGuiTableFlags;
+typedef int ImGuiWindowFlags;
+enum { ImGuiCond_FirstUseEver = 4 };
+enum { ImGuiDir_Up = 2, ImGuiDir_Down = 3 };
+enum { ImGuiStyleVar_CellPadding = 1 };
+enum { ImGuiTableColumnFlags_WidthFixed = 1, ImGuiTableColumnFlags_WidthStretch = 2 };
+enum { ImGuiTableFlags_Borders = 1, ImGuiTableFlags_BordersInnerV = 2, ImGuiTableFlags_RowBg = 4, ImGuiTableFlags_SizingFixedFit = 8 };
+enum { ImGuiTreeNodeFlags_DefaultOpen = 32 };
+enum { ImGuiWindowFlags_NoCollapse = 32 };
+
+namespace ImGui {
+inline ImGuiStyle& GetStyle() { static ImGuiStyle s; return s; }
+inline void SetCurrentContext(ImGuiContext*) {}
+inline void SetAllocatorFunctions(void* (*)(size_t, void*), void (*)(void*, void*), void* = nullptr) {}
+
+inline bool Begin(const char*, bool* = nullptr, int = 0) { return false; }
+inline void End() {}
+inline void SetNextWindowBgAlpha(float) {}
+inline void SetNextWindowSize(const ImVec2&, int = 0) {}
+inline void SetNextWindowSizeConstraints(const ImVec2&, const ImVec2&) {}
+inline void SetWindowSize(const ImVec2&, int = 0) {}
+inline ImVec2 GetWindowSize() { return {}; }
+inline ImVec2 GetWindowContentRegionMin() { return {}; }
+inline ImVec2 GetWindowContentRegionMax() { return {}; }
+inline float GetCursorPosY() { return 0.f; }
+inline float GetTextLineHeightWithSpacing() { return 17.f; }
+
+inline bool BeginTable(const char*, int, int = 0) { return false; }
+inline void EndTable() {}
+inline bool TableNextRow() { return false; }
+inline bool TableSetColumnIndex(int) { return false; }
+inline void TableSetupColumn(const char*, int = 0, float = 0.f) {}
+inline void Columns(int = 1, const char* = nullptr, bool = true) {}
+inline void NextColumn() {}
+inline void SetColumnWidth(int, float) {}
+
+inline void PushItemWidth(float) {}
+inline void PopItemWidth() {}
+inline void PushStyleColor(int, const ImVec4&) {}
+inline void PopStyleColor(int = 1) {}
+inline void PushStyleVar(int, const ImVec2&) {}
+inline void PopStyleVar(int = 1) {}
+inline void SameLine(float = 0.f, float = -1.f) {}
+inline void Spacing() {}
+
+inline bool Button(const char*) { return false; }
+inline bool ArrowButton(const char*, int) { return false; }
+inline bool Checkbox(const char*, bool*) { return false; }
+inline bool CollapsingHeader(const char*, int = 0) { return false; }
+inline bool InputText(const char*, char*, size_t) { return false; }
+inline bool SliderFloat(const char*, float*, float, float, const char* = "%.3f") { return false; }
+inline bool IsItemHovered(int = 0) { return false; }
+inline bool IsAnyItemActive() { return false; }
+inline bool IsItemActivated() { return false; }
+inline bool IsItemDeactivated() { return false; }
+inline bool IsItemDeactivatedAfterEdit() { return false; }
+inline void SetTooltip(const char*, ...) {}
+
+inline void Text(const char*, ...) {}
+inline void TextColored(const ImVec4&, const char*, ...) {}
+inline void TextDisabled(const char*, ...) {}
+inline void TextUnformatted(const char*, const char* = nullptr) {}
+inline void PlotHistogram(const char*, const float*, int, int = 0, const char* = nullptr,
+    float = 3.4e38f, float = 3.4e38f, ImVec2 = ImVec2(0, 0), int = sizeof(float)) {}
+}
@@ -0,0 +1,3 @@
+// The plugin ships nlohmann/json as a single json.hpp; tests use the system copy.
+#pragma once
+#include <nlohmann/json.hpp>
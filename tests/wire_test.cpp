@@ -0,0 +1,715 @@
+// Binary wire format and room reply decoding: /update round trips through the
+// full and delta encoders (read back the way relay.js decodeUpdate does), the
+// optional sentAt stamp on updates and datagrams, /aggregate decoding of a
+// body relay.js encodeAggregate produced, truncated and corrupted replies, and
+// the SAX room decoder against the DOM path it replaced. The GOLDEN_* bodies
+// are shared with tests/wire_test.js, so the two sides are held to the same
+// bytes.
+//
+//   cmake -S tests -B build && cmake --build build && ctest --test-dir build
+
+#include "../arcdps_cooldowns.cpp"
+
+#include <cstdio>
+#include <random>
+
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } \
+} while (0)
+
+static std::string unhex(const char* h) {
+    std::string out;
+    for (; h[0] && h[1]; h += 2) out.push_back((char)std::stoi(std::string(h, 2), nullptr, 16));
+    return out;
+}
+
+static std::string hex(const std::string& s) {
+    static const char* d = "0123456789abcdef";
+    std::string out;
+    for (unsigned char c : s) { out.push_back(d[c >> 4]); out.push_back(d[c & 15]); }
+    return out;
+}
+
+// encode_update_wire of base_state() as a full push (session 4661, seq 1),
+// split around its pluginVer, then of next_state() as a delta against it
+// (seq 2, base 1).
+static const char* GOLDEN_UPDATE_FULL_HEAD =
+    "5102000462616773026331b5240100050e53656c66204368617261637465720a3a53656c662e313233340457656c6c065369676e65740553686f7574";
+static const char* GOLDEN_UPDATE_FULL_TAIL =
+    "000401370227ad03030200f70199628cb096ffbc31030100f5eb030004005bb1520000";
+static const char* GOLDEN_UPDATE_DELTA =
+    "5102010462616773026331b524020105020e57656c6c206f6620416374696f6e05456c6974656403042aad0303001105c8b596ffbc31020441031f0600b109b0ea010000";
+// relay.js encodeAggregate('bags', undefined, <snapshot in wire_test.js>, 2)
+static const char* GOLDEN_AGGREGATE =
+    "510202abcf9f02000605416c6963650b3a416c6963652e3132333404312e30340457656c6c065369676e657403426f620462616773072a000101020263310263320202633100020301023e24ef01020300f70199628cb096ffbc31040100f5eb0300026332050000070000000000";
+
+// ---- /update, read back like relay.js ----
+
+// The relay's view of one client: its record and its wire dictionary.
+struct RelayRecord {
+    PushState state;
+    std::vector<std::string> dict;
+    size_t delta_rows = 0;   // rows the last delta carried
+};
+
+static bool read_update(const std::string& body, RelayRecord& rec) {
+    WireReader r{ (const uint8_t*)body.data(), (const uint8_t*)body.data() + body.size() };
+    if (r.u8() != WIRE_MAGIC || r.u8() != WIRE_VERSION) return false;
+    const uint8_t kind = r.u8();
+    if (kind != WIRE_UPDATE_FULL && kind != WIRE_UPDATE_DELTA) return false;
+    r.str();       // room
+    r.str();       // clientId
+    r.varint();    // session
+    r.varint();    // seq
+    if (kind == WIRE_UPDATE_DELTA) r.varint();   // base
+
+    const uint64_t first = r.varint();
+    if (!r.ok || first > rec.dict.size()) return false;
+    rec.dict.resize((size_t)first);
+    for (uint64_t n = r.varint(); n > 0 && r.ok; --n) rec.dict.emplace_back(r.str());
+
+    auto ref = [&]() -> std::string {
+        const uint64_t i = r.varint();
+        if (i >= rec.dict.size()) { r.ok = false; return {}; }
+        return rec.dict[(size_t)i];
+        };
+    auto opt_ref = [&]() -> std::string {
+        const uint64_t i = r.varint();
+        if (i == 0) return {};
+        if (i - 1 >= rec.dict.size()) { r.ok = false; return {}; }
+        return rec.dict[(size_t)(i - 1)];
+        };
+    auto entry = [&](uint8_t m, PushEntry& e) {
+        if (m & PE_LABEL) e.label = ref();
+        if (m & PE_READY) e.ready = r.u8() != 0;
+        if (m & PE_LEFT) {
+            // relay.js rounds to the millisecond, so 45.000002 comes out as 45
+            const float left = r.left();
+            e.left = left < 0.f ? left : (float)(std::round(left * 1000.0) / 1000.0);
+        }
+        if (m & PE_SKILLID) e.skillid = (uint32_t)r.varint();
+        if (m & PE_READY_AT) e.ready_at = (int64_t)r.varint();
+        };
+    PushState& ps = rec.state;
+    auto clock = [&]() {
+        const uint64_t rtt = r.varint();
+        ps.clock_offset_ms = (int32_t)r.svarint();
+        ps.clock = rtt != 0;
+        ps.rtt_ms = rtt ? (uint32_t)(rtt - 1) : 0;
+        };
+
+    if (kind == WIRE_UPDATE_FULL) {
+        r.str();   // pluginVer
+        ps.name = ref();
+        ps.prof = (uint32_t)r.varint();
+        ps.subgroup = (uint32_t)r.varint();
+        ps.elite = (uint32_t)r.varint();
+        ps.account = opt_ref();
+        clock();
+        ps.entries.assign((size_t)std::min<uint64_t>(r.varint(), PUSH_ENTRIES_MAX), PushEntry{});
+        for (auto& e : ps.entries) entry(PE_ALL, e);
+    }
+    else {
+        const uint8_t fm = r.u8();
+        if (fm & PF_NAME) ps.name = ref();
+        if (fm & PF_PROF) ps.prof = (uint32_t)r.varint();
+        if (fm & PF_SUBGROUP) ps.subgroup = (uint32_t)r.varint();
+        if (fm & PF_ELITE) ps.elite = (uint32_t)r.varint();
+        if (fm & PF_ACCOUNT) ps.account = opt_ref();
+        if (fm & PF_COUNT) ps.entries.resize((size_t)std::min<uint64_t>(r.varint(), PUSH_ENTRIES_MAX));
+        if (fm & PF_CLOCK) clock();
+        rec.delta_rows = (size_t)r.varint();
+        for (size_t n = 0; n < rec.delta_rows && r.ok; ++n) {
+            const uint64_t i = r.varint();
+            const uint8_t m = r.u8();
+            if (i >= ps.entries.size()) return false;
+            entry(m, ps.entries[(size_t)i]);
+        }
+    }
+
+    for (uint64_t n = r.varint(); n > 0 && r.ok; --n) {
+        r.varint();
+        for (uint64_t k = r.varint(); k > 0 && r.ok; --k) r.str();
+    }
+    ps.sent_at = r.ok && r.p < r.end ? (int64_t)r.varint() : 0;
+    return r.ok && r.p == r.end;
+}
+
+// What a viewer can tell apart. `left` goes out to WIRE_LEFT_STEP in a full
+// push; a delta only sends it when it crosses a second (both sides bucket by
+// ceil, the relay after quantizing), so the relay's copy may trail by up to
+// a second, and behind a readyAt it isn't sent at all.
+static bool same_to_viewer(const PushState& a, const PushState& b, bool exact_left) {
+    if (a.name != b.name || a.account != b.account || a.prof != b.prof ||
+        a.subgroup != b.subgroup || a.elite != b.elite || a.clock != b.clock ||
+        a.entries.size() != b.entries.size())
+        return false;
+    if (a.clock && (a.rtt_ms != b.rtt_ms || a.clock_offset_ms != b.clock_offset_ms)) return false;
+    for (size_t i = 0; i < a.entries.size(); ++i) {
+        const PushEntry& x = a.entries[i];
+        const PushEntry& y = b.entries[i];
+        if (x.label != y.label || x.ready != y.ready || x.skillid != y.skillid || x.ready_at != y.ready_at)
+            return false;
+        if (exact_left) {
+            if ((x.left < 0.f) != (y.left < 0.f)) return false;
+            if (x.left >= 0.f && std::fabs(x.left - y.left) > WIRE_LEFT_STEP / 2 + 1e-4f) return false;
+        }
+        else if (x.ready_at == 0) {
+            if ((x.left < 0.f) != (y.left < 0.f)) return false;
+            if (x.left >= 0.f && std::fabs(x.left - y.left) >= 1.f + WIRE_LEFT_STEP) return false;
+        }
+    }
+    return true;
+}
+
+static PushState base_state() {
+    PushState ps;
+    ps.name = "Self Character";
+    ps.account = ":Self.1234";
+    ps.prof = 4;
+    ps.subgroup = 1;
+    ps.elite = 55;
+    ps.clock = true;
+    ps.rtt_ms = 38;
+    ps.clock_offset_ms = -215;
+    PushEntry a;
+    a.label = "Well";
+    a.left = 12.3f;
+    a.skillid = 12569;
+    a.ready_at = 1700000012300;
+    PushEntry b;
+    b.label = "Signet";
+    b.ready = true;
+    b.skillid = 62965;
+    PushEntry c;
+    c.label = "Shout";
+    c.left = 4.5f;
+    c.skillid = 10545;
+    ps.entries = { a, b, c };
+    return ps;
+}
+
+static PushState next_state() {
+    PushState ps = base_state();
+    ps.subgroup = 3;
+    ps.rtt_ms = 41;
+    ps.entries[0].label = "Well of Action";
+    ps.entries[0].ready_at = 1700000013000;
+    ps.entries[0].left = 11.1f;   // behind readyAt: not sent
+    ps.entries[2].left = 3.2f;    // crosses a second: sent
+    PushEntry d;
+    d.label = "Elite";
+    d.left = 60.f;
+    d.skillid = 30000;
+    ps.entries.push_back(d);
+    return ps;
+}
+
+static void start_session() {
+    g_room = "bags";
+    g_client_id = "c1";
+    g_wire_tx.restart();
+    g_wire_tx.session = 4661;
+    g_push_seq = 1;
+    g_push_acked = 0;
+}
+
+static void ack_push() {
+    g_push_acked = g_push_seq++;
+    g_wire_tx.acked = g_wire_tx.in_flight;
+}
+
+static void test_update_golden() {
+    start_session();
+    const PushState base = base_state();
+    const PushState next = next_state();
+    const PushOrders none;
+
+    std::string full, delta;
+    encode_update_wire(base, nullptr, none, full);
+    ack_push();
+    encode_update_wire(next, &base, none, delta);
+
+    std::string want_full = unhex(GOLDEN_UPDATE_FULL_HEAD);
+    WireWriter{ want_full }.str(PLUGIN_VER);
+    want_full += unhex(GOLDEN_UPDATE_FULL_TAIL);
+    CHECK(full == want_full);
+    CHECK(delta == unhex(GOLDEN_UPDATE_DELTA));
+    if (full != want_full) std::printf("full update:  %s\n", hex(full).c_str());
+    if (delta != unhex(GOLDEN_UPDATE_DELTA)) std::printf("delta update: %s\n", hex(delta).c_str());
+}
+
+static void test_update_round_trip() {
+    start_session();
+    const PushOrders none;
+    RelayRecord rec;
+    std::string body;
+
+    const PushState base = base_state();
+    encode_update_wire(base, nullptr, none, body);
+    CHECK(read_update(body, rec));
+    CHECK(same_to_viewer(base, rec.state, true));
+    ack_push();
+
+    const PushState next = next_state();
+    encode_update_wire(next, &base, none, body);
+    CHECK(read_update(body, rec));
+    CHECK(same_to_viewer(next, rec.state, false));
+    CHECK(rec.delta_rows == 3);   // relabelled, crossed a second, added
+    CHECK(rec.state.entries[0].left == base.entries[0].left);   // stale behind readyAt
+    ack_push();
+
+    // a tick where only left moved within its second is an empty delta
+    PushState tick = next;
+    tick.entries[0].left -= 0.15f;
+    tick.entries[2].left -= 0.15f;
+    tick.entries[3].left -= 0.15f;
+    encode_update_wire(tick, &next, none, body);
+    CHECK(read_update(body, rec));
+    CHECK(rec.delta_rows == 0);
+    CHECK(same_to_viewer(tick, rec.state, false));
+}
+
+// sentAt trails the body when the clock is synced and is left out otherwise,
+// on /update and in datagrams both ways.
+static void test_sent_at() {
+    start_session();
+    const PushOrders none;
+    RelayRecord rec;
+    std::string body, plain;
+
+    PushState base = base_state();
+    encode_update_wire(base, nullptr, none, plain);
+    base.sent_at = 1700000009876;
+    start_session();
+    encode_update_wire(base, nullptr, none, body);
+    CHECK(body.compare(0, plain.size(), plain) == 0);
+    CHECK(read_update(body, rec));
+    CHECK(rec.state.sent_at == base.sent_at);
+    ack_push();
+
+    PushState next = next_state();
+    encode_update_wire(next, &base, none, body);
+    CHECK(read_update(body, rec));
+    CHECK(rec.state.sent_at == 0);
+    next.sent_at = base.sent_at + 50;
+    encode_update_wire(next, &base, none, body);
+    CHECK(read_update(body, rec));
+    CHECK(rec.state.sent_at == next.sent_at);
+
+    CHECK(encode_state_datagram(base, 7, 1, body));
+    base.sent_at = 0;
+    CHECK(encode_state_datagram(base, 7, 1, plain));
+    CHECK(body.size() > plain.size() && body.compare(0, plain.size(), plain) == 0);
+
+    // a room datagram as relay.js encodeRoomDatagram writes it, with and
+    // without the trailing stamps
+    std::string room;
+    WireWriter w{ room };
+    w.varint(3);   // epoch
+    w.varint(2);
+    for (const char* id : { "c1", "c2" }) {
+        w.str(id);
+        w.varint(5);
+        w.str("Name");
+        w.str("");
+        w.varint(1);
+        w.varint(1);
+        w.varint(0);
+        w.varint(0);
+        w.svarint(0);
+        w.varint(0);
+    }
+    std::vector<DgramPeer> peers;
+    uint64_t epoch = 0;
+    WireReader old_room{ (const uint8_t*)room.data(), (const uint8_t*)room.data() + room.size() };
+    CHECK(decode_room_datagram(old_room, epoch, peers));
+    CHECK(peers.size() == 2 && peers[0].sent_at == 0 && peers[1].sent_at == 0);
+    w.varint(1700000001000);
+    w.varint(0);
+    WireReader stamped{ (const uint8_t*)room.data(), (const uint8_t*)room.data() + room.size() };
+    CHECK(decode_room_datagram(stamped, epoch, peers));
+    CHECK(peers.size() == 2 && peers[0].sent_at == 1700000001000 && peers[1].sent_at == 0);
+}
+
+// Random walks of the pushed state, each step a delta against the last
+// acknowledged one, read into the relay's copy. A lost ack ends in a resync
+// and a full push, like net_loop.
+static void test_update_delta_walk() {
+    std::mt19937 rng(13);
+    auto pick = [&](uint32_t n) { return (uint32_t)(rng() % n); };
+    static const char* labels[] = { "Well", "Signet", "Shout", "Elite", "Portal", "Banner", "Spirit" };
+
+    for (int run = 0; run < 20; ++run) {
+        start_session();
+        const PushOrders none;
+        PushState acked = base_state();
+        RelayRecord rec;
+        std::string body;
+        encode_update_wire(acked, nullptr, none, body);
+        CHECK(read_update(body, rec));
+        ack_push();
+
+        PushState cur = acked;
+        bool resync = false;
+        for (int step = 0; step < 200; ++step) {
+            const uint32_t what = pick(10);
+            if (what == 0 && cur.entries.size() < 12) {
+                PushEntry e;
+                e.label = labels[pick(7)];
+                e.skillid = 1000 + pick(50);
+                e.left = pick(2) ? -1.f : (float)pick(600) / 10.f;
+                cur.entries.push_back(e);
+            }
+            else if (what == 1 && !cur.entries.empty()) {
+                cur.entries.pop_back();
+            }
+            else if (what == 2) {
+                cur.subgroup = pick(6);
+                cur.name = pick(2) ? "Self Character" : "Alt " + std::to_string(pick(4));
+            }
+            else if (what == 3) {
+                cur.rtt_ms = 20 + pick(80);
+                cur.clock_offset_ms = (int32_t)pick(1000) - 500;
+            }
+            else if (!cur.entries.empty()) {
+                PushEntry& e = cur.entries[pick((uint32_t)cur.entries.size())];
+                switch (pick(4)) {
+                case 0: e.label = labels[pick(7)]; break;
+                case 1: e.ready = !e.ready; break;
+                case 2: e.ready_at = pick(2) ? 0 : 1700000000000 + pick(100000) * READY_AT_STEP_MS; break;
+                default: e.left = e.left < 0.f ? (float)pick(600) / 10.f : std::max(0.f, e.left - 0.35f); break;
+                }
+            }
+
+            encode_update_wire(cur, resync ? nullptr : &acked, none, body);
+            if (resync) {
+                rec = RelayRecord{};   // a full push replaces the record
+                resync = false;
+            }
+            CHECK(read_update(body, rec));
+            CHECK(same_to_viewer(cur, rec.state, false));
+            if (pick(8) == 0) {
+                // ack lost: the relay moved on, so the next delta's base is
+                // refused and net_loop restarts with a full push
+                ++g_push_seq;
+                g_push_acked = 0;
+                g_wire_tx.restart();
+                resync = true;
+                continue;
+            }
+            acked = cur;
+            ack_push();
+        }
+    }
+}
+
+// ---- /aggregate ----
+
+static bool decode_agg(const std::string& body, std::vector<Peer>& peers, AggregateMeta& meta,
+    PushOrders& orders) {
+    bool has_orders = false;
+    return decode_aggregate_wire(body, peers, orders, has_orders, meta);
+}
+
+static void test_aggregate_golden() {
+    g_wire_rx = WireRxDict{};
+    std::vector<Peer> peers;
+    AggregateMeta meta;
+    PushOrders orders;
+    CHECK(decode_agg(unhex(GOLDEN_AGGREGATE), peers, meta, orders));
+    CHECK(meta.epoch == 7 && meta.version == 42 && !meta.partial);
+    CHECK(orders.size() == 1 && orders[0].first == 1 && orders[0].second.size() == 2 &&
+        orders[0].second[1] == "c2");
+    CHECK(peers.size() == 2);
+    if (peers.size() != 2) return;
+
+    const Peer& a = peers[0];
+    CHECK(a.id == "c1" && a.name == "Alice" && a.account == ":Alice.1234");
+    CHECK(a.prof == 1 && a.subgroup == 2 && a.elite == 62);
+    CHECK(a.clock_known && a.rtt_ms == 35 && a.clock_offset_ms == -120);
+    CHECK(a.entries.size() == 2);
+    if (a.entries.size() == 2) {
+        CHECK(a.entries[0].label == "Well" && !a.entries[0].ready);
+        CHECK(std::fabs(a.entries[0].left - 12.3f) < 1e-3f);
+        CHECK(a.entries[0].ready_at == 1700000012300);
+        CHECK(a.entries[1].label == "Signet" && a.entries[1].ready);
+        CHECK(a.entries[1].left < 0.f && a.entries[1].ready_at == 0);
+    }
+
+    const Peer& b = peers[1];
+    CHECK(b.id == "c2" && b.name == "Bob" && b.account.empty());
+    CHECK(!b.clock_known && b.entries.empty());
+    CHECK(g_wire_rx.names.size() == 6);   // Alice, account, pluginVer, Well, Signet, Bob
+}
+
+// A follow-up reply that only defines what the client has not seen.
+static std::string aggregate_follow_up(uint64_t dict_id, uint64_t first) {
+    std::string out;
+    WireWriter w{ out };
+    w.u8(WIRE_MAGIC);
+    w.u8(2);
+    w.u8(WIRE_AGGREGATE);
+    w.varint(dict_id);
+    w.varint(first);
+    w.varint(1);
+    w.str("Banner");
+    w.str("bags");
+    w.varint(7);   // epoch
+    w.varint(43);  // version
+    w.u8(1);       // partial
+    w.varint(1);
+    w.str("c2");
+    w.varint(0);   // orders
+    w.varint(1);
+    w.str("c1");
+    w.varint(0);   // Alice
+    w.varint(2);   // account
+    w.varint(0);   // pluginVer
+    w.varint(1);
+    w.varint(2);
+    w.varint(62);
+    w.varint(0);   // clock not measured
+    w.svarint(0);
+    w.varint(1);
+    w.varint(first);   // Banner
+    w.u8(0);
+    w.left(7.5f);
+    w.varint(30000);
+    w.varint(0);
+    return out;
+}
+
+static uint64_t golden_dict_id() {
+    const std::string g = unhex(GOLDEN_AGGREGATE);
+    WireReader r{ (const uint8_t*)g.data() + 3, (const uint8_t*)g.data() + g.size() };
+    return r.varint();
+}
+
+static void test_aggregate_dictionary() {
+    std::vector<Peer> peers;
+    AggregateMeta meta;
+    PushOrders orders;
+
+    g_wire_rx = WireRxDict{};
+    CHECK(decode_agg(unhex(GOLDEN_AGGREGATE), peers, meta, orders));
+    const uint64_t id = golden_dict_id();
+    CHECK(decode_agg(aggregate_follow_up(id, 6), peers, meta, orders));
+    CHECK(meta.partial && meta.left.size() == 1 && meta.left[0] == "c2");
+    CHECK(peers.size() == 1 && peers[0].name == "Alice" && peers[0].account == ":Alice.1234");
+    CHECK(peers.size() == 1 && peers[0].entries.size() == 1 && peers[0].entries[0].label == "Banner");
+    CHECK(g_wire_rx.names.size() == 7);
+
+    // definitions past what we hold: dropped, and the next request starts over
+    CHECK(!decode_agg(aggregate_follow_up(id, 9), peers, meta, orders));
+    CHECK(g_wire_rx.id == 0 && g_wire_rx.names.empty());
+
+    // a new dictionary id drops the old strings: index 2 no longer exists
+    CHECK(!decode_agg(aggregate_follow_up(id + 1, 0), peers, meta, orders));
+}
+
+static void test_aggregate_truncated() {
+    const std::string g = unhex(GOLDEN_AGGREGATE);
+    std::vector<Peer> peers;
+    AggregateMeta meta;
+    PushOrders orders;
+    for (size_t n = 0; n < g.size(); ++n) {
+        g_wire_rx = WireRxDict{};
+        const bool ok = decode_agg(g.substr(0, n), peers, meta, orders);
+        CHECK(!ok);
+        if (ok) std::printf("  prefix of %zu bytes decoded\n", n);
+        CHECK(g_wire_rx.names.empty());
+    }
+}
+
+// Flipped bytes must never read out of bounds or grow without limit; what
+// decodes has to stay inside what the body could hold.
+static void test_aggregate_corrupt() {
+    const std::string g = unhex(GOLDEN_AGGREGATE);
+    std::mt19937 rng(5);
+    std::vector<Peer> peers;
+    AggregateMeta meta;
+    PushOrders orders;
+    for (int round = 0; round < 20000; ++round) {
+        std::string body = g;
+        for (int k = 1 + (int)(rng() % 3); k > 0; --k) body[rng() % body.size()] ^= (char)(1 + rng() % 255);
+        g_wire_rx = WireRxDict{};
+        if (decode_agg(body, peers, meta, orders)) {
+            size_t entries = 0;
+            for (auto& p : peers) entries += p.entries.size();
+            CHECK(peers.size() + entries <= body.size());
+            CHECK(g_wire_rx.names.size() <= body.size());
+        }
+    }
+    // the stream of bytes a relay of another protocol could send
+    for (int round = 0; round < 2000; ++round) {
+        std::string body(1 + rng() % 64, '\0');
+        for (auto& c : body) c = (char)rng();
+        body[0] = (char)WIRE_MAGIC;
+        if (body.size() > 2) { body[1] = 2; body[2] = (char)WIRE_AGGREGATE; }
+        g_wire_rx = WireRxDict{};
+        decode_agg(body, peers, meta, orders);
+    }
+}
+
+// ---- JSON room replies ----
+
+static json room_json() {
+    json j;
+    j["room"] = "bags";
+    j["epoch"] = 7;
+    j["version"] = 42;
+    j["groupOrder"] = { { "1", { "c1", "c2" } } };
+    json a;
+    a["clientId"] = "c1";
+    a["name"] = "Alice";
+    a["account"] = ":Alice.1234";
+    a["pluginVer"] = "1.04";
+    a["prof"] = 1;
+    a["subgroup"] = 2;
+    a["elite"] = 62;
+    a["rtt"] = 35;
+    a["clockOffset"] = -120;
+    a["entries"] = json::array({
+        { { "label", "Well" }, { "ready", false }, { "left", 12.3 }, { "skillid", 12569 }, { "readyAt", 1700000012300 } },
+        { { "label", "Signet" }, { "ready", true }, { "left", nullptr }, { "skillid", 62965 }, { "readyAt", nullptr } },
+    });
+    json b;
+    b["clientId"] = "c2";
+    b["name"] = nullptr;
+    b["account"] = nullptr;
+    b["prof"] = 7;
+    b["subgroup"] = 0;
+    b["elite"] = 0;
+    b["rtt"] = nullptr;
+    b["clockOffset"] = nullptr;
+    b["entries"] = json::array();
+    j["peers"] = json::array({ a, b });
+    return j;
+}
+
+static bool sax(const std::string& body, std::vector<Peer>& peers, AggregateMeta& meta,
+    const std::string& room = "bags") {
+    PushOrders orders;
+    bool has_orders = false;
+    return decode_aggregate_json(body, room, peers, orders, has_orders, meta);
+}
+
+static bool same_peers(const std::vector<Peer>& a, const std::vector<Peer>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (!same_peer(a[i], b[i])) return false;
+    return true;
+}
+
+static void test_sax_matches_dom() {
+    std::vector<Peer> s, d;
+    AggregateMeta meta;
+
+    json j = room_json();
+    std::string body = j.dump();
+    CHECK(sax(body, s, meta));
+    dom_decode_peers(body, d);
+    CHECK(same_peers(s, d));
+    CHECK(meta.epoch == 7 && meta.version == 42);
+    CHECK(s.size() == 2 && s[1].name == "unknown");
+
+    // "peers" keyed by clientId
+    json keyed = j;
+    keyed["peers"] = json::object();
+    for (auto& p : j["peers"]) {
+        json q = p;
+        q.erase("clientId");
+        keyed["peers"][p["clientId"].get<std::string>()] = q;
+    }
+    body = keyed.dump();
+    CHECK(sax(body, s, meta));
+    dom_decode_peers(body, d);
+    CHECK(same_peers(s, d));
+
+    // field order and unknown fields don't matter
+    json shuffled = j;
+    shuffled["peers"][0]["extra"] = { { "nested", { 1, 2, { { "x", "y" } } } } };
+    shuffled["trailer"] = json::array({ json::object(), nullptr });
+    body = shuffled.dump();
+    CHECK(sax(body, s, meta));
+    dom_decode_peers(body, d);
+    CHECK(same_peers(s, d));
+
+    // wrong types fall back like parse_peer_json does
+    json odd = j;
+    odd["peers"][0]["prof"] = "x";
+    odd["peers"][0]["rtt"] = "35";
+    odd["peers"][0]["entries"][0]["left"] = -1e300;
+    odd["peers"][0]["entries"][1]["label"] = 5;
+    odd["peers"][0]["elite"] = 1e20;
+    body = odd.dump();
+    CHECK(sax(body, s, meta));
+    dom_decode_peers(body, d);
+    CHECK(same_peers(s, d));
+
+    // the legacy shapes the DOM path never read
+    json legacy;
+    legacy["rooms"]["other"] = json::array({ j["peers"][1] });
+    legacy["rooms"]["bags"] = json::array({ j["peers"][0] });
+    CHECK(sax(legacy.dump(), s, meta));
+    CHECK(s.size() == 1 && s[0].id == "c1");
+    CHECK(sax(j["peers"].dump(), s, meta));
+    CHECK(s.size() == 2 && s[0].id == "c1");
+    json clients;
+    clients["clients"] = j["peers"];
+    CHECK(sax(clients.dump(), s, meta));
+    CHECK(s.size() == 2 && s[1].id == "c2");
+    CHECK(meta.epoch == 0 && meta.version == 0);
+}
+
+static void test_sax_reuses_records() {
+    std::vector<Peer> s;
+    AggregateMeta meta;
+    const std::string body = room_json().dump();
+    CHECK(sax(body, s, meta));
+    const Peer* first = s.data();
+    CHECK(sax(body, s, meta));
+    CHECK(s.data() == first);
+    CHECK(s.size() == 2);
+}
+
+static void test_sax_truncated() {
+    const std::string body = room_json().dump();
+    std::vector<Peer> s;
+    AggregateMeta meta;
+    for (size_t n = 0; n < body.size(); ++n) {
+        const bool ok = sax(body.substr(0, n), s, meta);
+        CHECK(!ok);
+        if (ok) std::printf("  prefix of %zu bytes decoded\n", n);
+    }
+
+    std::mt19937 rng(9);
+    for (int round = 0; round < 5000; ++round) {
+        std::string bad = body;
+        bad[rng() % bad.size()] = "{}[],:\"0x \\"[rng() % 11];
+        sax(bad, s, meta);   // either way, no crash
+    }
+}
+
+int main() {
+    test_update_golden();
+    test_update_round_trip();
+    test_update_delta_walk();
+    test_sent_at();
+    test_aggregate_golden();
+    test_aggregate_dictionary();
+    test_aggregate_truncated();
+    test_aggregate_corrupt();
+    test_sax_matches_dom();
+    test_sax_reuses_records();
+    test_sax_truncated();
+    if (g_failures) {
+        std::printf("wire: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("wire: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,306 @@
+// Binary wire codec of relay.js: decodeUpdate on the bodies the plugin's
+// encoders produced (GOLDEN_* are shared with tests/wire_test.cpp), with and
+// without the trailing sentAt, then on every truncation and on corrupted
+// copies of them; encodeAggregate round trips and its dictionary
+// continuation; and the delta change test that keeps `left`-only pushes from
+// bumping the room version.
+//
+//   node tests/wire_test.js     (exit code 77, "skipped", without express)
+
+'use strict';
+
+const assert = require('assert');
+
+let relay;
+try {
+  relay = require('../relay.js');
+} catch (e) {
+  if (e.code === 'MODULE_NOT_FOUND' && /'express'/.test(e.message)) {
+    console.log('wire.js: express is not installed, skipped');
+    process.exit(77);
+  }
+  throw e;
+}
+const { WireReader, WireWriter, decodeUpdate, encodeAggregate, storeFull, applyDelta, getRoom,
+  sameEntry } = relay;
+
+const GOLDEN_UPDATE_FULL_HEAD =
+  '5102000462616773026331b5240100050e53656c66204368617261637465720a3a53656c662e313233340457656c6c065369676e65740553686f7574';
+const GOLDEN_UPDATE_FULL_TAIL =
+  '000401370227ad03030200f70199628cb096ffbc31030100f5eb030004005bb1520000';
+const GOLDEN_UPDATE_DELTA =
+  '5102010462616773026331b524020105020e57656c6c206f6620416374696f6e05456c6974656403042aad0303001105c8b596ffbc31020441031f0600b109b0ea010000';
+const GOLDEN_AGGREGATE =
+  '510202abcf9f02000605416c6963650b3a416c6963652e3132333404312e30340457656c6c065369676e657403426f620462616773072a000101020263310263320202633100020301023e24ef01020300f70199628cb096ffbc31040100f5eb0300026332050000070000000000';
+
+// the snapshot GOLDEN_AGGREGATE encodes
+const SNAP = {
+  room: 'bags', epoch: 7, version: 42,
+  groupOrder: { 1: ['c1', 'c2'] },
+  peers: [
+    {
+      clientId: 'c1', name: 'Alice', account: ':Alice.1234', pluginVer: '1.04',
+      prof: 1, subgroup: 2, elite: 62, rtt: 35, clockOffset: -120,
+      entries: [
+        { label: 'Well', ready: false, left: 12.3, skillid: 12569, readyAt: 1700000012300 },
+        { label: 'Signet', ready: true, left: null, skillid: 62965, readyAt: null }
+      ]
+    },
+    {
+      clientId: 'c2', name: 'Bob', account: null, pluginVer: null,
+      prof: 7, subgroup: 0, elite: 0, rtt: null, clockOffset: null, entries: []
+    }
+  ]
+};
+
+let failures = 0;
+function test(name, fn) {
+  try {
+    fn();
+  } catch (e) {
+    failures++;
+    console.log(`${name}: ${e.stack}`);
+  }
+}
+
+function fullUpdate() {
+  const w = new WireWriter();
+  w.str('1.04');
+  return Buffer.concat([Buffer.from(GOLDEN_UPDATE_FULL_HEAD, 'hex'), w.done(),
+    Buffer.from(GOLDEN_UPDATE_FULL_TAIL, 'hex')]);
+}
+
+// The /update handler's steps for a decoded body, without the HTTP around them.
+function post(buf) {
+  const { body, wire } = decodeUpdate(buf);
+  let v;
+  if (body.base !== undefined) {
+    v = getRoom(body.room).get(body.clientId);
+    applyDelta(body.room, v, body);
+    v.seq = body.seq;
+  } else {
+    ({ v } = storeFull(body.room, body.clientId, body));
+  }
+  v.wire = wire;
+  return { body, v };
+}
+
+// Reads an /aggregate body the way decode_aggregate_wire does.
+function decodeAggregate(buf, dict) {
+  const r = new WireReader(buf);
+  assert.strictEqual(r.u8(), 0x51);
+  const version = r.u8();
+  assert.strictEqual(r.u8(), 2);
+  const id = r.varint();
+  const first = r.varint();
+  if (id !== dict.id) { dict.id = id; dict.strs = []; }
+  assert.ok(first <= dict.strs.length);
+  dict.strs.length = first;
+  for (let n = r.varint(); n > 0; n--) dict.strs.push(r.str());
+  const ref = () => dict.strs[r.varint()];
+  const optRef = () => { const i = r.varint(); return i ? dict.strs[i - 1] : null; };
+
+  const out = { room: r.str(), epoch: r.varint(), version: r.varint(), peers: [] };
+  if (r.u8()) {
+    out.left = [];
+    for (let n = r.varint(); n > 0; n--) out.left.push(r.str());
+  }
+  out.groupOrder = {};
+  for (let n = r.varint(); n > 0; n--) {
+    const prof = r.varint();
+    const ids = [];
+    for (let k = r.varint(); k > 0; k--) ids.push(r.str());
+    out.groupOrder[prof] = ids;
+  }
+  for (let n = r.varint(); n > 0; n--) {
+    const p = {
+      clientId: r.str(), name: ref(), account: optRef(), pluginVer: optRef(),
+      prof: r.varint(), subgroup: r.varint(), elite: r.varint(), rtt: null, clockOffset: null,
+      entries: []
+    };
+    if (version >= 2) {
+      const rtt = r.varint();
+      const offset = r.svarint();
+      if (rtt) { p.rtt = rtt - 1; p.clockOffset = offset; }
+    }
+    for (let k = r.varint(); k > 0; k--) {
+      const e = { label: ref(), ready: r.u8() !== 0, left: r.left(), skillid: r.varint(), readyAt: null };
+      if (version >= 2) e.readyAt = r.varint() || null;
+      p.entries.push(e);
+    }
+    out.peers.push(p);
+  }
+  assert.strictEqual(r.pos, buf.length);
+  return out;
+}
+
+// bytes after the dictionary id, which is random per relay process
+function afterDictId(buf) {
+  const r = new WireReader(buf);
+  r.u8(); r.u8(); r.u8(); r.varint();
+  return buf.subarray(r.pos);
+}
+
+test('update golden', () => {
+  const { body, v } = post(fullUpdate());
+  assert.strictEqual(body.room, 'bags');
+  assert.strictEqual(body.clientId, 'c1');
+  assert.strictEqual(body.seq, 1);
+  assert.strictEqual(body.pluginVer, '1.04');
+  assert.strictEqual(v.name, 'Self Character');
+  assert.strictEqual(v.account, ':Self.1234');
+  assert.deepStrictEqual([v.prof, v.subgroup, v.elite, v.rtt, v.clockOffset], [4, 1, 55, 38, -215]);
+  assert.deepStrictEqual(v.entries, [
+    { label: 'Well', ready: false, left: 12.3, skillid: 12569, readyAt: 1700000012300 },
+    { label: 'Signet', ready: true, left: null, skillid: 62965, readyAt: null },
+    { label: 'Shout', ready: false, left: 4.5, skillid: 10545, readyAt: null }
+  ]);
+
+  const d = post(Buffer.from(GOLDEN_UPDATE_DELTA, 'hex'));
+  assert.strictEqual(d.body.base, 1);
+  assert.strictEqual(d.body.seq, 2);
+  assert.strictEqual(d.body.entryCount, 4);
+  assert.strictEqual(d.body.entryDelta.length, 3);
+  assert.deepStrictEqual([d.v.subgroup, d.v.rtt, d.v.clockOffset], [3, 41, -215]);
+  assert.deepStrictEqual(d.v.entries, [
+    // left stays what the full push said: viewers count down to readyAt
+    { label: 'Well of Action', ready: false, left: 12.3, skillid: 12569, readyAt: 1700000013000 },
+    { label: 'Signet', ready: true, left: null, skillid: 62965, readyAt: null },
+    { label: 'Shout', ready: false, left: 3.2, skillid: 10545, readyAt: null },
+    { label: 'Elite', ready: false, left: 60, skillid: 30000, readyAt: null }
+  ]);
+});
+
+test('update sentAt', () => {
+  assert.strictEqual(post(fullUpdate()).v.sentAt, null);
+  const w = new WireWriter();
+  w.varint(1700000009876);
+  const { body, v } = post(Buffer.concat([fullUpdate(), w.done()]));
+  assert.strictEqual(body.sentAt, 1700000009876);
+  assert.strictEqual(v.sentAt, 1700000009876);
+  assert.strictEqual(v.name, 'Self Character');
+});
+
+test('update truncated', () => {
+  post(fullUpdate());
+  const stored = getRoom('bags').get('c1');
+  const strs = stored.wire.strs.slice();
+  for (const buf of [fullUpdate(), Buffer.from(GOLDEN_UPDATE_DELTA, 'hex')]) {
+    for (let n = 0; n < buf.length; n++) {
+      assert.throws(() => decodeUpdate(buf.subarray(0, n)), Error, `prefix of ${n} bytes decoded`);
+    }
+  }
+  // a failed decode never touches the stored dictionary
+  assert.deepStrictEqual(stored.wire.strs, strs);
+});
+
+test('update corrupted', () => {
+  post(fullUpdate());
+  const stored = getRoom('bags').get('c1');
+  const strs = stored.wire.strs.slice();
+  let seed = 11;
+  const rnd = n => { seed = (seed * 1103515245 + 12345) % 2147483648; return seed % n; };
+  for (const good of [fullUpdate(), Buffer.from(GOLDEN_UPDATE_DELTA, 'hex')]) {
+    for (let round = 0; round < 5000; round++) {
+      const buf = Buffer.from(good);
+      for (let k = 1 + rnd(3); k > 0; k--) buf[rnd(buf.length)] ^= 1 + rnd(255);
+      let out;
+      try {
+        out = decodeUpdate(buf);
+      } catch (e) {
+        assert.ok(e instanceof Error);
+        continue;
+      }
+      const { body, wire } = out;
+      assert.ok(!body.entries || body.entries.length <= buf.length);
+      assert.ok(!body.entryDelta || body.entryDelta.length <= buf.length);
+      assert.ok(wire.strs.length <= strs.length + buf.length);
+    }
+  }
+  assert.deepStrictEqual(stored.wire.strs, strs);
+});
+
+test('aggregate golden', () => {
+  const buf = encodeAggregate('bags', undefined, SNAP, 2);
+  const want = Buffer.from(GOLDEN_AGGREGATE, 'hex');
+  assert.strictEqual(afterDictId(buf).toString('hex'), afterDictId(want).toString('hex'));
+});
+
+test('aggregate round trip', () => {
+  for (const version of [1, 2]) {
+    const dict = { id: 0, strs: [] };
+    const got = decodeAggregate(encodeAggregate('bags', undefined, SNAP, version), dict);
+    assert.strictEqual(got.epoch, 7);
+    assert.strictEqual(got.version, 42);
+    assert.deepStrictEqual(got.groupOrder, SNAP.groupOrder);
+    const want = SNAP.peers.map(p => ({
+      ...p,
+      rtt: version >= 2 ? p.rtt : null,
+      clockOffset: version >= 2 ? p.clockOffset : null,
+      entries: p.entries.map(e => ({ ...e, readyAt: version >= 2 ? e.readyAt : null }))
+    }));
+    assert.deepStrictEqual(got.peers, want);
+  }
+});
+
+test('aggregate dictionary', () => {
+  const dict = { id: 0, strs: [] };
+  decodeAggregate(encodeAggregate('bags', undefined, SNAP, 2), dict);
+  const known = `${dict.id}.${dict.strs.length}`;
+
+  // nothing new: no definitions
+  const again = encodeAggregate('bags', known, SNAP, 2);
+  const r = new WireReader(again);
+  r.u8(); r.u8(); r.u8(); r.varint();
+  assert.strictEqual(r.varint(), dict.strs.length);
+  assert.strictEqual(r.varint(), 0);
+
+  // a partial reply with one new label
+  const snap = {
+    ...SNAP, version: 43, since: 42, left: ['c2'],
+    peers: [{ ...SNAP.peers[0], entries: [{ label: 'Banner', ready: false, left: 7.5, skillid: 30000, readyAt: null }] }]
+  };
+  const got = decodeAggregate(encodeAggregate('bags', known, snap, 2), dict);
+  assert.deepStrictEqual(got.left, ['c2']);
+  assert.strictEqual(got.peers[0].entries[0].label, 'Banner');
+  assert.strictEqual(got.peers[0].account, ':Alice.1234');
+
+  // an unknown dictionary id gets every definition again
+  const fresh = { id: 0, strs: [] };
+  decodeAggregate(encodeAggregate('bags', `${dict.id + 1}.3`, SNAP, 2), fresh);
+  assert.deepStrictEqual(fresh.strs, dict.strs);
+});
+
+test('delta change test', () => {
+  const room = 'delta';
+  const full = {
+    name: 'A', prof: 1, subgroup: 1, elite: 0, seq: 1,
+    entries: [
+      { label: 'Well', ready: false, left: 10.4, skillid: 1, readyAt: null },
+      { label: 'Signet', ready: false, left: 30.2, skillid: 2, readyAt: 1700000030200 }
+    ]
+  };
+  let { v, changed } = storeFull(room, 'c', full);
+  assert.ok(changed);
+  assert.ok(!storeFull(room, 'c', full).changed);
+  v = getRoom(room).get('c');
+
+  // within the same second, and behind a readyAt: heartbeats
+  assert.ok(!applyDelta(room, v, { entryDelta: [{ i: 0, left: 10.05 }] }));
+  assert.ok(!applyDelta(room, v, { entryDelta: [{ i: 1, left: 12 }] }));
+  assert.ok(!storeFull(room, 'c', { ...full, entries: [{ ...full.entries[0], left: 10.1 }, full.entries[1]] }).changed);
+  // crossing a second, or anything else moving, is a change
+  v = getRoom(room).get('c');
+  assert.ok(applyDelta(room, v, { entryDelta: [{ i: 0, left: 9.9 }] }));
+  assert.ok(applyDelta(room, v, { entryDelta: [{ i: 1, readyAt: 1700000030250 }] }));
+  assert.ok(applyDelta(room, v, { entryDelta: [{ i: 0, ready: true, left: null }] }));
+  assert.ok(!sameEntry({ left: null, readyAt: null }, { left: 0.5, readyAt: null }));
+  assert.ok(sameEntry({ left: 3, readyAt: 5 }, { left: 1, readyAt: 5 }));
+});
+
+if (failures) {
+  console.log(`wire.js: ${failures} test(s) failed`);
+  process.exit(1);
+}
+console.log('wire.js: all checks passed');
+process.exit(0);